@@ -1,7 +1,87 @@
+#include <unistd.h>     // getopt()
+
 #include "src/server/webserver.h"
 
 int main(int argc, char *argv[])
 {
-    wsv::WebServer server(12309, 3, 60000, false, 3306, "root", "zjt152445", "yourdb", 12, 6, true, 1, 1024);
+    int opt, trigMode = 3, timeoutMS = 60000;
+    wsv::ServerOptions options;
+    while ((opt = getopt(argc, argv, "m:r:upbc:q:as:f:l:n:t:d:o:y:k:w:e:gj:x:")) != -1) {
+        switch (opt) {
+            case 'm': // 触发模式 0~3
+                trigMode = atoi(optarg);
+                break;
+            case 'r': // 子 reactor / io_uring 事件循环数
+                options.reactorNum = atoi(optarg);
+                break;
+            case 'u':
+                options.ioBackend = wsv::ServerOptions::IO_URING;
+                break;
+            case 'p': // 每个事件循环一个 SO_REUSEPORT 监听套接字
+                options.reusePort = true;
+                break;
+            case 'b': // 按收包 CPU 分配连接
+                options.cpuSteering = true;
+                break;
+            case 'c': // 绑核列表, 如 0-3,8
+                if (!wsv::CpuAffinity::parse(optarg, options.cpuList)) {
+                    fprintf(stderr, "invalid cpu list: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'q': // 线程池队列上限
+                options.maxQueue = atoi(optarg);
+                break;
+            case 'a': // 自适应并发上限
+                options.adaptiveLimit = true;
+                break;
+            case 's': // 不小于该字节数的文件走 sendfile
+                options.sendfileMin = strtoul(optarg, nullptr, 10);
+                break;
+            case 'f': // 静态文件内存缓存的字节上限
+                options.fileCacheBytes = strtoul(optarg, nullptr, 10);
+                break;
+            case 'l': // 每轮最多应答的流水线请求数
+                options.pipelineDepth = atoi(optarg);
+                break;
+            case 'n': // 连接数上限
+                options.maxConn = atoi(optarg);
+                break;
+            case 't': // 空闲连接超时 (ms), 0 不超时
+                timeoutMS = atoi(optarg);
+                break;
+            case 'd': // 阻塞执行器 (数据库) 线程数
+                options.blockingThreadNum = atoi(optarg);
+                break;
+            case 'o': // 阻塞执行器的排队上限, 0 不限制
+                options.blockingMaxQueue = atoi(optarg);
+                break;
+            case 'y': // 每个事件循环的非阻塞数据库连接数
+                options.asyncSqlConn = atoi(optarg);
+                break;
+            case 'k': // 数据库连接池的最小连接数
+                options.sqlConnMin = atoi(optarg);
+                break;
+            case 'w': // 取数据库连接的等待上限 (ms), 0 一直等待
+                options.sqlCheckoutTimeoutMS = atoi(optarg);
+                break;
+            case 'e': // 用户缓存的过期时间 (ms), 0 关闭
+                options.userCacheTTLMS = atoi(optarg);
+                break;
+            case 'g': // 注册前用 Bloom 过滤器判断用户名是否存在
+                options.userFilter = true;
+                break;
+            case 'j': // 注册的 INSERT 每批合并的上限, 0 不合并
+                options.registerBatchRows = atoi(optarg);
+                break;
+            case 'x': // 每批注册的最长等待时间 (us)
+                options.registerBatchWaitUs = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-m trigMode] [-r reactorNum] [-u] [-p] [-b] [-c cpuList] [-q maxQueue] [-a] [-s sendfileMin] [-f fileCacheBytes] [-l pipelineDepth] [-n maxConn] [-t timeoutMS] [-d blockingThreadNum] [-o blockingMaxQueue] [-y asyncSqlConn] [-k sqlConnMin] [-w sqlCheckoutTimeoutMS] [-e userCacheTTLMS] [-g] [-j registerBatchRows] [-x registerBatchWaitUs]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    wsv::WebServer server(12309, trigMode, timeoutMS, false, 3306, "root", "zjt152445", "yourdb", 12, 6, true, 1, 1024, options);
     server.start();
 }
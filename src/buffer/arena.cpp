@@ -0,0 +1,78 @@
+/**
+ * @file arena.cpp
+ * @brief  每个连接的单调内存池, 供请求内的字符串与容器使用
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "arena.h"
+
+namespace wsv
+{
+
+Arena::Arena() : _block(nullptr), _large(nullptr), _used(0), _allocated(0), _overflowCount(0) { }
+
+Arena::~Arena() { release(); }
+
+void Arena::reset() {
+    while (_large) {
+        Block *next = _large->next;
+        ::operator delete(_large);
+        _large = next;
+    }
+    if (_block) {
+        // 留下当前块, 之前用满的块还给池
+        Block *old = _block->next;
+        while (old) {
+            Block *next = old->next;
+            ChunkPool::release(old);
+            old = next;
+        }
+        _block->next = nullptr;
+    }
+    _used = HEADER;
+    _allocated = 0;
+}
+
+void Arena::release() {
+    reset();
+    if (_block)
+        ChunkPool::release(_block);
+    _block = nullptr;
+}
+
+size_t Arena::used() const { return _allocated; }
+
+uint64_t Arena::overflowCount() const { return _overflowCount; }
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    if (_block) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(_block);
+        size_t begin = ((base + _used + alignment - 1) & ~(alignment - 1)) - base;
+        if (begin + bytes <= ChunkPool::CHUNK_SIZE) {
+            _used = begin + bytes;
+            _allocated += bytes;
+            return reinterpret_cast<char*>(_block) + begin;
+        }
+    }
+    return _allocateSlow(bytes, alignment);
+}
+
+void* Arena::_allocateSlow(size_t bytes, size_t alignment) {
+    if (HEADER + bytes + alignment > ChunkPool::CHUNK_SIZE) {
+        ++_overflowCount;
+        _allocated += bytes;
+        size_t pad = alignment > HEADER ? alignment : 0;
+        Block *large = static_cast<Block*>(::operator new(HEADER + pad + bytes));
+        large->next = _large;
+        _large = large;
+        uintptr_t begin = reinterpret_cast<uintptr_t>(large) + HEADER;
+        return reinterpret_cast<void*>((begin + alignment - 1) & ~(alignment - 1));
+    }
+    Block *block = static_cast<Block*>(ChunkPool::acquire());
+    block->next = _block;
+    _block = block;
+    _used = HEADER;
+    return do_allocate(bytes, alignment);
+}
+
+}
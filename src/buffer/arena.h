@@ -0,0 +1,68 @@
+/**
+ * @file arena.h
+ * @brief  每个连接的单调内存池, 供请求内的字符串与容器使用
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <memory>
+#include <memory_resource>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chunkpool.h"
+
+namespace wsv
+{
+
+/*
+ * 按指针递增分配, 释放是空操作; 一轮请求处理完后 reset() 一次性回收.
+ * 块在第一次分配时从 ChunkPool 取, 用满后再取一块串起来; reset() 只留下一块,
+ * release() 全部还给池, 空闲连接因此不占内存. 超过块大小的分配单独向全局堆申请.
+ * 只被所属连接的线程使用, 不加锁.
+ */
+class Arena : public std::pmr::memory_resource
+{
+public:
+    Arena();
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void reset();
+    void release();
+    size_t used() const;
+    uint64_t overflowCount() const;     // 超过块大小而向全局堆申请的次数
+
+private:
+    struct Block
+    {
+        Block *next;
+    };
+    static const size_t HEADER = alignof(std::max_align_t);     // 块首存放链表指针
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override { }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    void* _allocateSlow(size_t bytes, size_t alignment);
+
+private:
+    Block *_block;          // 当前块, 链向之前用满的块
+    Block *_large;          // 单独向堆申请的大块
+    size_t _used;           // 当前块已用的字节, 含块首
+    size_t _allocated;      // reset() 之后分配出的字节
+    uint64_t _overflowCount;
+};
+
+// 让容器放弃在 arena 中的存储 (释放是空操作, 不会写回), 之后可以安全地 reset()
+template <typename T>
+inline void arenaDrop(T &c) { T(c.get_allocator()).swap(c); }
+
+}
+
+#endif // __ARENA_H__
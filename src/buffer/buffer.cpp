@@ -58,9 +58,8 @@ void Buffer::retrieveUntil(const char *end) {
     retrieve(end - peek());
 }
 
+// 保留已分配的空间, 下次追加不必重新增长
 void Buffer::retrieveAll() {
-    // memset(&_buffer, 0, _buffer.size());
-    _buffer.clear();
     _readPos = 0;
     _writePos = 0;
 }
@@ -79,7 +78,7 @@ void Buffer::append(const char *str, size_t len) {
     hasWritten(len);
 }
 
-void Buffer::append(const std::string &str) {
+void Buffer::append(std::string_view str) {
     append(str.data(), str.length());
 }
 
@@ -92,25 +91,14 @@ void Buffer::append(const Buffer &buff) { // to buff
     append(buff.peek(), buff.readableBytes());
 }
 
+// 直接读入缓冲区, 空间不足 READ_MIN 时先扩容, 不经栈上的临时数组中转
 ssize_t Buffer::readFd(int fd, int *Errno) {
-    char buff[65535];
-    struct iovec iov[2];
-    const size_t writable = writableBytes();
-    // 分散读
-    iov[0].iov_base = _beginPtr() + _writePos;
-    iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
-
-    const ssize_t len = readv(fd, iov, 2);
-    if (len < 0) {
+    ensureWritable(READ_MIN);
+    const ssize_t len = read(fd, beginWrite(), writableBytes());
+    if (len < 0)
         *Errno = errno;
-    } else if (static_cast<size_t>(len) <= writable) {
+    else
         _writePos += len;
-    } else {
-        _writePos = _buffer.size();
-        append(buff, len - writable);
-    }
     return len;
 }
 
@@ -9,8 +9,8 @@
 
 #include <iostream>
 #include <vector>
-#include <atomic>
 #include <string>
+#include <string_view>
 
 #include <cstring>  // perror
 
@@ -42,7 +42,7 @@ public:
     const char* beginWriteConst() const;
     char* beginWrite();
 
-    void append(const std::string &str);
+    void append(std::string_view str);
     void append(const char *str, size_t len);
     void append(const void *data, size_t len);
     void append(const Buffer &buff);
@@ -50,6 +50,8 @@ public:
     ssize_t readFd(int fd, int *Errno);
     ssize_t writeFd(int fd, int *Errno);
 
+    static const size_t READ_MIN = 4096;    // readFd 前保证的最小可写空间
+
 private:
     char* _beginPtr();
     const char* _beginPtr() const;
@@ -57,8 +59,8 @@ private:
 
 private:
     std::vector<char> _buffer;
-    std::atomic<std::size_t> _readPos;
-    std::atomic<std::size_t> _writePos;
+    std::size_t _readPos;       // 只在持有者线程 (或其锁内) 访问, 不需要原子操作
+    std::size_t _writePos;
 };
 
 }
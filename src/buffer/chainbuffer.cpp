@@ -0,0 +1,183 @@
+/**
+ * @file chainbuffer.cpp
+ * @brief  由固定大小的块串成的连接读写缓冲区, 块来自按线程缓存的 slab 池
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "chainbuffer.h"
+
+namespace wsv
+{
+
+ChainBuffer::ChainBuffer() : _head(nullptr), _tail(nullptr), _readable(0), _readChunks(1) { }
+
+ChainBuffer::~ChainBuffer() { retrieveAll(); }
+
+size_t ChainBuffer::readableBytes() const { return _readable; }
+
+size_t ChainBuffer::segmentCount() const {
+    size_t n = 0;
+    for (Segment *seg = _head; seg; seg = seg->next)
+        ++n;
+    return n;
+}
+
+const char* ChainBuffer::peek() const { return _head ? _head->data() + _head->begin : nullptr; }
+
+const char* ChainBuffer::pullup() {
+    if (!_head || _head == _tail)
+        return peek();
+    Segment *dst = _head;
+    Segment *seg = _head->next;
+    if (_head->cap >= _readable) {
+        // 第一块放得下: 数据移到块首, 再接上后续块
+        memmove(dst->data(), dst->data() + dst->begin, dst->readable());
+        dst->end = dst->readable();
+        dst->begin = 0;
+    } else {
+        dst = _newSegment(_readable * 2);
+        seg = _head;
+    }
+    while (seg) {
+        Segment *next = seg->next;
+        memcpy(dst->data() + dst->end, seg->data() + seg->begin, seg->readable());
+        dst->end += seg->readable();
+        _freeSegment(seg);
+        seg = next;
+    }
+    dst->next = nullptr;
+    _head = _tail = dst;
+    return peek();
+}
+
+void ChainBuffer::retrieve(size_t len) {
+    while (len > 0 && _head) {
+        size_t n = std::min(len, _head->readable());
+        _head->begin += n;
+        _readable -= n;
+        len -= n;
+        if (_head->readable() == 0) {
+            Segment *next = _head->next;
+            _freeSegment(_head);
+            _head = next;
+        }
+    }
+    if (!_head)
+        _tail = nullptr;
+}
+
+void ChainBuffer::retrieveAll() {
+    while (_head) {
+        Segment *next = _head->next;
+        _freeSegment(_head);
+        _head = next;
+    }
+    _tail = nullptr;
+    _readable = 0;
+}
+
+void ChainBuffer::append(const char *data, size_t len) {
+    while (len > 0) {
+        if (!_tail || _tail->writable() == 0)
+            _push(_newSegment(0));
+        size_t n = std::min(len, _tail->writable());
+        memcpy(_tail->data() + _tail->end, data, n);
+        _tail->end += n;
+        _readable += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::append(std::string_view str) { append(str.data(), str.size()); }
+
+// 空间填满时下次多取一倍的块, 用不到一半时减半, 小请求每次只取一块
+ssize_t ChainBuffer::readFd(int fd, int *Errno) {
+    struct iovec iov[READ_CHUNKS + 1];
+    Segment *spare[READ_CHUNKS];
+    const int spareCnt = _readChunks;
+    int cnt = 0;
+    size_t space = 0;
+    if (_tail && _tail->writable() > 0) {
+        iov[cnt++] = { _tail->data() + _tail->end, _tail->writable() };
+        space += _tail->writable();
+    }
+    for (int i = 0; i < spareCnt; i++) {
+        spare[i] = _newSegment(0);
+        iov[cnt++] = { spare[i]->data(), spare[i]->cap };
+        space += spare[i]->cap;
+    }
+    ssize_t len = cnt == 1 ? read(fd, iov[0].iov_base, iov[0].iov_len) : readv(fd, iov, cnt);
+    if (len < 0)
+        *Errno = errno;
+    size_t left = len > 0 ? static_cast<size_t>(len) : 0;
+    _readable += left;
+    if (left == space)
+        _readChunks = std::min(_readChunks * 2, READ_CHUNKS);
+    else if (left < space / 2)
+        _readChunks = std::max(_readChunks / 2, 1);
+    if (_tail && _tail->writable() > 0) {
+        size_t n = std::min(left, _tail->writable());
+        _tail->end += n;
+        left -= n;
+    }
+    // 用到的块接到链尾, 其余立即归还
+    for (int i = 0; i < spareCnt; i++) {
+        if (left > 0) {
+            spare[i]->end = std::min<size_t>(left, spare[i]->cap);
+            left -= spare[i]->end;
+            _push(spare[i]);
+        } else {
+            _freeSegment(spare[i]);
+        }
+    }
+    return len;
+}
+
+void ChainBuffer::appendIov(std::pmr::vector<struct iovec> &iov, size_t offset, size_t len) const {
+    for (Segment *seg = _head; seg && len > 0; seg = seg->next) {
+        if (offset >= seg->readable()) {
+            offset -= seg->readable();
+            continue;
+        }
+        size_t n = std::min(len, seg->readable() - offset);
+        iov.push_back({ seg->data() + seg->begin + offset, n });
+        offset = 0;
+        len -= n;
+    }
+}
+
+ChainBuffer::Segment* ChainBuffer::_newSegment(size_t minCap) {
+    const size_t POOLED_CAP = ChunkPool::CHUNK_SIZE - sizeof(Segment);
+    Segment *seg;
+    if (minCap <= POOLED_CAP) {
+        seg = static_cast<Segment*>(ChunkPool::acquire());
+        seg->cap = POOLED_CAP;
+        seg->pooled = true;
+    } else {
+        seg = static_cast<Segment*>(::operator new(sizeof(Segment) + minCap));
+        seg->cap = static_cast<uint32_t>(minCap);
+        seg->pooled = false;
+    }
+    seg->next = nullptr;
+    seg->begin = seg->end = 0;
+    return seg;
+}
+
+void ChainBuffer::_freeSegment(Segment *seg) {
+    if (seg->pooled)
+        ChunkPool::release(seg);
+    else
+        ::operator delete(seg);
+}
+
+void ChainBuffer::_push(Segment *seg) {
+    seg->next = nullptr;
+    if (_tail)
+        _tail->next = seg;
+    else
+        _head = seg;
+    _tail = seg;
+}
+
+}
@@ -0,0 +1,85 @@
+/**
+ * @file chainbuffer.h
+ * @brief  由固定大小的块串成的连接读写缓冲区, 块来自按线程缓存的 slab 池
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __CHAINBUFFER_H__
+#define __CHAINBUFFER_H__
+
+#include <vector>
+#include <string_view>
+#include <memory_resource>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>         // read
+#include <sys/uio.h>        // readv / iovec
+
+#include "chunkpool.h"
+
+namespace wsv
+{
+
+/*
+ * 可读数据分布在一串块中: 读时直接 readv 到尾块的剩余空间与新取的块,
+ * 发送时按块输出 iovec, 完全取走的块立即还给池. 缓冲区为空时不持有任何块.
+ * 需要连续内存 (解析请求) 时用 pullup() 把可读数据合并到一块, 超过块大小时
+ * 单独分配一个按倍数增长的大块, 之后的读取直接落在它的剩余空间里.
+ * 只由所属连接的当前线程访问, 不加锁.
+ */
+class ChainBuffer
+{
+public:
+    ChainBuffer();
+    ~ChainBuffer();
+
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+    size_t readableBytes() const;
+    size_t segmentCount() const;
+    const char* peek() const;       // 第一块的可读起点, 只有第一块内是连续的
+    const char* pullup();           // 使全部可读数据连续, 返回起点
+
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    void append(const char *data, size_t len);
+    void append(std::string_view str);
+    ssize_t readFd(int fd, int *Errno);
+
+    // 把 [offset, offset + len) 的可读数据按块追加为 iovec
+    void appendIov(std::pmr::vector<struct iovec> &iov, size_t offset, size_t len) const;
+
+    static constexpr int READ_CHUNKS = 16;  // 每次 readv 最多额外取的块数
+
+private:
+    struct Segment
+    {
+        Segment *next;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t cap;
+        bool pooled;
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+        size_t readable() const { return end - begin; }
+        size_t writable() const { return cap - end; }
+    };
+
+    static Segment* _newSegment(size_t minCap);
+    static void _freeSegment(Segment *seg);
+    void _push(Segment *seg);
+
+private:
+    Segment *_head;
+    Segment *_tail;
+    size_t _readable;
+    int _readChunks;        // 下次 readv 额外取的块数, 按上次读取量自适应
+};
+
+}
+
+#endif // __CHAINBUFFER_H__
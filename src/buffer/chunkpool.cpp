@@ -0,0 +1,90 @@
+/**
+ * @file chunkpool.cpp
+ * @brief  固定大小内存块的 slab 池, 按线程缓存空闲块
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "chunkpool.h"
+
+namespace wsv
+{
+
+static inline void*& nextOf(void *chunk) { return *static_cast<void**>(chunk); }
+
+ChunkPool::Local::~Local() {
+    if (count > 0)
+        _spill(*this, 0);
+}
+
+ChunkPool::Local& ChunkPool::_local() {
+    static thread_local Local local;
+    return local;
+}
+
+// 不析构: 其他线程退出时还会把缓存交回
+ChunkPool::Global& ChunkPool::_global() {
+    static Global *global = new Global();
+    return *global;
+}
+
+void* ChunkPool::acquire() {
+    Local &local = _local();
+    if (!local.head)
+        _refill(local);
+    void *chunk = local.head;
+    local.head = nextOf(chunk);
+    --local.count;
+    return chunk;
+}
+
+void ChunkPool::release(void *chunk) {
+    Local &local = _local();
+    nextOf(chunk) = local.head;
+    local.head = chunk;
+    if (++local.count > LOCAL_MAX)
+        _spill(local, LOCAL_MAX / 2);
+}
+
+size_t ChunkPool::slabCount() {
+    Global &global = _global();
+    std::lock_guard<std::mutex> locker(global.mtx);
+    return global.slabs.size();
+}
+
+void ChunkPool::_refill(Local &local) {
+    Global &global = _global();
+    std::lock_guard<std::mutex> locker(global.mtx);
+    // 先从全局链表取至多一个 slab 的量
+    while (global.head && local.count < CHUNKS_PER_SLAB) {
+        void *chunk = global.head;
+        global.head = nextOf(chunk);
+        --global.count;
+        nextOf(chunk) = local.head;
+        local.head = chunk;
+        ++local.count;
+    }
+    if (local.head)
+        return;
+    global.slabs.emplace_back(new char[CHUNK_SIZE * CHUNKS_PER_SLAB]);
+    char *slab = global.slabs.back().get();
+    for (size_t i = CHUNKS_PER_SLAB; i-- > 0; ) {
+        nextOf(slab + i * CHUNK_SIZE) = local.head;
+        local.head = slab + i * CHUNK_SIZE;
+    }
+    local.count = CHUNKS_PER_SLAB;
+}
+
+void ChunkPool::_spill(Local &local, size_t keep) {
+    Global &global = _global();
+    std::lock_guard<std::mutex> locker(global.mtx);
+    while (local.count > keep) {
+        void *chunk = local.head;
+        local.head = nextOf(chunk);
+        --local.count;
+        nextOf(chunk) = global.head;
+        global.head = chunk;
+        ++global.count;
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+/**
+ * @file chunkpool.h
+ * @brief  固定大小内存块的 slab 池, 按线程缓存空闲块
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __CHUNKPOOL_H__
+#define __CHUNKPOOL_H__
+
+#include <mutex>
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+
+namespace wsv
+{
+
+/*
+ * 固定大小的内存块. 分配/归还只操作本线程的空闲链表, 不加锁;
+ * 本线程没有空闲块时先从全局链表取一批, 仍没有再切分一个新的 slab;
+ * 本线程缓存过多时把一半交回全局链表, 线程退出时全部交回.
+ * 连接可能在线程间迁移, 块在哪个线程归还就进入哪个线程的缓存.
+ * slab 在进程生命周期内不释放, 占用的内存由峰值决定.
+ */
+class ChunkPool
+{
+public:
+    static const size_t CHUNK_SIZE = 4096;
+    static const size_t CHUNKS_PER_SLAB = 64;
+    static const size_t LOCAL_MAX = 256;        // 每个线程最多缓存的空闲块数
+
+    static void* acquire();
+    static void release(void *chunk);
+    static size_t slabCount();
+
+private:
+    struct Local
+    {
+        void *head = nullptr;       // 空闲块的第一个字存放下一个空闲块
+        size_t count = 0;
+        ~Local();
+    };
+    struct Global
+    {
+        std::mutex mtx;
+        void *head = nullptr;
+        size_t count = 0;
+        std::vector<std::unique_ptr<char[]>> slabs;
+    };
+
+    static Local& _local();
+    static Global& _global();
+    static void _refill(Local &local);
+    static void _spill(Local &local, size_t keep);
+};
+
+}
+
+#endif // __CHUNKPOOL_H__
@@ -0,0 +1,67 @@
+/**
+ * @file fdcache.cpp
+ * @brief  静态文件描述符缓存, 供 sendfile 使用
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "fdcache.h"
+
+namespace wsv
+{
+
+FdCache::FdCache() : _capacity(256) { }
+
+FdCache* FdCache::Instance() {
+    static FdCache cache;
+    return &cache;
+}
+
+void FdCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> locker(_mtx);
+    _capacity = capacity > 0 ? capacity : 1;
+    while (_lru.size() > _capacity) {
+        _index.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+}
+
+std::shared_ptr<const FdCache::File> FdCache::get(std::string_view path, const struct stat &st) {
+    std::lock_guard<std::mutex> locker(_mtx);
+    auto it = _index.find(path);
+    if (it != _index.end()) {
+        const struct stat &old = it->second->second->st;
+        if (old.st_dev == st.st_dev && old.st_ino == st.st_ino && old.st_size == st.st_size
+                && old.st_mtim.tv_sec == st.st_mtim.tv_sec && old.st_mtim.tv_nsec == st.st_mtim.tv_nsec) {
+            _lru.splice(_lru.begin(), _lru, it->second);
+            return it->second->second;
+        }
+        // 文件已被修改或替换
+        LruList::iterator node = it->second;
+        _index.erase(it);
+        _lru.erase(node);
+    }
+
+    std::string key(path);
+    int fd = open(key.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+    // 以打开后的 fstat 为准, 防止 stat 与 open 之间文件被替换
+    struct stat cur;
+    if (fstat(fd, &cur) < 0 || cur.st_ino != st.st_ino || cur.st_size != st.st_size) {
+        ::close(fd);
+        return nullptr;
+    }
+    if (cur.st_size >= LARGE_FILE)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);   // 预读窗口加倍
+
+    auto file = std::make_shared<const File>(fd, cur);
+    _lru.emplace_front(std::move(key), file);
+    _index[_lru.front().first] = _lru.begin();
+    if (_lru.size() > _capacity) {
+        _index.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+    return file;
+}
+
+}
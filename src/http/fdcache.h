@@ -0,0 +1,60 @@
+/**
+ * @file fdcache.h
+ * @brief  静态文件描述符缓存, 供 sendfile 使用
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __FDCACHE_H__
+#define __FDCACHE_H__
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace wsv
+{
+
+/*
+ * 按路径缓存只读 fd, 多个连接共享同一个 fd: sendfile 使用各自的偏移, 不改变文件位置.
+ * 每次请求已经 stat 过文件, 设备号/inode/大小/修改时间任一变化就重新打开;
+ * 被淘汰或替换的 fd 在最后一个在途响应结束后才关闭.
+ */
+class FdCache
+{
+public:
+    struct File
+    {
+        int fd;
+        struct stat st;
+        File(int f, const struct stat &s) : fd(f), st(s) { }
+        ~File() { if (fd >= 0) ::close(fd); }
+    };
+
+    static FdCache* Instance();
+
+    std::shared_ptr<const File> get(std::string_view path, const struct stat &st);
+    void setCapacity(size_t capacity);
+
+    static const off_t LARGE_FILE = 1 << 20;   // 达到该大小时提示内核顺序预读
+
+private:
+    FdCache();
+
+    typedef std::list<std::pair<std::string, std::shared_ptr<const File>>> LruList;
+
+    std::mutex _mtx;
+    size_t _capacity;
+    LruList _lru;
+    std::unordered_map<std::string_view, LruList::iterator> _index;    // 键指向链表节点中的路径
+};
+
+}
+
+#endif // __FDCACHE_H__
@@ -0,0 +1,251 @@
+/**
+ * @file filecache.cpp
+ * @brief  静态文件内存缓存, inotify 失效
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "filecache.h"
+
+namespace wsv
+{
+
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+FileCache::FileCache()
+    : _isEnabled(false), _notifyFd(-1), _budget(0), _maxFileSize(0), _bytes(0), _hand(_ring.end()), _epoch(0), _hits(0), _misses(0) { }
+
+FileCache::~FileCache() {
+    if (_notifyFd >= 0)
+        close(_notifyFd);
+}
+
+FileCache* FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+bool FileCache::init(const std::string &root, size_t budget, size_t maxFileSize) {
+    _notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_notifyFd < 0) {
+        LOG_ERROR("FileCache inotify init error: %d", errno);
+        return false;
+    }
+    _root = root;
+    while (!_root.empty() && _root.back() == '/')
+        _root.pop_back();
+    _budget = budget;
+    _maxFileSize = std::min(maxFileSize, budget);
+    _watchTree("");
+    _isEnabled = true;
+    return true;
+}
+
+bool FileCache::isEnabled() const { return _isEnabled; }
+
+int FileCache::notifyFd() const { return _notifyFd; }
+
+size_t FileCache::bytes() const {
+    std::shared_lock<std::shared_timed_mutex> locker(_mtx);
+    return _bytes;
+}
+
+uint64_t FileCache::hits() const { return _hits.load(std::memory_order_relaxed); }
+
+uint64_t FileCache::misses() const { return _misses.load(std::memory_order_relaxed); }
+
+std::shared_ptr<const FileCache::Entry> FileCache::get(std::string_view path) {
+    std::string buf;
+    if (!_canonical(path, &path, &buf))
+        return nullptr;
+    std::shared_lock<std::shared_timed_mutex> locker(_mtx);
+    auto it = _index.find(path);
+    if (it == _index.end()) {
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    it->second->entry->referenced.store(true, std::memory_order_relaxed);
+    _hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second->entry;
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::load(std::string_view path, std::string_view type) {
+    // 不在 watch 范围内的路径无法失效, 不缓存
+    std::string buf;
+    if (!_canonical(path, &path, &buf))
+        return nullptr;
+
+    // 读文件不持锁. 读的过程中文件被修改, 而失效事件在装入之前已处理时, 装入的旧内容不会再被移除;
+    // 先记下失效计数, 装入时计数已变则只返回本次读到的内容, 不缓存
+    uint64_t epoch = _epoch.load(std::memory_order_acquire);
+    std::string full = _root;
+    full.append(path);
+    int fd = open(full.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH)
+            || static_cast<size_t>(st.st_size) > _maxFileSize) {
+        close(fd);
+        return nullptr;
+    }
+    auto entry = std::make_shared<Entry>();
+    entry->body.resize(st.st_size);
+    size_t done = 0;
+    while (done < entry->body.size()) {
+        ssize_t len = read(fd, &entry->body[done], entry->body.size() - done);
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) continue;
+            close(fd);
+            return nullptr;
+        }
+        done += len;
+    }
+    close(fd);
+    entry->header.append("Content-type: ").append(type).append("\r\nContent-length: ")
+        .append(std::to_string(done)).append("\r\n\r\n");
+
+    std::unique_lock<std::shared_timed_mutex> locker(_mtx);
+    auto it = _index.find(path);
+    if (it != _index.end())
+        return it->second->entry;   // 其他线程已装入
+    if (_epoch.load(std::memory_order_relaxed) != epoch)
+        return entry;
+    Slot slot{ std::string(path), entry };
+    size_t cost = _cost(slot);
+    while (_bytes + cost > _budget && !_ring.empty()) {
+        // CLOCK: 跳过并清除最近访问过的条目, 淘汰第一个未被访问的
+        if (_hand == _ring.end())
+            _hand = _ring.begin();
+        if (_hand->entry->referenced.exchange(false, std::memory_order_relaxed)) {
+            ++_hand;
+            continue;
+        }
+        _erase(_hand++);
+    }
+    SlotIter slotIt = _ring.insert(_hand, std::move(slot));
+    _index[slotIt->path] = slotIt;
+    _bytes += cost;
+    return entry;
+}
+
+void FileCache::dealNotify() {
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t len;
+    while ((len = read(_notifyFd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                LOG_WARN("FileCache inotify queue overflow, drop all");
+                _clear();
+                continue;
+            }
+            auto w = _watches.find(ev->wd);
+            if (w == _watches.end())
+                continue;
+            if (ev->mask & IN_IGNORED) {
+                _watches.erase(w);
+                continue;
+            }
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                _clear();   // 目录整体被移走, 其下的条目都不再可信
+                continue;
+            }
+            if (ev->len == 0)
+                continue;
+            std::string path = w->second + "/" + ev->name;
+            if (ev->mask & IN_ISDIR) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                    _watchTree(path);
+                else if (ev->mask & IN_MOVED_FROM)
+                    _clear();
+                continue;
+            }
+            _invalidate(path);
+        }
+    }
+}
+
+// 键须与 inotify 事件拼出的 "/dir/name" 一致: 折叠 "//" 与 "/./"; 含 ".."、不以 '/' 开头
+// 或以 '/' 结尾 (指向目录) 时不缓存. 已是规范形式时 key 直接指向 path, 否则指向 buf
+bool FileCache::_canonical(std::string_view path, std::string_view *key, std::string *buf) {
+    if (path.empty() || path[0] != '/' || path.back() == '/')
+        return false;
+    if (path.size() >= 2 && path.substr(path.size() - 2) == "/.")
+        return false;
+    bool clean = true;
+    for (size_t pos = 0; pos < path.size(); ) {
+        size_t end = std::min(path.find('/', pos + 1), path.size());
+        std::string_view seg = path.substr(pos + 1, end - pos - 1);
+        if (seg == "..")
+            return false;
+        if (seg.empty() || seg == ".") {
+            // 第一个多余的段之前都是规范的, 从这里开始另行拼接
+            if (clean)
+                buf->assign(path.substr(0, pos));
+            clean = false;
+        } else if (!clean) {
+            buf->append("/").append(seg);
+        }
+        pos = end;
+    }
+    if (clean) {
+        *key = path;
+        return true;
+    }
+    *key = *buf;
+    return !buf->empty();
+}
+
+void FileCache::_watchTree(const std::string &rel) {
+    std::string dir = _root + rel;
+    int wd = inotify_add_watch(_notifyFd, dir.data(), WATCH_MASK);
+    if (wd < 0) {
+        LOG_WARN("FileCache watch %s error: %d", dir.data(), errno);
+        return;
+    }
+    _watches[wd] = rel;
+    DIR *dp = opendir(dir.data());
+    if (!dp)
+        return;
+    struct dirent *de;
+    while ((de = readdir(dp))) {
+        if (de->d_type == DT_DIR && strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0)
+            _watchTree(rel + "/" + de->d_name);
+    }
+    closedir(dp);
+}
+
+void FileCache::_invalidate(const std::string &path) {
+    std::unique_lock<std::shared_timed_mutex> locker(_mtx);
+    _epoch.fetch_add(1, std::memory_order_release);
+    auto it = _index.find(path);
+    if (it != _index.end()) {
+        LOG_DEBUG("FileCache invalidate %s", path.data());
+        _erase(it->second);
+    }
+}
+
+void FileCache::_clear() {
+    std::unique_lock<std::shared_timed_mutex> locker(_mtx);
+    _epoch.fetch_add(1, std::memory_order_release);
+    _index.clear();
+    _ring.clear();
+    _hand = _ring.end();
+    _bytes = 0;
+}
+
+void FileCache::_erase(SlotIter it) {
+    if (_hand == it)
+        ++_hand;
+    _bytes -= _cost(*it);
+    _index.erase(it->path);
+    _ring.erase(it);
+}
+
+size_t FileCache::_cost(const Slot &slot) {
+    return slot.path.size() + slot.entry->body.size() + slot.entry->header.size();
+}
+
+}
@@ -0,0 +1,102 @@
+/**
+ * @file filecache.h
+ * @brief  静态文件内存缓存, inotify 失效
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __FILECACHE_H__
+#define __FILECACHE_H__
+
+#include <list>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <shared_mutex>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "../log/log.h"
+
+namespace wsv
+{
+
+/*
+ * 按请求路径缓存小文件的内容与预先序列化的 Content-type / Content-length 头,
+ * 命中时不访问文件系统. 读多写少: 查找只持共享锁, 置位访问标记;
+ * 超出字节上限时按 CLOCK 淘汰. srcDir 下每个目录一个 inotify watch,
+ * 文件被修改/替换/删除时移除对应条目, 在途响应仍持有旧内容直到发送完成.
+ */
+class FileCache
+{
+public:
+    struct Entry
+    {
+        std::string body;
+        std::string header;                     // "Content-type: ..\r\nContent-length: ..\r\n\r\n"
+        mutable std::atomic<bool> referenced;
+        Entry() : referenced(true) { }
+    };
+
+    static FileCache* Instance();
+
+    bool init(const std::string &root, size_t budget, size_t maxFileSize);
+    bool isEnabled() const;
+    int notifyFd() const;
+    void dealNotify();
+
+    std::shared_ptr<const Entry> get(std::string_view path);
+    std::shared_ptr<const Entry> load(std::string_view path, std::string_view type);
+
+    size_t bytes() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    FileCache();
+    ~FileCache();
+
+    struct Slot
+    {
+        std::string path;
+        std::shared_ptr<Entry> entry;
+    };
+    typedef std::list<Slot>::iterator SlotIter;
+
+    static bool _canonical(std::string_view path, std::string_view *key, std::string *buf);
+    void _watchTree(const std::string &rel);
+    void _invalidate(const std::string &path);
+    void _clear();
+    void _erase(SlotIter it);
+    static size_t _cost(const Slot &slot);
+
+private:
+    bool _isEnabled;
+    int _notifyFd;
+    size_t _budget;
+    size_t _maxFileSize;
+    size_t _bytes;
+    std::string _root;
+
+    mutable std::shared_timed_mutex _mtx;
+    std::list<Slot> _ring;                      // CLOCK 环, 新条目插在指针之前
+    SlotIter _hand;
+    std::unordered_map<std::string_view, SlotIter> _index;  // 键指向 Slot::path, 查找不构造字符串
+    std::unordered_map<int, std::string> _watches;  // wd -> 相对 root 的目录, 以 '/' 开头或为空
+
+    std::atomic<uint64_t> _epoch;               // 每次失效/清空加一, 读文件期间变化时不装入
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+};
+
+}
+
+#endif // __FILECACHE_H__
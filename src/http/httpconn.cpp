@@ -13,8 +13,12 @@ namespace wsv
 bool HttpConn::isET;
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
+std::atomic<bool> HttpConn::isDraining;
+int HttpConn::pipelineMax = 16;
 
-HttpConn::HttpConn() : _isClosed(true), _fd(-1), _iovCnt(0), _readBuff(), _writeBuff() { }
+HttpConn::HttpConn()
+    : _isClosed(true), _isKeepAlive(false), _verify(VERIFY_NONE), _fd(-1), _iovIdx(0), _iovRemain(0), _fileOffset(0), _fileRemain(0),
+      _readBuff(), _writeBuff(), _arena(), _request(nullptr), _iov(&_arena), _headerEnd(&_arena), _responses(&_arena) { }
 HttpConn::~HttpConn() { close(); }
 
 void HttpConn::init(int sockFd, const sockaddr_in &addr) {
@@ -23,14 +27,15 @@ void HttpConn::init(int sockFd, const sockaddr_in &addr) {
     _isClosed = false;
     _addr = addr;
     _fd = sockFd;
-    _writeBuff.retrieveAll();
     _readBuff.retrieveAll();
+    _releaseState();
 
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", _fd, getIP(), getPort(), (int)userCount);
 }
 
 void HttpConn::close() {
-    _response.unMapFile();
+    _releaseState();
+    _readBuff.retrieveAll();
     if (!_isClosed) {
         _isClosed = !_isClosed;
         --userCount;
@@ -47,9 +52,13 @@ const char* HttpConn::getIP() const { return inet_ntoa(_addr.sin_addr); }
 
 sockaddr_in HttpConn::getAddr() const { return _addr; }
 
-bool HttpConn::isKeepAlive() const { return _request.isKeepAlive(); }
+bool HttpConn::isKeepAlive() const { return _isKeepAlive && !isDraining; }
+
+bool HttpConn::isClosed() const { return _isClosed; }
 
-int HttpConn::toWriteBytes() { return _iov[0].iov_len + _iov[1].iov_len; }
+int HttpConn::toWriteBytes() { return _iovRemain + _fileRemain; }
+
+bool HttpConn::isIdle() const { return _iovRemain + _fileRemain == 0 && _verify == VERIFY_NONE && _readBuff.readableBytes() == 0; }
 
 ssize_t HttpConn::read(int *saveErrno) {
     ssize_t len = -1;
@@ -60,49 +69,186 @@ ssize_t HttpConn::read(int *saveErrno) {
 ssize_t HttpConn::write(int *saveErrno) {
     ssize_t len = -1;
     do {
-        if ((len = writev(_fd, _iov, _iovCnt)) <= 0) {
+        if (_iovRemain == 0) {
+            if (_fileRemain == 0)
+                break; // 传输结束
+            if ((len = sendFile(saveErrno)) <= 0)
+                break;
+            continue;
+        }
+        // 后面还有 sendfile 的数据时带 MSG_MORE, 与文件开头合并成满段发出
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = _iov.data() + _iovIdx;
+        msg.msg_iovlen = _iov.size() - _iovIdx;
+        len = sendmsg(_fd, &msg, MSG_NOSIGNAL | (_fileRemain > 0 ? MSG_MORE : 0));
+        if (len <= 0) {
             *saveErrno = errno;
             break;
         }
-        if (_iov[0].iov_len + _iov[1].iov_len == 0) {
-            break; // 传输结束
-        } else if (static_cast<size_t>(len) > _iov[0].iov_len) {
-            _iov[1].iov_base = static_cast<uint8_t*>(_iov[1].iov_base) + (len - _iov[0].iov_len);
-            _iov[1].iov_len -= (len - _iov[0].iov_len);
-            if (_iov[0].iov_len) {
-                _writeBuff.retrieveAll();
-                _iov[0].iov_len = 0;
-            }
-        } else {
-            _iov[0].iov_base = static_cast<uint8_t*>(_iov[0].iov_base) + len;
-            _iov[0].iov_len -= len;
-            _writeBuff.retrieve(len);
-        }
+        hasWritten(len);
     } while (isET || toWriteBytes() > 10240);
     return len;
 }
 
+void HttpConn::appendRead(const char *data, size_t len) { _readBuff.append(data, len); }
+
+const struct iovec* HttpConn::iov() const { return _iov.data() + _iovIdx; }
+
+int HttpConn::iovCnt() const { return static_cast<int>(_iov.size() - _iovIdx); }
+
+void HttpConn::hasWritten(size_t len) {
+    _iovRemain -= len;
+    while (len > 0) {
+        struct iovec &v = _iov[_iovIdx];
+        if (len < v.iov_len) {
+            v.iov_base = static_cast<uint8_t*>(v.iov_base) + len;
+            v.iov_len -= len;
+            break;
+        }
+        len -= v.iov_len;
+        v.iov_len = 0;
+        ++_iovIdx;
+    }
+    // iovec 指向写缓冲区, 全部发完才能回收
+    if (_iovRemain == 0)
+        _writeBuff.retrieveAll();
+}
+
+size_t HttpConn::fileRemain() const { return _fileRemain; }
+
+ssize_t HttpConn::sendFile(int *saveErrno) {
+    // 只有本轮最后一个响应可能走 sendfile
+    ssize_t len = sendfile(_fd, _responses.back()->fileFd(), &_fileOffset, _fileRemain);
+    if (len <= 0) {
+        // 文件被截断时 sendfile 返回 0, 无法再凑够 Content-length, 只能断开
+        *saveErrno = len == 0 ? EPIPE : errno;
+        return len;
+    }
+    _fileRemain -= len;
+    return len;
+}
+
+/*
+ * 一次应答读缓冲区中所有完整的流水线请求 (至多 pipelineMax 个), 响应按请求顺序
+ * 依次追加到写缓冲区, 与各自的文件内容组成一次 vectored write.
+ * 调用前上一轮必须已经发完. 以下情况本轮到此为止, 余下请求留到下一轮:
+ * 连接将关闭; 响应走 sendfile (文件只能排在最后); 遇到要访问数据库的请求.
+ * 要访问数据库的请求只在本轮开头交出去, 前面已有响应时放弃解析结果, 下一轮重新解析.
+ * 没有可应答的请求且读缓冲区为空时连接进入空闲, 归还请求与 arena 占用的块.
+ */
 bool HttpConn::process() {
-    _request.init();
-    if (_readBuff.readableBytes() <= 0)
+    if (_verify == VERIFY_PENDING || _verify == VERIFY_RUNNING)
+        return false;   // 期间到达的数据留在读缓冲区
+    // 校验结果已回来: 请求的解析结果在 arena 中, 不能回收
+    bool resume = _verify == VERIFY_DONE;
+    _verify = VERIFY_NONE;
+    if (!resume)
+        _endRound();
+    while (_responses.size() < static_cast<size_t>(pipelineMax) && _readBuff.readableBytes() > 0) {
+        HttpRequest &request = _acquireRequest();
+        HttpRequest::HTTP_CODE ret = resume ? HttpRequest::GET_REQUEST : request.parse(_readBuff);
+        resume = false;
+        if (ret == HttpRequest::NO_REQUEST)
+            break;      // 请求不完整, 解析状态保留, 回到事件循环等待后续数据
+        if (request.needVerify()) {
+            if (_responses.empty())
+                _verify = VERIFY_PENDING;
+            else
+                request.init();
+            break;
+        }
+        HttpResponse *response = new (_arena.allocate(sizeof(HttpResponse), alignof(HttpResponse))) HttpResponse(&_arena);
+        _responses.push_back(response);
+        _isKeepAlive = ret == HttpRequest::GET_REQUEST && request.isKeepAlive();
+        response->init(srcDir, request.path(), _isKeepAlive && !isDraining, ret == HttpRequest::GET_REQUEST ? 200 : 400);
+        response->makeResponse(_writeBuff);
+        // 解析结果引用读缓冲区, 响应生成后才取走该请求
+        _readBuff.retrieve(request.length());
+        _headerEnd.push_back(_writeBuff.readableBytes());
+        if (!_isKeepAlive || isDraining || (response->fileLen() > 0 && response->fileFd() >= 0))
+            break;
+    }
+    if (_responses.empty()) {
+        if (_readBuff.readableBytes() == 0)
+            _releaseState();
         return false;
-    else if (_request.parse(_readBuff))
-        _response.init(srcDir, _request.path(), _request.isKeepAlive(), 200);
-    else
-        _response.init(srcDir, _request.path(), false, 400);
-    _response.makeResponse(_writeBuff);
-    // 响应头
-    _iov[0].iov_base = const_cast<char*>(_writeBuff.peek());
-    _iov[0].iov_len = _writeBuff.readableBytes();
-    _iovCnt = 1;
-    // 文件
-    if (_response.fileLen() > 0 && _response.file()) {
-        _iov[1].iov_base = _response.file();
-        _iov[1].iov_len = _response.fileLen();
-        _iovCnt = 2;
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", _response.fileLen() , _iovCnt, toWriteBytes());
+    _buildIov();
+    LOG_DEBUG("pipelined:%d, iov:%d  to %d", (int)_responses.size(), iovCnt(), toWriteBytes());
+    return true;
+}
+
+bool HttpConn::takeVerify(HttpRequest::Credential *cred) {
+    if (_verify != VERIFY_PENDING)
+        return false;
+    *cred = _request->credential();
+    _verify = VERIFY_RUNNING;
     return true;
 }
 
+void HttpConn::onVerified(bool ok) {
+    assert(_verify == VERIFY_RUNNING);
+    _request->setVerified(ok);
+    _verify = VERIFY_DONE;
+}
+
+bool HttpConn::isVerifying() const { return _verify != VERIFY_NONE; }
+
+HttpRequest& HttpConn::_acquireRequest() {
+    static_assert(sizeof(HttpRequest) <= ChunkPool::CHUNK_SIZE && alignof(HttpRequest) <= alignof(std::max_align_t),
+                  "HttpRequest must fit in a chunk");
+    if (!_request)
+        _request = new (ChunkPool::acquire()) HttpRequest(&_arena);
+    return *_request;
+}
+
+// 上一轮已全部发完: 析构响应 (释放文件映射), 放弃 arena 中的容器后整体回收
+void HttpConn::_endRound() {
+    for (HttpResponse *response : _responses)
+        response->~HttpResponse();
+    arenaDrop(_responses);
+    arenaDrop(_headerEnd);
+    arenaDrop(_iov);
+    if (_request)
+        _request->dropArena();
+    _arena.reset();
+    _writeBuff.retrieveAll();
+    _iovIdx = _iovRemain = 0;
+    _fileRemain = 0;
+}
+
+void HttpConn::_releaseState() {
+    _verify = VERIFY_NONE;
+    _endRound();
+    if (_request) {
+        _request->~HttpRequest();
+        ChunkPool::release(_request);
+        _request = nullptr;
+    }
+    _arena.release();
+}
+
+// 写缓冲区由多个块组成, 每段响应头按块输出 iovec
+void HttpConn::_buildIov() {
+    _fileOffset = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < _responses.size(); i++) {
+        HttpResponse &response = *_responses[i];
+        if (response.fileLen() > 0 && response.file()) {
+            // 相邻的响应头合并成一个 iovec, 遇到文件内容才切开
+            _writeBuff.appendIov(_iov, start, _headerEnd[i] - start);
+            _iov.push_back({ response.file(), response.fileLen() });
+            start = _headerEnd[i];
+        } else if (response.fileLen() > 0 && response.fileFd() >= 0) {
+            _fileRemain = response.fileLen();
+        }
+    }
+    if (start < _writeBuff.readableBytes())
+        _writeBuff.appendIov(_iov, start, _writeBuff.readableBytes() - start);
+    _iovRemain = 0;
+    for (const struct iovec &v : _iov)
+        _iovRemain += v.iov_len;
+}
+
 }
@@ -7,11 +7,17 @@
 #ifndef __HTTPCONN_H__
 #define __HTTPCONN_H__
 
+#include <new>
+#include <memory>
+#include <vector>
+#include <memory_resource>
 #include <cstdlib>          // atoi()
 
 #include <arpa/inet.h>    // sockaddr_in
 #include <sys/types.h>
 #include <sys/uio.h>        // readv / writev
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 
 #include "httprequest.h"
 #include "httpresponse.h"
@@ -30,6 +36,14 @@ public:
     ssize_t read(int *saveErrno);
     ssize_t write(int *saveErrno);
 
+    // 供完成式 I/O (io_uring) 使用: 数据由事件循环收发, 这里只维护缓冲区状态
+    void appendRead(const char *data, size_t len);
+    const struct iovec* iov() const;
+    int iovCnt() const;
+    void hasWritten(size_t len);
+    size_t fileRemain() const;
+    ssize_t sendFile(int *saveErrno);
+
     void close();
 
     int getFd() const;
@@ -37,24 +51,55 @@ public:
     const char* getIP() const;
     sockaddr_in getAddr() const;
     bool isKeepAlive() const;
+    bool isClosed() const;
     int toWriteBytes();
+    // 没有未发完的响应, 不在等待数据库, 读缓冲区中也没有收到一半的请求: 排空时可以直接关闭
+    bool isIdle() const;
 
     bool process();
 
+    // 登录/注册请求解析完后要访问数据库: process() 停在该请求, 由事件循环取走表单交给阻塞执行器,
+    // 结果回到事件循环后 onVerified(), 再次 process() 从该请求继续
+    bool takeVerify(HttpRequest::Credential *cred);
+    void onVerified(bool ok);
+    bool isVerifying() const;
+
     static bool isET;
     static const char *srcDir;
     static std::atomic<int> userCount;
+    static std::atomic<bool> isDraining;   // 排空中: 响应一律带 Connection: close
+    static int pipelineMax;                 // 每轮最多应答的流水线请求数
+
+private:
+    enum VERIFY_STATE {
+        VERIFY_NONE = 0,
+        VERIFY_PENDING,     // 已解析, 等待事件循环取走
+        VERIFY_RUNNING,     // 在阻塞执行器中
+        VERIFY_DONE,        // 结果已回来, 下次 process() 生成响应
+    };
+
+    HttpRequest& _acquireRequest();
+    void _endRound();
+    void _releaseState();
+    void _buildIov();
 
 private:
     bool                _isClosed;
+    bool                _isKeepAlive;       // 本轮最后一个响应是否保持连接
+    VERIFY_STATE        _verify;
     int                 _fd;
-    int                 _iovCnt;
     struct sockaddr_in  _addr;
-    struct iovec        _iov[2];
-    Buffer              _readBuff;
-    Buffer              _writeBuff;
-    HttpRequest         _request;
-    HttpResponse        _response;
+    size_t              _iovIdx;            // 第一个未发完的 iovec
+    size_t              _iovRemain;
+    off_t               _fileOffset;        // sendfile 模式下文件的发送进度
+    size_t              _fileRemain;
+    ChainBuffer         _readBuff;
+    ChainBuffer         _writeBuff;
+    Arena               _arena;             // 本轮请求/响应的字符串与容器, 每轮开始时整体回收
+    HttpRequest         *_request;          // 构造在池块中, 连接空闲时归还
+    std::pmr::vector<struct iovec> _iov;    // 本轮所有响应按序排列: 响应头 [+ 文件]
+    std::pmr::vector<size_t> _headerEnd;    // 每个响应头在写缓冲区中的结束位置
+    std::pmr::vector<HttpResponse*> _responses;     // 本轮的响应, 构造在 arena 中
 };
 
 }
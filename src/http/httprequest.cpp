@@ -5,11 +5,12 @@
  * @date 2022-08-20
  */
 #include "httprequest.h"
+#include "../pool/asyncsql.h"
 
 namespace wsv
 {
 
-const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML {
+const std::unordered_set<std::string_view> HttpRequest::DEFAULT_HTML {
         "/index",
         "/register",
         "/login",
@@ -18,114 +19,368 @@ const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML {
         "/picture",
 };
 
-const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG {
+const std::unordered_map<std::string_view, int> HttpRequest::DEFAULT_HTML_TAG {
         {"/register.html", 0}, 
         {"/login.html", 1},
 };
 
-HttpRequest::HttpRequest() : _state(REQUEST_LINE), _method(""), _path(""), _version(""), _body("") { _header.clear(); _post.clear(); }
+const char* const HttpRequest::METHOD_NAME[] = {
+    "", "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH",
+};
+
+/*
+ * 已知头部的完美哈希: 由长度与首尾字符 (折叠大小写) 算出槽位, 编译期检查没有冲突.
+ * 命中槽位后再做一次不区分大小写的比较, 排除恰好落在同一槽位的未知头部.
+ */
+static constexpr std::string_view KNOWN_HEADER_NAME[HttpRequest::HDR_KNOWN_NUM] = {
+    "connection", "content-length", "content-type", "host",
+    "if-none-match", "range", "accept-encoding", "transfer-encoding",
+};
+
+static constexpr size_t HEADER_SLOTS = 16;
+
+static constexpr size_t headerSlot(std::string_view name) {
+    return (name.size() * 2 + (name.front() | 0x20) + (name.back() | 0x20)) & (HEADER_SLOTS - 1);
+}
+
+static constexpr uint32_t knownLengths() {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < HttpRequest::HDR_KNOWN_NUM; i++)
+        mask |= 1u << KNOWN_HEADER_NAME[i].size();
+    return mask;
+}
+
+struct HeaderSlots
+{
+    int8_t id[HEADER_SLOTS];
+};
+
+static constexpr HeaderSlots buildHeaderSlots() {
+    HeaderSlots slots{};
+    for (size_t i = 0; i < HEADER_SLOTS; i++)
+        slots.id[i] = HttpRequest::HDR_UNKNOWN;
+    for (size_t i = 0; i < HttpRequest::HDR_KNOWN_NUM; i++)
+        slots.id[headerSlot(KNOWN_HEADER_NAME[i])] = static_cast<int8_t>(i);
+    return slots;
+}
+
+static constexpr uint32_t KNOWN_LENGTHS = knownLengths();
+static constexpr HeaderSlots HEADER_SLOT = buildHeaderSlots();
 
+static constexpr bool isPerfectHash() {
+    for (size_t i = 0; i < HttpRequest::HDR_KNOWN_NUM; i++) {
+        if (HEADER_SLOT.id[headerSlot(KNOWN_HEADER_NAME[i])] != static_cast<int8_t>(i) || KNOWN_HEADER_NAME[i].size() < 4
+                || KNOWN_HEADER_NAME[i].size() >= 32)
+            return false;
+    }
+    return true;
+}
+
+static_assert(isPerfectHash(), "known header names collide or have unsupported length, adjust headerSlot()");
+
+template <typename T>
+static inline T load(const char *p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * 与小写的已知头部名比较: 每字节 | 0x20 折叠大小写, 按 8/4 字节整块比较, 末块与前一块重叠.
+ * 已知头部名只含字母与 '-', 折叠后唯一的误判是 '\r' 与 '-', 而头部名中不会出现 '\r'.
+ */
+static bool equalsLower(std::string_view name, std::string_view lower) {
+    const char *a = name.data(), *b = lower.data();
+    size_t len = lower.size();
+    if (len < 8) {
+        const uint32_t FOLD = 0x20202020u;
+        return ((load<uint32_t>(a) | FOLD) == load<uint32_t>(b)) && ((load<uint32_t>(a + len - 4) | FOLD) == load<uint32_t>(b + len - 4));
+    }
+    const uint64_t FOLD = 0x2020202020202020ull;
+    for (size_t i = 0; i + 8 < len; i += 8)
+        if ((load<uint64_t>(a + i) | FOLD) != load<uint64_t>(b + i))
+            return false;
+    return (load<uint64_t>(a + len - 8) | FOLD) == load<uint64_t>(b + len - 8);
+}
+
+// 路径/请求体/表单都从 mr 分配, 由所属连接在一轮请求处理完后整体回收
+HttpRequest::HttpRequest(std::pmr::memory_resource *mr)
+    : _state(REQUEST_LINE), _method(UNKNOWN_METHOD), _version(0), _isKeepAlive(false), _verifyTag(-1), _data(nullptr), _length(0), _contentLength(0),
+      _pathOff(0), _pathLen(0), _path(mr), _body(mr), _known(), _headerCnt(0), _post(mr) { }
+
+// 头部表保留容量, 同一连接上后续请求不再分配内存
 void HttpRequest::init() {
     _state = REQUEST_LINE;
-    _method = _path = _version = _body = "";
-    _header.clear();
-    _post.clear();
+    _method = UNKNOWN_METHOD;
+    _version = 0;
+    _isKeepAlive = false;
+    _verifyTag = -1;
+    _data = nullptr;
+    _length = 0;
+    _contentLength = 0;
+    _pathOff = _pathLen = 0;
+    dropArena();
+    memset(_known, 0, sizeof(_known));
+    _headerCnt = 0;
+    _moreHeader.clear();
 }
 
-bool HttpRequest::parse(Buffer &buff) {
-    const char CRLF[] = "\r\n";
-    if (buff.readableBytes() <= 0)
-        return false;
-    while (buff.readableBytes() && _state != FINISH) {
-        const char *lineEnd = std::search(buff.peek(), buff.beginWriteConst(), CRLF, CRLF+2);
-        std::string line(buff.peek(), lineEnd);
+// 放弃 arena 中的存储; 未完成的请求只有偏移, 解析中途调用也是安全的
+void HttpRequest::dropArena() {
+    arenaDrop(_path);
+    arenaDrop(_body);
+    arenaDrop(_post);
+}
+
+/*
+ * 逐行的状态机, 直接在读缓冲区上解析, 只记录相对请求起点的偏移.
+ * 数据不完整时返回 NO_REQUEST, 状态保留, 下次从未完成的行继续;
+ * 解析完不取走数据: 调用方生成响应后按 length() 取走, 下一次 parse 开始新的请求.
+ */
+HttpRequest::HTTP_CODE HttpRequest::parse(ChainBuffer &buff) {
+    if (_state == FINISH)
+        init();
+    // 请求可能跨越多个块, 解析前合并为连续内存
+    _data = buff.pullup();
+    const char *end = _data + buff.readableBytes();
+    const char *p = _data + _length;
+    while (_state != FINISH) {
+        if (_state == BODY) {
+            if (static_cast<size_t>(end - p) < _contentLength)
+                break;
+            _finish(p, _contentLength);
+            p += _contentLength;
+            break;
+        }
+        const char *colon = nullptr, *lineEnd;
+        if (_state == HEADERS) {
+            // 一次扫描同时定位 ':' 与行尾
+            const char *q = Scanner::findFirstOf(p, end, ':', '\r');
+            if (q < end && *q == ':')
+                colon = q++;
+            lineEnd = Scanner::findCRLF(q, end);
+        } else {
+            lineEnd = Scanner::findCRLF(p, end);
+        }
+        if (lineEnd == end)
+            break;  // 行不完整
         switch (_state) {
             case REQUEST_LINE:
-                if (!_parseRequestLine(line))
-                    return false;;
-                _parsePath();
-                break;
-            case HEADERS:
-                _parseHeader(line);
-                if (buff.readableBytes() <= 2)
-                    _state = FINISH;
+                if (!_parseRequestLine(p, lineEnd))
+                    return _badRequest(end);
                 break;
-            case BODY:
-                _parseBody(line);
+            case HEADERS: {
+                if (p != lineEnd) {
+                    _parseHeader(p, lineEnd, colon);
+                    break;
+                }
+                // 空行: 头部结束
+                if (!_parseContentLength())
+                    return _badRequest(end);
+                std::string_view conn = header(HDR_CONNECTION);
+                _isKeepAlive = _version == 11 && conn.size() == 10 && strncasecmp(conn.data(), "keep-alive", 10) == 0;
+                if (_contentLength > 0)
+                    _state = BODY;
+                else
+                    _finish(nullptr, 0);
                 break;
+            }
             default:
                 break;
         }
-        if (lineEnd == buff.beginWrite())
-            break;
-        buff.retrieveUntil(lineEnd + 2);
+        p = lineEnd + 2;
     }
-    LOG_DEBUG("[%s], [%s], [%s]", _method.c_str(), _path.c_str(), _version.c_str());
-    return true;
+    _length = p - _data;
+    if (_state != FINISH) {
+        if (_state != BODY && static_cast<size_t>(end - _data) > MAX_HEADER_SIZE) {
+            LOG_WARN("Request header too large");
+            return _badRequest(end);
+        }
+        return NO_REQUEST;
+    }
+    LOG_DEBUG("[%s], [%s], [%s]", method().c_str(), _path.c_str(), version().c_str());
+    return GET_REQUEST;
 }
 
-std::string HttpRequest::path() const { return _path; }
+size_t HttpRequest::length() const { return _length; }
 
-std::string& HttpRequest::path() { return _path; }
+const std::pmr::string& HttpRequest::path() const { return _path; }
 
-std::string HttpRequest::method() const { return _method; }
+std::pmr::string& HttpRequest::path() { return _path; }
 
-std::string HttpRequest::version() const { return _version; }
+std::string HttpRequest::method() const { return METHOD_NAME[_method]; }
 
-std::string HttpRequest::getPost(const std::string &key) const {
-    if (key == "") {
-        LOG_ERROR("HttpRequest > getPost: key is \"\"");
+HttpRequest::METHOD HttpRequest::methodId() const { return _method; }
+
+std::string HttpRequest::version() const {
+    if (_version == 0)
         return "";
+    return std::to_string(_version / 10) + "." + std::to_string(_version % 10);
+}
+
+// 返回值指向读缓冲区, 只在请求被取走前有效; 同名头部取第一个
+std::string_view HttpRequest::header(HEADER_ID id) const {
+    if (id >= HDR_KNOWN_NUM || _known[id] == 0)
+        return std::string_view();
+    return _value(_headerAt(_known[id] - 1));
+}
+
+// 头部名不区分大小写
+std::string_view HttpRequest::header(std::string_view name) const {
+    HEADER_ID id = headerId(name);
+    if (id != HDR_UNKNOWN)
+        return header(id);
+    for (size_t i = 0; i < _headerCnt; i++) {
+        const Header &h = _headerAt(i);
+        if (h.nameLen == name.size() && strncasecmp(_data + h.nameOff, name.data(), name.size()) == 0)
+            return _value(h);
     }
-    if (_post.count(key) == 1)
-        return _post.find(key)->second;
-    return "";
+    return std::string_view();
+}
+
+HttpRequest::HEADER_ID HttpRequest::headerId(std::string_view name) {
+    // 长度不属于任何已知头部时直接排除, 大部分未知头部到此为止
+    if (name.size() >= 32 || !(KNOWN_LENGTHS >> name.size() & 1))
+        return HDR_UNKNOWN;
+    int8_t id = HEADER_SLOT.id[headerSlot(name)];
+    if (id == HDR_UNKNOWN || KNOWN_HEADER_NAME[id].size() != name.size() || !equalsLower(name, KNOWN_HEADER_NAME[id]))
+        return HDR_UNKNOWN;
+    return static_cast<HEADER_ID>(id);
+}
+
+const HttpRequest::Header& HttpRequest::_headerAt(size_t i) const {
+    return i < INLINE_HEADERS ? _header[i] : _moreHeader[i - INLINE_HEADERS];
 }
 
-std::string HttpRequest::getPost(const char *key) const {
-    if (!key) {
-        LOG_ERROR("HttpRequest > getPost: key is nullptr");
+// OWS value OWS
+std::string_view HttpRequest::_value(const Header &h) const {
+    const char *value = _data + h.valueOff, *end = value + h.valueLen;
+    while (value < end && (*value == ' ' || *value == '\t'))
+        ++value;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    return std::string_view(value, end - value);
+}
+
+std::string HttpRequest::getPost(std::string_view key) const {
+    if (key.empty()) {
+        LOG_ERROR("HttpRequest > getPost: key is \"\"");
         return "";
     }
-    if (_post.count(key) == 1)
-        return _post.find(key)->second;
+    auto it = _post.find(std::pmr::string(key, _post.get_allocator()));
+    if (it != _post.end())
+        return std::string(it->second);
     return "";
 }
 
-bool HttpRequest::isKeepAlive() const {
-    if (_header.count("Connection") == 1)
-        return _header.find("Connection")->second == "keep-alive" && _version == "1.1";
-    return false;
+bool HttpRequest::isKeepAlive() const { return _isKeepAlive; }
+
+bool HttpRequest::needVerify() const { return _verifyTag >= 0; }
+
+// 复制一份表单: 连接可能在校验期间超时关闭, 请求随之回收
+HttpRequest::Credential HttpRequest::credential() const {
+    return Credential{ getPost("username"), getPost("password"), _verifyTag == 1 };
+}
+
+void HttpRequest::setVerified(bool ok) {
+    _path = ok ? "/welcome.html" : "/error.html";
+    _verifyTag = -1;
 }
 
-bool HttpRequest::_parseRequestLine(const std::string &line) {
-    std::regex pattern("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    std::smatch subMatch;
-    if (std::regex_match(line, subMatch, pattern)) {
-        _method = subMatch[1];
-        _path = subMatch[2];
-        _version = subMatch[3];
-        _state = HEADERS;
-        return true;
+// METHOD SP request-target SP HTTP/x.y
+bool HttpRequest::_parseRequestLine(const char *begin, const char *end) {
+    const char *sp1 = Scanner::find(begin, end, ' ');
+    const char *sp2 = sp1 < end ? Scanner::find(sp1 + 1, end, ' ') : end;
+    if (end - sp2 != 9 || memcmp(sp2 + 1, "HTTP/", 5) != 0
+            || !isdigit(sp2[6]) || sp2[7] != '.' || !isdigit(sp2[8])) {
+        LOG_ERROR("RequestLine Error");
+        return false;
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    _method = _parseMethod(begin, sp1 - begin);
+    _pathOff = static_cast<uint32_t>(sp1 + 1 - _data);
+    _pathLen = static_cast<uint32_t>(sp2 - sp1 - 1);
+    _version = (sp2[6] - '0') * 10 + (sp2[8] - '0');
+    _state = HEADERS;
+    return true;
 }
 
-void HttpRequest::_parseHeader(const std::string &line) {
-    std::regex pattern("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    if (std::regex_match(line, subMatch, pattern))
-        _header[subMatch[1]] = subMatch[2];
+// name ":" value, 没有 ':' 的行忽略; 只记录位置, 值在查找时才处理
+void HttpRequest::_parseHeader(const char *begin, const char *end, const char *colon) {
+    if (!colon)
+        return;
+    Header h = { static_cast<uint32_t>(begin - _data), static_cast<uint32_t>(colon - begin),
+            static_cast<uint32_t>(colon + 1 - _data), static_cast<uint32_t>(end - colon - 1) };
+    HEADER_ID id = headerId(std::string_view(begin, colon - begin));
+    if (id != HDR_UNKNOWN && _known[id] == 0)
+        _known[id] = static_cast<uint16_t>(_headerCnt + 1);
+    if (_headerCnt < INLINE_HEADERS)
+        _header[_headerCnt] = h;
     else
-        _state = BODY;
+        _moreHeader.push_back(h);
+    ++_headerCnt;
+}
+
+// 只支持 Content-Length 定长的请求体
+bool HttpRequest::_parseContentLength() {
+    if (_known[HDR_TRANSFER_ENCODING]) {
+        LOG_WARN("Transfer-Encoding unsupported");
+        return false;
+    }
+    std::string_view len = header(HDR_CONTENT_LENGTH);
+    _contentLength = 0;
+    for (char c : len) {
+        if (!isdigit(c) || _contentLength > MAX_BODY_SIZE)
+            return false;
+        _contentLength = _contentLength * 10 + (c - '0');
+    }
+    return _contentLength <= MAX_BODY_SIZE;
 }
 
-void HttpRequest::_parseBody(const std::string &line) {
-    _body = line;
-    _parsePost();
+// 丢弃缓冲区中的全部数据, 回复 400 后关闭连接
+HttpRequest::HTTP_CODE HttpRequest::_badRequest(const char *end) {
+    _length = end - _data;
+    _isKeepAlive = false;
     _state = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    return BAD_REQUEST;
+}
+
+// 请求完整后才把路径与请求体复制到 arena
+void HttpRequest::_finish(const char *body, size_t len) {
+    _path.assign(_data + _pathOff, _pathLen);
+    _parsePath();
+    if (len > 0) {
+        _body.assign(body, len);
+        _parsePost();
+        LOG_DEBUG("Body:%s, len:%d", _body.c_str(), _body.size());
+    }
+    _state = FINISH;
+}
+
+HttpRequest::METHOD HttpRequest::_parseMethod(const char *begin, size_t len) {
+    switch (len) {
+        case 3:
+            if (memcmp(begin, "GET", 3) == 0) return GET;
+            if (memcmp(begin, "PUT", 3) == 0) return PUT;
+            break;
+        case 4:
+            if (memcmp(begin, "POST", 4) == 0) return POST;
+            if (memcmp(begin, "HEAD", 4) == 0) return HEAD;
+            break;
+        case 5:
+            if (memcmp(begin, "PATCH", 5) == 0) return PATCH;
+            if (memcmp(begin, "TRACE", 5) == 0) return TRACE;
+            break;
+        case 6:
+            if (memcmp(begin, "DELETE", 6) == 0) return DELETE;
+            break;
+        case 7:
+            if (memcmp(begin, "OPTIONS", 7) == 0) return OPTIONS;
+            if (memcmp(begin, "CONNECT", 7) == 0) return CONNECT;
+            break;
+        default:
+            break;
+    }
+    return UNKNOWN_METHOD;
 }
 
 void HttpRequest::_parsePath() {
@@ -140,17 +395,14 @@ void HttpRequest::_parsePath() {
 }
 
 void HttpRequest::_parsePost() {
-    if(_method == "POST" && _header["Content-Type"] == "application/x-www-form-urlencoded") {
+    if(_method == POST && header(HDR_CONTENT_TYPE) == "application/x-www-form-urlencoded") {
         _parseFromUrlEncoded();
-        if(DEFAULT_HTML_TAG.count(_path)) {
-            int tag = DEFAULT_HTML_TAG.find(_path)->second;
+        auto it = DEFAULT_HTML_TAG.find(_path);
+        if(it != DEFAULT_HTML_TAG.end()) {
+            int tag = it->second;
             LOG_DEBUG("Tag:%d", tag);
-            if(tag == 0 || tag == 1) {
-                if(UserVerify(_post["username"], _post["password"], tag == 1))
-                    _path = "/welcome.html";
-                else
-                    _path = "/error.html";
-            }
+            if(tag == 0 || tag == 1)
+                _verifyTag = static_cast<int8_t>(tag);
         }
     }
 }
@@ -159,13 +411,17 @@ void HttpRequest::_parsePost() {
 void HttpRequest::_parseFromUrlEncoded() {
     if(_body.size() == 0) { return; }
 
-    std::string key, value;
+    // 指向 _body, 就地解码只会改动当前位置之后的字符
+    std::string_view key, value;
     int i = 0, j = 0;
+    auto put = [this](std::string_view k, std::string_view v) {
+        _post[std::pmr::string(k, _post.get_allocator())].assign(v);
+    };
 
     for(int num = 0, n = _body.size(); i < n; i++)
         switch (_body[i]) {
             case '=':
-                key = _body.substr(j, i - j);
+                key = std::string_view(_body).substr(j, i - j);
                 j = i + 1;
                 break;
             case '+':
@@ -178,63 +434,180 @@ void HttpRequest::_parseFromUrlEncoded() {
                 i += 2;
                 break;
             case '&':
-                value = _body.substr(j, i - j);
+                value = std::string_view(_body).substr(j, i - j);
                 j = i + 1;
-                _post[key] = value;
-                LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
+                put(key, value);
+                LOG_DEBUG("%.*s = %.*s", (int)key.size(), key.data(), (int)value.size(), value.data());
                 break;
             default:
                 break;
         }
-    if(_post.count(key) == 0 && j < i) {
-        value = _body.substr(j, i - j);
-        _post[key] = value;
+    if(_post.count(std::pmr::string(key, _post.get_allocator())) == 0 && j < i) {
+        value = std::string_view(_body).substr(j, i - j);
+        put(key, value);
     }
 }
 
-bool HttpRequest::UserVerify(const std::string &name, const std::string &pwd, bool isLogin) {
-    if (name == "" || pwd == "") 
+bool HttpRequest::UserVerify(std::string_view name, std::string_view pwd, bool isLogin) {
+    if (name.empty() || pwd.empty())
         return false;
-    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
+    LOG_INFO("Verify name:%.*s pwd:%.*s", (int)name.size(), name.data(), (int)pwd.size(), pwd.data());
+
+    /* 查询用户及密码: 先查缓存, 同一用户名的并发查询只有一个访问数据库;
+     * 注册时过滤器确定用户名不存在则不查询, 直接插入, 重复的用户名由唯一键拒绝 */
+    bool match = false;
+    UserCache::STATUS status = UserCache::NOT_FOUND;
+    if (isLogin || UserFilter::Instance()->mayContain(name)) {
+        status = UserCache::Instance()->lookup(name, pwd, &match,
+                [name](std::string *stored) { return _selectUser(name, stored); });
+    }
+    if (status == UserCache::DB_ERROR)
+        return false;
+    if (isLogin)
+        return status == UserCache::FOUND && match;
+    /* 注册行为 且 用户名未被使用*/
+    if (status == UserCache::FOUND)
+        return false;
+    LOG_DEBUG("regirster!");
+    if (!_insertUser(name, pwd)) {
+        LOG_DEBUG("Insert error!");
+        return false;
+    }
+    UserFilter::Instance()->add(name);
+    UserCache::Instance()->put(name, pwd);
+    LOG_DEBUG( "UserVerify success!!");
+    return true;
+}
+
+/* 每个连接缓存预处理语句, 参数以二进制协议传递, 不拼接 SQL */
+UserCache::STATUS HttpRequest::_selectUser(std::string_view name, std::string *stored) {
     MYSQL* sql;
     SqlConnRAII scr(&sql,  SqlConnPool::Instance());
     if (!sql) {
         LOG_ERROR("HttpRequest > UserVerify: SqlConnRAII error");
-        return false;
+        return UserCache::DB_ERROR;
     }
+    MYSQL_STMT *stmt = SqlConnPool::Instance()->getStmt(sql, STMT_SELECT_USER, "SELECT password FROM user WHERE username=? LIMIT 1");
+    if (!stmt)
+        return UserCache::DB_ERROR;
+    MYSQL_BIND param[1], result[1];
+    memset(param, 0, sizeof(param));
+    memset(result, 0, sizeof(result));
+    _bindString(param[0], name);
+    char password[64];
+    unsigned long passwordLen = 0;
+    result[0].buffer_type = MYSQL_TYPE_STRING;
+    result[0].buffer = password;
+    result[0].buffer_length = sizeof(password);
+    result[0].length = &passwordLen;
+    if (mysql_stmt_bind_param(stmt, param) || mysql_stmt_execute(stmt) || mysql_stmt_bind_result(stmt, result)) {
+        LOG_ERROR("HttpRequest > UserVerify: %s", mysql_stmt_error(stmt));
+        SqlConnPool::Instance()->dropStmt(sql, STMT_SELECT_USER);
+        return UserCache::DB_ERROR;
+    }
+    UserCache::STATUS status = UserCache::NOT_FOUND;
+    int ret;
+    while ((ret = mysql_stmt_fetch(stmt)) == 0 || ret == MYSQL_DATA_TRUNCATED) {
+        // 密码超出缓冲区时不可能与表单一致, 按查询失败处理, 不写入缓存
+        status = ret == 0 ? UserCache::FOUND : UserCache::DB_ERROR;
+        if (ret == 0)
+            stored->assign(password, passwordLen);
+    }
+    mysql_stmt_free_result(stmt);
+    return status;
+}
 
-    char order[256] = {0};
-    /* 查询用户及密码 */
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
-    if(mysql_query(sql, order))
-        return false;
-    MYSQL_RES *res = mysql_store_result(sql);
-    mysql_num_fields(res);
-    MYSQL_FIELD *fields = mysql_fetch_fields(res);
+/* 启用批量提交时由后台线程与其他线程的注册合并到一个事务中提交 */
+bool HttpRequest::_insertUser(std::string_view name, std::string_view pwd) {
+    GroupCommit::RESULT result = GroupCommit::Instance()->submit([name, pwd](MYSQL *sql) {
+        MYSQL_STMT *stmt = SqlConnPool::Instance()->getStmt(sql, STMT_INSERT_USER, "INSERT INTO user(username, password) VALUES(?,?)");
+        if (!stmt)
+            return GroupCommit::FAILED;
+        MYSQL_BIND values[2];
+        memset(values, 0, sizeof(values));
+        _bindString(values[0], name);
+        _bindString(values[1], pwd);
+        if (mysql_stmt_bind_param(stmt, values) || mysql_stmt_execute(stmt)) {
+            // 用户名已被使用 (唯一键冲突) 时语句仍可复用
+            if (mysql_stmt_errno(stmt) == ER_DUP_ENTRY)
+                return GroupCommit::DUPLICATE;
+            SqlConnPool::Instance()->dropStmt(sql, STMT_INSERT_USER);
+            return GroupCommit::FAILED;
+        }
+        return GroupCommit::DONE;
+    });
+    return result == GroupCommit::DONE;
+}
 
-    bool flag = !isLogin ? true : false;
-    while(MYSQL_ROW row = mysql_fetch_row(res)) {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        std::string password(row[1]);
-        /* 注册行为 且 用户名未被使用*/
-        flag = isLogin ? (pwd == password ? true : false) : false;
+void HttpRequest::_bindString(MYSQL_BIND &bind, std::string_view value) {
+    // 输入参数的 length 为空时以 buffer_length 为长度
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = const_cast<char*>(value.data());
+    bind.buffer_length = value.size();
+}
+
+/*
+ * 与 UserVerify 相同的两步查询, 由事件循环的 AsyncSql 非阻塞执行:
+ * SELECT 完成后在回调中决定是否 INSERT, 最终结果交给 done, 都在事件循环线程中执行
+ */
+void HttpRequest::UserVerifyAsync(AsyncSql *sql, Credential cred, std::function<void(bool)> done) {
+    if (cred.name.empty() || cred.pwd.empty()) {
+        done(false);
+        return;
     }
-    mysql_free_result(res);
-    /* 注册行为 且 用户名未被使用*/
-    if(!isLogin && flag == true) {
-        LOG_DEBUG("regirster!");
-        memset(order, 0, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG( "%s", order);
-        if(mysql_query(sql, order)) { 
-            LOG_DEBUG( "Insert error!");
-            flag = false; 
+    LOG_INFO("Verify name:%s pwd:%s", cred.name.c_str(), cred.pwd.c_str());
+    if (!cred.isLogin && !UserFilter::Instance()->mayContain(cred.name)) {
+        _insertUserAsync(sql, std::move(cred), std::move(done));
+        return;
+    }
+    /* 缓存命中时不访问数据库; 事件循环不能等待, 未命中的查询不与其他线程合并 */
+    bool match = false;
+    if (UserCache::Instance()->peek(cred.name, cred.pwd, &match)) {
+        done(cred.isLogin && match);
+        return;
+    }
+    /* 非阻塞 API 只有文本协议的查询, 参数由执行的连接转义后拼接; 参数先于 cred 被移入回调取出 */
+    std::vector<std::string> params{ cred.name };
+    sql->query("SELECT username, password FROM user WHERE username=? LIMIT 1", std::move(params), [sql, cred = std::move(cred), done = std::move(done)](bool ok, MYSQL_RES *res) mutable {
+        if (!ok || !res) {
+            done(false);
+            return;
+        }
+        std::string stored;
+        bool found = _fetchUser(res, &stored);
+        if (found)
+            UserCache::Instance()->put(cred.name, stored);
+        if (cred.isLogin || found) {
+            done(cred.isLogin && found && stored == cred.pwd);
+            return;
+        }
+        /* 注册行为 且 用户名未被使用*/
+        _insertUserAsync(sql, std::move(cred), std::move(done));
+    });
+}
+
+void HttpRequest::_insertUserAsync(AsyncSql *sql, Credential cred, std::function<void(bool)> done) {
+    std::vector<std::string> params{ cred.name, cred.pwd };
+    sql->query("INSERT INTO user(username, password) VALUES(?,?)", std::move(params), [cred = std::move(cred), done = std::move(done)](bool inserted, MYSQL_RES*) {
+        if (inserted) {
+            UserFilter::Instance()->add(cred.name);
+            UserCache::Instance()->put(cred.name, cred.pwd);
+        } else {
+            LOG_DEBUG("Insert error!");
         }
+        done(inserted);
+    });
+}
+
+/* 取出查到的密码, 没有该用户时返回 false */
+bool HttpRequest::_fetchUser(MYSQL_RES *res, std::string *stored) {
+    bool found = false;
+    while(MYSQL_ROW row = mysql_fetch_row(res)) {
+        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
+        stored->assign(row[1] ? row[1] : "");
+        found = true;
     }
-    SqlConnPool::Instance()->freeConn(sql);
-    LOG_DEBUG( "UserVerify success!!");
-    return flag;
+    return found;
 }
 
 int HttpRequest::converHex(char ch) {
@@ -9,16 +9,29 @@
 
 #include <unordered_map>
 #include <unordered_set>
-#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
 
+#include <cctype>
 #include <errno.h>
+#include <strings.h>        // strncasecmp
 
+#include "scanner.h"
+#include "../buffer/arena.h"
+#include "../buffer/chainbuffer.h"
 #include "../log/log.h"
 #include "../pool/sqlconnRAII.h"
+#include "../pool/usercache.h"
+#include "../pool/userfilter.h"
+#include "../pool/groupcommit.h"
 
 namespace wsv
 {
 
+class AsyncSql;
+
 class HttpRequest
 {
 public:
@@ -28,6 +41,18 @@ public:
         BODY,
         FINISH
     };
+    enum METHOD {
+        UNKNOWN_METHOD = 0,
+        GET,
+        HEAD,
+        POST,
+        PUT,
+        DELETE,
+        CONNECT,
+        OPTIONS,
+        TRACE,
+        PATCH,
+    };
     enum HTTP_CODE {
         NO_REQUEST = 0,
         GET_REQUEST,
@@ -38,44 +63,118 @@ public:
         INTERNAL_ERROR,
         CLOSED_CONNECTION,
     };
+    /* 服务器会查看的头部, 以完美哈希直接定位; 其余头部只记录位置, 按名字线性查找 */
+    enum HEADER_ID {
+        HDR_CONNECTION = 0,
+        HDR_CONTENT_LENGTH,
+        HDR_CONTENT_TYPE,
+        HDR_HOST,
+        HDR_IF_NONE_MATCH,
+        HDR_RANGE,
+        HDR_ACCEPT_ENCODING,
+        HDR_TRANSFER_ENCODING,
+        HDR_KNOWN_NUM,
+        HDR_UNKNOWN = HDR_KNOWN_NUM,
+    };
+    /* 登录/注册表单, 解析时只记下, 由阻塞执行器访问数据库后再决定响应的页面 */
+    struct Credential
+    {
+        std::string name;
+        std::string pwd;
+        bool isLogin;
+    };
 
-    HttpRequest();
+    explicit HttpRequest(std::pmr::memory_resource *mr = std::pmr::get_default_resource());
     ~HttpRequest() = default;
 
     void init();
-    bool parse(Buffer &buff);
+    void dropArena();
+    HTTP_CODE parse(ChainBuffer &buff);
+    size_t length() const;
 
-    std::string path() const;
-    std::string& path();
+    const std::pmr::string& path() const;
+    std::pmr::string& path();
     std::string method() const;
+    METHOD methodId() const;
     std::string version() const;
-    std::string getPost(const std::string &key) const;
-    std::string getPost(const char *key) const;
+    std::string_view header(HEADER_ID id) const;
+    std::string_view header(std::string_view name) const;
+    static HEADER_ID headerId(std::string_view name);
+    std::string getPost(std::string_view key) const;
 
     bool isKeepAlive() const;
 
+    bool needVerify() const;
+    Credential credential() const;
+    void setVerified(bool ok);
+
+    static bool UserVerify(std::string_view name, std::string_view pwd, bool isLogin);
+    // 非阻塞版本, done 在 sql 所属的事件循环线程中执行
+    static void UserVerifyAsync(AsyncSql *sql, Credential cred, std::function<void(bool)> done);
+
 private:
-    bool _parseRequestLine(const std::string &line);
-    void _parseHeader(const std::string &line);
-    void _parseBody(const std::string &line);
+    static const size_t INLINE_HEADERS = 24;    // 常见请求的头部数不超过该值, 不分配内存
+
+    /* 解析结果以相对请求起点的偏移保存, 指向读缓冲区, 请求处理完之前不能取走 */
+    struct Header
+    {
+        uint32_t nameOff;
+        uint32_t nameLen;
+        uint32_t valueOff;          // ':' 之后, 首尾空白在查找时才去掉
+        uint32_t valueLen;
+    };
+
+    const Header& _headerAt(size_t i) const;
+    std::string_view _value(const Header &h) const;
+
+    bool _parseRequestLine(const char *begin, const char *end);
+    void _parseHeader(const char *begin, const char *end, const char *colon);
+    void _finish(const char *body, size_t len);
+    bool _parseContentLength();
+    HTTP_CODE _badRequest(const char *end);
+
+    static METHOD _parseMethod(const char *begin, size_t len);
 
     void _parsePath();
     void _parsePost();
     void _parseFromUrlEncoded();
 
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
+    /* SqlConnPool 中预处理语句的编号 */
+    enum STMT_ID {
+        STMT_SELECT_USER = 0,
+        STMT_INSERT_USER,
+    };
+    static UserCache::STATUS _selectUser(std::string_view name, std::string *stored);
+    static bool _insertUser(std::string_view name, std::string_view pwd);
+    static void _bindString(MYSQL_BIND &bind, std::string_view value);
+    static bool _fetchUser(MYSQL_RES *res, std::string *stored);
+    static void _insertUserAsync(AsyncSql *sql, Credential cred, std::function<void(bool)> done);
     static int converHex(char ch);
 
 private:
     PARSE_STATE _state;
-    std::string _method;
-    std::string _path;
-    std::string _version;
-    std::string _body;
-    std::unordered_map<std::string, std::string>        _header;
-    std::unordered_map<std::string, std::string>        _post;
-    static const std::unordered_set<std::string>        DEFAULT_HTML;
-    static const std::unordered_map<std::string, int>   DEFAULT_HTML_TAG;
+    METHOD      _method;
+    int         _version;           // major * 10 + minor
+    bool        _isKeepAlive;
+    int8_t      _verifyTag;         // 待校验的表单: 0 注册, 1 登录, -1 没有
+    const char  *_data;             // 本次 parse 时请求在读缓冲区中的起点
+    size_t      _length;            // 已解析的字节数, 跨多次 parse 保持
+    size_t      _contentLength;
+    uint32_t    _pathOff;           // 请求完整之前路径只记录位置, 不占 arena
+    uint32_t    _pathLen;
+    std::pmr::string _path;
+    std::pmr::string _body;
+    uint16_t    _known[HDR_KNOWN_NUM];  // 已知头部在头部表中的下标 + 1, 0 表示没有
+    uint32_t    _headerCnt;
+    Header      _header[INLINE_HEADERS];   // 前 INLINE_HEADERS 个头部, 其余放在 _moreHeader
+    std::vector<Header>                                 _moreHeader;
+    std::pmr::unordered_map<std::pmr::string, std::pmr::string> _post;
+    static const std::unordered_set<std::string_view>       DEFAULT_HTML;
+    static const std::unordered_map<std::string_view, int>  DEFAULT_HTML_TAG;
+    static const char* const                            METHOD_NAME[];
+
+    static const size_t MAX_HEADER_SIZE = 64 * 1024;    // 请求行与头部的上限
+    static const size_t MAX_BODY_SIZE = 1024 * 1024;
 };
 
 }
@@ -9,7 +9,7 @@
 namespace wsv
 {
 
-const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
+const std::unordered_map<std::string_view, std::string_view> HttpResponse::SUFFIX_TYPE = {
     { ".html",  "text/html" },
     { ".xml",   "text/xml" },
     { ".xhtml", "application/xhtml+xml" },
@@ -44,26 +44,39 @@ const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
     { 404, "/404.html" },
 };
 
-HttpResponse::HttpResponse() : _isKeepAlive(false), _code(-1), _mmFile(nullptr), _path(""), _srcDir("") { }
+// 过载时直接发送的预构造响应, 不走文件与拼接路径
+const char HttpResponse::BUSY_RESPONSE[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Connection: close\r\n"
+    "Retry-After: 1\r\n"
+    "Content-length: 0\r\n\r\n";
+
+size_t HttpResponse::sendfileMin = 0;
+
+HttpResponse::HttpResponse(std::pmr::memory_resource *mr)
+    : _isKeepAlive(false), _code(-1), _mmFile(nullptr), _mmFileStat(), _mr(mr) { }
 HttpResponse::~HttpResponse() { unMapFile(); }
 
-char* HttpResponse::file() { return _mmFile; }
-size_t HttpResponse::fileLen() const { return _mmFileStat.st_size; }
+char* HttpResponse::file() { return _cached ? const_cast<char*>(_cached->body.data()) : _mmFile; }
+int HttpResponse::fileFd() const { return _cachedFd ? _cachedFd->fd : -1; }
+size_t HttpResponse::fileLen() const { return _cached ? _cached->body.size() : _mmFileStat.st_size; }
 int HttpResponse::code() const { return _code; }
 
 void HttpResponse::unMapFile() {
     if (_mmFile) {
-        munmap(file(), fileLen());
+        munmap(_mmFile, _mmFileStat.st_size);
         _mmFile = nullptr;
     }
+    _cachedFd.reset();
+    _cached.reset();
 }
 
-void HttpResponse::init(const std::string &srcDir, std::string &path, bool iskeepAlive, int code) {
-    if (srcDir == "") {
+void HttpResponse::init(std::string_view srcDir, std::string_view path, bool iskeepAlive, int code) {
+    if (srcDir.empty()) {
         LOG_ERROR("HttpResponse > init: srcDir is \"\"");
         exit(EXIT_FAILURE);
     }
-    if (_mmFile) unMapFile();
+    unMapFile();
     _code = code;
     _isKeepAlive = iskeepAlive;
     _path = path;
@@ -72,82 +85,150 @@ void HttpResponse::init(const std::string &srcDir, std::string &path, bool iskee
     _mmFileStat = { 0 };
 }
 
-void HttpResponse::makeResponse(Buffer &buff) {
-    if (stat((_srcDir + _path).data(), &_mmFileStat) < 0 || S_ISDIR(_mmFileStat.st_mode))
+void HttpResponse::makeResponse(ChainBuffer &buff) {
+    // 缓存命中时不访问文件系统
+    if (FileCache::Instance()->isEnabled() && (_code == -1 || _code == 200) && _addCached(buff, false))
+        return;
+    // 请求本身有误时不再查找目标文件, 直接回 400 页面
+    if (_code == 400)
+        ;
+    else if (stat(_fullPath().data(), &_mmFileStat) < 0 || S_ISDIR(_mmFileStat.st_mode))
         _code = 404;
     else if (!(_mmFileStat.st_mode & S_IROTH))
         _code = 403;
     else if (_code == -1)
         _code = 200;
     _errorHtml();
+    if (FileCache::Instance()->isEnabled() && _addCached(buff, true))
+        return;
     _addStateLine(buff);
     _addHeader(buff);
     _addContent(buff);
 }
 
-void HttpResponse::errorContent(Buffer &buff, std::string message) {
-    std::string body, status;
-    body += "<html><title>Error</title><body bgcolor=\"ffffff\">";
-    status = CODE_STATUS.count(_code) == 1 ? CODE_STATUS.find(_code)->second : "Bad Request";
-    body += std::to_string(_code) + " : " + status + "\n"
-        + "<p>" + message + "</p><hr><em>WebServer</em></body></html>";
-    buff.append("Content-length: "  + std::to_string(body.size()) + "\r\n\r\n");
+void HttpResponse::errorContent(ChainBuffer &buff, std::string_view message) {
+    auto it = CODE_STATUS.find(_code);
+    std::string_view status = it != CODE_STATUS.end() ? std::string_view(it->second) : "Bad Request";
+    char code[16];
+    char *codeEnd = std::to_chars(code, code + sizeof(code), _code).ptr;
+    std::pmr::string body(_mr);
+    body.append("<html><title>Error</title><body bgcolor=\"ffffff\">").append(code, codeEnd)
+        .append(" : ").append(status).append("\n<p>").append(message).append("</p><hr><em>WebServer</em></body></html>");
+    _appendLength(buff, body.size());
     buff.append(body);
 }
 
 void HttpResponse::_errorHtml() {
     if (CODE_PATH.count(_code) == 1) {
         _path = CODE_PATH.find(_code)->second;
-        stat((_srcDir + _path).data(), &_mmFileStat);
+        stat(_fullPath().data(), &_mmFileStat);
     }
 }
 
-std::string HttpResponse::_getFileType() {
-    std::string::size_type idx = _path.find_last_of('.');
-    if (idx == std::string::npos)
+std::string_view HttpResponse::_getFileType() const {
+    std::string_view::size_type idx = _path.find_last_of('.');
+    if (idx == std::string_view::npos)
         return "text/plain";
-    std::string suffix = _path.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1)
-        return SUFFIX_TYPE.find(suffix)->second;
+    auto it = SUFFIX_TYPE.find(_path.substr(idx));
+    if (it != SUFFIX_TYPE.end())
+        return it->second;
     return "text/plain";
 }
 
-void HttpResponse::_addStateLine(Buffer &buff) {
-    std::string status;
+// 拼接出的完整路径以 '\0' 结尾, 可直接用于系统调用
+std::pmr::string HttpResponse::_fullPath() const {
+    std::pmr::string full(_mr);
+    full.reserve(_srcDir.size() + _path.size());
+    full.append(_srcDir).append(_path);
+    return full;
+}
+
+// 状态行与 Connection 头使用预先拼好的表
+void HttpResponse::_addStateLine(ChainBuffer &buff) {
     if (CODE_STATUS.count(_code) != 1)
         _code = 400;
-    status = CODE_STATUS.find(_code)->second;
-    buff.append("HTTP/1.1 " + std::to_string(_code) + " " + status + "\r\n");
+    buff.append(_statusHeader(_code, _isKeepAlive));
 }
 
-void HttpResponse::_addHeader(Buffer &buff) {
-    buff.append("Connection: ");
-    if (_isKeepAlive) {
-        buff.append("keep-alive\r\n");
-        buff.append("keep-alive: max=6, timeout=120\r\n");
-    } else {
-        buff.append("close\r\n");
-    }
-    buff.append("Content-type: " + _getFileType() + "\r\n");
+void HttpResponse::_addHeader(ChainBuffer &buff) {
+    buff.append("Content-type: ");
+    buff.append(_getFileType());
+    buff.append("\r\n");
+}
+
+// 错误页与普通文件共用缓存, 响应头由预先拼好的两段组成
+bool HttpResponse::_addCached(ChainBuffer &buff, bool load) {
+    FileCache *cache = FileCache::Instance();
+    std::shared_ptr<const FileCache::Entry> entry = cache->get(_path);
+    if (!entry && load)
+        entry = cache->load(_path, _getFileType());
+    if (!entry)
+        return false;
+    if (_code == -1)
+        _code = 200;
+    _cached = entry;
+    buff.append(_statusHeader(_code, _isKeepAlive));
+    buff.append(entry->header);
+    return true;
+}
+
+// 状态行与 Connection 头只有少数几种组合, 启动后第一次使用时拼好
+const std::string& HttpResponse::_statusHeader(int code, bool keepAlive) {
+    static const std::unordered_map<int, std::string> TABLE = [] {
+        std::unordered_map<int, std::string> table;
+        for (auto &kv : CODE_STATUS) {
+            std::string line = "HTTP/1.1 " + std::to_string(kv.first) + " " + kv.second + "\r\n";
+            table[kv.first * 2] = line + "Connection: close\r\n";
+            table[kv.first * 2 + 1] = line + "Connection: keep-alive\r\nkeep-alive: max=6, timeout=120\r\n";
+        }
+        return table;
+    }();
+    auto it = TABLE.find(code * 2 + (keepAlive ? 1 : 0));
+    return it != TABLE.end() ? it->second : TABLE.find(400 * 2)->second;
+}
+
+void HttpResponse::_appendLength(ChainBuffer &buff, size_t len) {
+    char num[24];
+    char *end = std::to_chars(num, num + sizeof(num), len).ptr;
+    buff.append("Content-length: ");
+    buff.append(num, end - num);
+    buff.append("\r\n\r\n");
 }
 
-void HttpResponse::_addContent(Buffer &buff) {
-    int srcFd = open((_srcDir + _path).data(), O_RDONLY);
+void HttpResponse::_addContent(ChainBuffer &buff) {
+    std::pmr::string full = _fullPath();
+    LOG_DEBUG("file path %s", full.data());
+    if (_mmFileStat.st_size == 0) {
+        buff.append("Content-length: 0\r\n\r\n");
+        return;
+    }
+
+    // 大文件: 由缓存的 fd 经 sendfile 直接从页缓存发送, 不占用户态映射
+    if (sendfileMin > 0 && static_cast<size_t>(_mmFileStat.st_size) >= sendfileMin) {
+        _cachedFd = FdCache::Instance()->get(full, _mmFileStat);
+        if (!_cachedFd) {
+            errorContent(buff, "File NotFound!");
+            return;
+        }
+        _appendLength(buff, _mmFileStat.st_size);
+        return;
+    }
+
+    int srcFd = open(full.data(), O_RDONLY | O_CLOEXEC);
     if(srcFd < 0) {
         errorContent(buff, "File NotFound!");
         return;
     }
 
     // 将文件映射到内存提高文件的访问速度MAP_PRIVATE 建立一个写入时拷贝的私有映射
-    LOG_DEBUG("file path %s", (_srcDir + _path).data());
-    int* mmRet = (int*)mmap(0, _mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1) {
+    void *mmRet = mmap(0, _mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    close(srcFd);
+    if(mmRet == MAP_FAILED) {
         errorContent(buff, "File NotFound!");
         return; 
     }
-    _mmFile = (char*)mmRet;
-    close(srcFd);
-    buff.append("Content-length: " + std::to_string(_mmFileStat.st_size) + "\r\n\r\n");
+    _mmFile = static_cast<char*>(mmRet);
+    _appendLength(buff, _mmFileStat.st_size);
 }
 
 }
@@ -8,12 +8,19 @@
 #define __HTTPRESPONSE_H__
 
 #include <unordered_map>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <charconv>         // to_chars
 #include <cassert>
 
 #include <fcntl.h>
 
 #include <sys/mman.h>
 
+#include "fdcache.h"
+#include "filecache.h"
+#include "../buffer/chainbuffer.h"
 #include "../log/log.h"
 
 namespace wsv
@@ -22,33 +29,45 @@ namespace wsv
 class HttpResponse
 {
 public:
-    HttpResponse();
+    explicit HttpResponse(std::pmr::memory_resource *mr = std::pmr::get_default_resource());
     ~HttpResponse();
 
-    void init(const std::string &srcDir, std::string &path, bool iskeepAlive = false, int code = -1);
-    void makeResponse(Buffer &buff);
+    void init(std::string_view srcDir, std::string_view path, bool iskeepAlive = false, int code = -1);
+    void makeResponse(ChainBuffer &buff);
     void unMapFile();
     char* file();
+    int fileFd() const;
     size_t fileLen() const;
-    void errorContent(Buffer &buff, std::string message);
+    void errorContent(ChainBuffer &buff, std::string_view message);
     int code() const;
 
+    static const char BUSY_RESPONSE[];
+    static size_t sendfileMin;      // 不小于该大小的文件走 sendfile, 0 表示全部 mmap
+
 private:
-    std::string _getFileType();
+    std::string_view _getFileType() const;
+    std::pmr::string _fullPath() const;
     void _errorHtml();
 
-    void _addStateLine(Buffer &buff);
-    void _addHeader(Buffer &buff);
-    void _addContent(Buffer &buff);
+    void _addStateLine(ChainBuffer &buff);
+    void _addHeader(ChainBuffer &buff);
+    void _addContent(ChainBuffer &buff);
+    bool _addCached(ChainBuffer &buff, bool load);
+
+    static const std::string& _statusHeader(int code, bool keepAlive);
+    static void _appendLength(ChainBuffer &buff, size_t len);
 
 private:
     bool        _isKeepAlive;
     int         _code;
     char        *_mmFile;
+    std::shared_ptr<const FdCache::File> _cachedFd;
+    std::shared_ptr<const FileCache::Entry> _cached;
     struct stat _mmFileStat;
-    std::string _path;
-    std::string _srcDir;
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
+    std::string_view _path;         // 指向请求的路径或错误页路径, 只在 makeResponse 期间使用
+    std::string_view _srcDir;
+    std::pmr::memory_resource *_mr; // 拼接路径/错误页等临时字符串从这里分配
+    static const std::unordered_map<std::string_view, std::string_view> SUFFIX_TYPE;
     static const std::unordered_map<int, std::string> CODE_STATUS;
     static const std::unordered_map<int, std::string> CODE_PATH;
 };
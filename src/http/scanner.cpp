@@ -0,0 +1,106 @@
+/**
+ * @file scanner.cpp
+ * @brief  请求解析用的分隔符扫描 (SSE2/AVX2, 运行时选择)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WSV_SCANNER_X86 1
+#endif
+
+namespace wsv
+{
+
+static const char* findScalar(const char *begin, const char *end, char a, char b) {
+    for (; begin < end; ++begin)
+        if (*begin == a || *begin == b)
+            return begin;
+    return end;
+}
+
+#ifdef WSV_SCANNER_X86
+__attribute__((target("sse2")))
+static const char* findSse2(const char *begin, const char *end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    for (; end - begin >= 16; begin += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask)
+            return begin + __builtin_ctz(mask);
+    }
+    return findScalar(begin, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char* findAvx2(const char *begin, const char *end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+    for (; end - begin >= 32; begin += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (mask)
+            return begin + __builtin_ctz(mask);
+    }
+    // 尾部在本函数内用 VEX 编码的 128 位指令处理, 避免 AVX 与传统 SSE 指令切换的开销
+    if (end - begin >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(va)),
+                    _mm_cmpeq_epi8(v, _mm256_castsi256_si128(vb))));
+        if (mask)
+            return begin + __builtin_ctz(mask);
+        begin += 16;
+    }
+    for (; begin < end; ++begin)
+        if (*begin == a || *begin == b)
+            return begin;
+    return end;
+}
+#endif
+
+static Scanner::LEVEL bestLevel() {
+#ifdef WSV_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return Scanner::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return Scanner::SSE2;
+#endif
+    return Scanner::SCALAR;
+}
+
+Scanner::LEVEL Scanner::_level = SCALAR;
+Scanner::FindFunc Scanner::_find = findScalar;
+
+// 静态初始化时选定实现, 之后只读
+static const bool scannerInit = Scanner::setLevel(bestLevel());
+
+const char* Scanner::findCRLF(const char *begin, const char *end) {
+    while ((begin = find(begin, end, '\r')) < end) {
+        if (begin + 1 == end)
+            return end;
+        if (begin[1] == '\n')
+            return begin;
+        ++begin;
+    }
+    return end;
+}
+
+Scanner::LEVEL Scanner::level() { return _level; }
+
+bool Scanner::setLevel(LEVEL level) {
+    if (level > bestLevel())
+        return false;
+    switch (level) {
+#ifdef WSV_SCANNER_X86
+        case AVX2: _find = findAvx2; break;
+        case SSE2: _find = findSse2; break;
+#endif
+        default: _find = findScalar; break;
+    }
+    _level = level;
+    return true;
+}
+
+}
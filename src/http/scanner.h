@@ -0,0 +1,49 @@
+/**
+ * @file scanner.h
+ * @brief  请求解析用的分隔符扫描 (SSE2/AVX2, 运行时选择)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __SCANNER_H__
+#define __SCANNER_H__
+
+#include <cstring>
+
+namespace wsv
+{
+
+/*
+ * 在 [begin, end) 中查找分隔符, 找不到时返回 end.
+ * x86-64 上按 CPU 支持选择 AVX2 (每次 32 字节) 或 SSE2 (16 字节), 其他平台用逐字节扫描;
+ * 只做不越过 end 的非对齐加载, 剩余不足一个向量的部分逐字节处理.
+ */
+class Scanner
+{
+public:
+    enum LEVEL {
+        SCALAR = 0,
+        SSE2,
+        AVX2,
+    };
+
+    static const char* find(const char *begin, const char *end, char c);
+    static const char* findFirstOf(const char *begin, const char *end, char a, char b);
+    static const char* findCRLF(const char *begin, const char *end);
+
+    static LEVEL level();
+    static bool setLevel(LEVEL level);      // 供基准测试切换实现, CPU 不支持时返回 false
+
+private:
+    typedef const char* (*FindFunc)(const char*, const char*, char, char);
+
+    static FindFunc _find;
+    static LEVEL _level;
+};
+
+inline const char* Scanner::find(const char *begin, const char *end, char c) { return _find(begin, end, c, c); }
+
+inline const char* Scanner::findFirstOf(const char *begin, const char *end, char a, char b) { return _find(begin, end, a, b); }
+
+}
+
+#endif // __SCANNER_H__
@@ -0,0 +1,65 @@
+/**
+ * @file adaptivelimiter.cpp
+ * @brief  按排队时间自适应调整的并发上限 (AIMD)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "adaptivelimiter.h"
+
+namespace wsv
+{
+
+AdaptiveLimiter::AdaptiveLimiter(int initLimit, int minLimit, int maxLimit, int64_t targetWaitUs, double lowRatio)
+    : _waitUs(0), _lastDecrease(), _minLimit(std::max(minLimit, 1)), _maxLimit(std::max(maxLimit, _minLimit)),
+    _targetWaitUs(targetWaitUs), _lowRatio(lowRatio), _inflight(0), _curWaitUs(0) {
+    _limit = std::min(std::max(initLimit, _minLimit), _maxLimit);
+    _curLimit = static_cast<int>(_limit);
+    _rejected[HIGH] = 0;
+    _rejected[LOW] = 0;
+}
+
+bool AdaptiveLimiter::tryAcquire(PRIORITY prio) {
+    int lim = _curLimit.load(std::memory_order_relaxed);
+    if (prio == LOW)
+        lim = std::max(1, static_cast<int>(lim * _lowRatio));
+    if (_inflight.fetch_add(1, std::memory_order_relaxed) >= lim) {
+        _inflight.fetch_sub(1, std::memory_order_relaxed);
+        _rejected[prio].fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void AdaptiveLimiter::onStart(int64_t waitUs) {
+    std::lock_guard<std::mutex> locker(_mtx);
+    _waitUs = _waitUs * 0.9 + waitUs * 0.1;
+    if (waitUs > _targetWaitUs) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - _lastDecrease >= std::chrono::milliseconds(DECREASE_INTERVAL_MS)) {
+            _limit = std::max<double>(_minLimit, _limit * 0.9);
+            _lastDecrease = now;
+        }
+    } else if (_inflight.load(std::memory_order_relaxed) * 2 >= _limit) {
+        // 每放行约 limit 个请求上限加 1
+        _limit = std::min<double>(_maxLimit, _limit + 1.0 / _limit);
+    }
+    _curLimit.store(static_cast<int>(_limit), std::memory_order_relaxed);
+    _curWaitUs.store(static_cast<int64_t>(_waitUs), std::memory_order_relaxed);
+}
+
+void AdaptiveLimiter::release() { _inflight.fetch_sub(1, std::memory_order_relaxed); }
+
+// 超过低优先级的份额后才需要区分请求类型
+bool AdaptiveLimiter::nearLimit() const {
+    return _inflight.load(std::memory_order_relaxed) >= _curLimit.load(std::memory_order_relaxed) * _lowRatio;
+}
+
+int AdaptiveLimiter::limit() const { return _curLimit.load(std::memory_order_relaxed); }
+
+int AdaptiveLimiter::inflight() const { return _inflight.load(std::memory_order_relaxed); }
+
+int64_t AdaptiveLimiter::queueWaitUs() const { return _curWaitUs.load(std::memory_order_relaxed); }
+
+uint64_t AdaptiveLimiter::rejected(PRIORITY prio) const { return _rejected[prio].load(std::memory_order_relaxed); }
+
+}
@@ -0,0 +1,67 @@
+/**
+ * @file adaptivelimiter.h
+ * @brief  按排队时间自适应调整的并发上限 (AIMD)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __ADAPTIVELIMITER_H__
+#define __ADAPTIVELIMITER_H__
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <cstdint>
+
+namespace wsv
+{
+
+/*
+ * 并发数 = 已放行但尚未处理完的请求数 (排队 + 执行).
+ * 任务开始执行时上报排队时间: 超过目标值说明线程池已饱和, 上限乘性减小
+ * (每个窗口最多一次); 否则在上限确实被用到时加性增大.
+ * 低优先级 (落库的 POST) 只能用到上限的 lowRatio, 余量留给静态文件请求.
+ */
+class AdaptiveLimiter
+{
+public:
+    enum PRIORITY {
+        HIGH = 0,
+        LOW,
+    };
+
+    AdaptiveLimiter(int initLimit, int minLimit, int maxLimit, int64_t targetWaitUs, double lowRatio = 0.8);
+
+    bool tryAcquire(PRIORITY prio);
+    void onStart(int64_t waitUs);
+    void release();
+
+    bool nearLimit() const;
+    int limit() const;
+    int inflight() const;
+    int64_t queueWaitUs() const;
+    uint64_t rejected(PRIORITY prio) const;
+
+private:
+    std::mutex _mtx;
+    double _limit;
+    double _waitUs;                         // 排队时间的指数滑动平均
+    std::chrono::steady_clock::time_point _lastDecrease;
+
+    const int _minLimit;
+    const int _maxLimit;
+    const int64_t _targetWaitUs;
+    const double _lowRatio;
+
+    std::atomic<int> _curLimit;             // _limit 取整, 供 tryAcquire 无锁读取
+    std::atomic<int> _inflight;
+    std::atomic<int64_t> _curWaitUs;
+    std::atomic<uint64_t> _rejected[2];
+
+    static constexpr int DECREASE_INTERVAL_MS = 100;
+};
+
+}
+
+#endif // __ADAPTIVELIMITER_H__
@@ -0,0 +1,338 @@
+/**
+ * @file asyncsql.cpp
+ * @brief  非阻塞数据库客户端, 由事件循环驱动
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "asyncsql.h"
+
+#include <mysql/errmsg.h>   // CR_SERVER_GONE_ERROR
+
+namespace wsv
+{
+
+AsyncSql::AsyncSql(Epoller *epoller, HeapTimer *timer)
+    : _epoller(epoller), _timer(timer), _port(0), _queueTimeoutMS(0), _inflight(0) { }
+
+AsyncSql::~AsyncSql() {
+    // 排队与在途的回调不再执行
+    for (auto &conn : _conns)
+        _reset(*conn);
+}
+
+size_t AsyncSql::queueSize() const { return _queue.size(); }
+
+size_t AsyncSql::inflight() const { return _inflight; }
+
+void AsyncSql::query(std::string sql, Callback cb) { query(std::move(sql), std::vector<std::string>(), std::move(cb)); }
+
+#ifdef MYSQL_WAIT_READ  // MariaDB 客户端库的非阻塞 API
+
+bool AsyncSql::isSupported() { return true; }
+
+bool AsyncSql::init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connNum, int queueTimeoutMS) {
+    if (connNum <= 0)
+        return false;
+    _host = host;
+    _port = port;
+    _queueTimeoutMS = queueTimeoutMS;
+    _user = user;
+    _pwd = pwd;
+    _dbName = dbName;
+    for (int i = 0; i < connNum; i++) {
+        _conns.emplace_back(std::make_unique<Conn>());
+        _connect(*_conns.back());
+    }
+    return true;
+}
+
+/*
+ * 有空闲连接时立即发出, 否则排队. 所有连接都断开且未到重连时间时直接以失败回调,
+ * 不让请求无限等待; 回调可能在本函数返回前执行.
+ */
+void AsyncSql::query(std::string sql, std::vector<std::string> params, Callback cb) {
+    _expireQueue();
+    _queue.push_back({ std::move(sql), std::move(params), std::move(cb), Clock::now() });
+    for (auto &conn : _conns) {
+        if (conn->state == CLOSED && Clock::now() >= conn->retryAt)
+            _connect(*conn);
+        if (conn->state == IDLE && !_queue.empty())
+            _dispatch(*conn);
+    }
+    if (!_isAlive())
+        _failQueue();
+}
+
+bool AsyncSql::handleEvent(int fd, uint32_t events) {
+    for (auto &conn : _conns) {
+        if (conn->fd != fd)
+            continue;
+        if (conn->state == IDLE) {
+            // 空闲连接可读: 服务端关闭了连接 (wait_timeout 等), 立即重连
+            LOG_WARN("AsyncSql: idle connection closed by server, reconnect");
+            _reset(*conn);
+            _connect(*conn);
+        } else {
+            _resume(*conn, _fromEpoll(events, conn->waiting));
+        }
+        return true;
+    }
+    return false;
+}
+
+void AsyncSql::_connect(Conn &conn) {
+    conn.mysql = mysql_init(nullptr);
+    // 非阻塞模式下超时以 MYSQL_WAIT_TIMEOUT 交给事件循环的定时器; 不设置时服务端无响应, 查询永远在途
+    unsigned int connectTimeout = CONNECT_TIMEOUT_S, ioTimeout = IO_TIMEOUT_S;
+    if (!conn.mysql || mysql_options(conn.mysql, MYSQL_OPT_NONBLOCK, nullptr) != 0
+        || mysql_options(conn.mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout) != 0
+        || mysql_options(conn.mysql, MYSQL_OPT_READ_TIMEOUT, &ioTimeout) != 0
+        || mysql_options(conn.mysql, MYSQL_OPT_WRITE_TIMEOUT, &ioTimeout) != 0) {
+        LOG_ERROR("AsyncSql: init non-blocking connection error!");
+        _retry(conn);
+        return;
+    }
+    conn.state = CONNECTING;
+    _advance(conn, mysql_real_connect_start(&conn.connRet, conn.mysql, _host.c_str(), _user.c_str(), _pwd.c_str(),
+                                            _dbName.c_str(), _port, nullptr, 0));
+}
+
+// 连接空闲时取下一条排队的查询
+void AsyncSql::_dispatch(Conn &conn) {
+    // 过期查询的回调中可能发起查询, 已落在本连接上
+    _expireQueue();
+    if (conn.state != IDLE)
+        return;
+    if (_queue.empty()) {
+        // 空闲时只关注可读, 用于发现服务端关闭连接
+        _watch(conn, EPOLLIN | EPOLLRDHUP);
+        return;
+    }
+    Query query = std::move(_queue.front());
+    _queue.pop_front();
+    if (!_bind(conn.mysql, query, &conn.sql)) {
+        LOG_ERROR("AsyncSql: escape error!");
+        query.cb(false, nullptr);
+        _dispatch(conn);
+        return;
+    }
+    conn.cb = std::move(query.cb);
+    ++_inflight;
+    conn.state = QUERYING;
+    _advance(conn, mysql_real_query_start(&conn.queryErr, conn.mysql, conn.sql.data(), conn.sql.size()));
+}
+
+void AsyncSql::_resume(Conn &conn, int events) {
+    int status = 0;
+    switch (conn.state) {
+        case CONNECTING:
+            status = mysql_real_connect_cont(&conn.connRet, conn.mysql, events);
+            break;
+        case QUERYING:
+            status = mysql_real_query_cont(&conn.queryErr, conn.mysql, events);
+            break;
+        case STORING:
+            status = mysql_store_result_cont(&conn.res, conn.mysql, events);
+            break;
+        default:
+            return;
+    }
+    _advance(conn, status);
+}
+
+// status 非 0 表示客户端库在等待, 为 0 表示当前操作完成, 结果在 Conn 中
+void AsyncSql::_advance(Conn &conn, int status) {
+    if (status != 0) {
+        _wait(conn, status);
+        return;
+    }
+    switch (conn.state) {
+        case CONNECTING:
+            if (!conn.connRet) {
+                LOG_ERROR("AsyncSql: connect error: %s", mysql_error(conn.mysql));
+                _retry(conn);
+                if (!_isAlive())
+                    _failQueue();
+                return;
+            }
+            conn.retryMS = 0;
+            conn.state = IDLE;
+            _dispatch(conn);
+            break;
+        case QUERYING:
+            if (conn.queryErr) {
+                _finish(conn, false, nullptr);
+                return;
+            }
+            conn.state = STORING;
+            _advance(conn, mysql_store_result_start(&conn.res, conn.mysql));
+            break;
+        case STORING:
+            // 没有结果集的语句 (INSERT 等) 返回 nullptr 且列数为 0
+            _finish(conn, conn.res || mysql_field_count(conn.mysql) == 0, conn.res);
+            break;
+        default:
+            break;
+    }
+}
+
+void AsyncSql::_wait(Conn &conn, int status) {
+    ++conn.seq;
+    conn.waiting = status;
+    _watch(conn, _toEpoll(status));
+    if ((status & MYSQL_WAIT_TIMEOUT) && _timer && conn.fd >= 0) {
+        // 定时器以套接字为键, 与客户端连接的 fd 不会同时存在
+        _timer->add(conn.fd, static_cast<int>(mysql_get_timeout_value(conn.mysql)) * 1000,
+                    std::bind(&AsyncSql::_onTimeout, this, &conn, conn.seq));
+    }
+}
+
+void AsyncSql::_watch(Conn &conn, uint32_t events) {
+    int fd = mysql_get_socket(conn.mysql);
+    if (fd == conn.fd) {
+        if (events != conn.events && _epoller->modFd(fd, events))
+            conn.events = events;
+        return;
+    }
+    if (conn.fd >= 0)
+        _epoller->delFd(conn.fd);
+    conn.fd = fd;
+    conn.events = events;
+    if (fd >= 0 && !_epoller->addFd(fd, events))
+        LOG_ERROR("AsyncSql: add fd %d to epoller error!", fd);
+}
+
+void AsyncSql::_finish(Conn &conn, bool ok, MYSQL_RES *res) {
+    Callback cb = std::move(conn.cb);
+    conn.cb = nullptr;
+    conn.res = nullptr;
+    conn.state = IDLE;
+    --_inflight;
+    if (!ok) {
+        unsigned int err = mysql_errno(conn.mysql);
+        LOG_WARN("AsyncSql: query error %u: %s", err, mysql_error(conn.mysql));
+        if (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST) {
+            _reset(conn);
+            _connect(conn);
+        }
+    }
+    // 回调中可能继续发起查询, 可能就落在本连接上
+    cb(ok, res);
+    if (res)
+        mysql_free_result(res);
+    _dispatch(conn);
+}
+
+void AsyncSql::_reset(Conn &conn) {
+    if (conn.fd >= 0)
+        _epoller->delFd(conn.fd);
+    if (conn.mysql)
+        mysql_close(conn.mysql);
+    if (conn.res)
+        mysql_free_result(conn.res);
+    if (conn.state == QUERYING || conn.state == STORING)
+        --_inflight;
+    conn.mysql = nullptr;
+    conn.res = nullptr;
+    conn.fd = -1;
+    conn.events = 0;
+    conn.state = CLOSED;
+    ++conn.seq;
+}
+
+// 连接失败: 指数退避, 到时间后由下一次 query() 重新发起
+void AsyncSql::_retry(Conn &conn) {
+    _reset(conn);
+    conn.retryMS = conn.retryMS == 0 ? RETRY_MIN_MS : std::min(conn.retryMS * 2, RETRY_MAX_MS);
+    conn.retryAt = Clock::now() + Millisecond(conn.retryMS);
+}
+
+bool AsyncSql::_isAlive() const {
+    return std::any_of(_conns.begin(), _conns.end(), [](const std::unique_ptr<Conn> &conn) { return conn->state != CLOSED; });
+}
+
+void AsyncSql::_failQueue() {
+    std::deque<Query> queue;
+    queue.swap(_queue);
+    for (auto &query : queue)
+        query.cb(false, nullptr);
+}
+
+// 排队超过 _queueTimeoutMS 的查询以失败回调, 与阻塞执行器取连接超时相同
+void AsyncSql::_expireQueue() {
+    if (_queueTimeoutMS <= 0)
+        return;
+    TimeStamp deadline = Clock::now() - Millisecond(_queueTimeoutMS);
+    while (!_queue.empty() && _queue.front().enqueued <= deadline) {
+        Callback cb = std::move(_queue.front().cb);
+        _queue.pop_front();
+        cb(false, nullptr);
+    }
+}
+
+// 用执行语句的连接转义参数: 只有已连接的句柄知道服务端的 NO_BACKSLASH_ESCAPES 与协商的字符集
+bool AsyncSql::_bind(MYSQL *mysql, const Query &query, std::string *sql) {
+    sql->clear();
+    size_t next = 0;
+    for (const std::string &param : query.params) {
+        size_t pos = query.sql.find('?', next);
+        if (pos == std::string::npos)
+            return false;
+        sql->append(query.sql, next, pos - next);
+        size_t begin = sql->size();
+        sql->resize(begin + param.size() * 2 + 3);
+        (*sql)[begin] = '\'';
+        unsigned long len = mysql_real_escape_string(mysql, &(*sql)[begin + 1], param.data(), param.size());
+        if (len == static_cast<unsigned long>(-1))
+            return false;
+        sql->resize(begin + 1 + len);
+        sql->push_back('\'');
+        next = pos + 1;
+    }
+    sql->append(query.sql, next, std::string::npos);
+    return true;
+}
+
+void AsyncSql::_onTimeout(Conn *conn, uint32_t seq) {
+    if (conn->seq == seq)
+        _resume(*conn, MYSQL_WAIT_TIMEOUT);
+}
+
+uint32_t AsyncSql::_toEpoll(int status) {
+    uint32_t events = 0;
+    if (status & MYSQL_WAIT_READ) events |= EPOLLIN;
+    if (status & MYSQL_WAIT_WRITE) events |= EPOLLOUT;
+    if (status & MYSQL_WAIT_EXCEPT) events |= EPOLLPRI;
+    return events;
+}
+
+// 出错或挂断时按等待的读写事件通知客户端库, 由它读到错误并结束当前操作
+int AsyncSql::_fromEpoll(uint32_t events, int waiting) {
+    int status = 0;
+    if (events & EPOLLIN) status |= MYSQL_WAIT_READ;
+    if (events & EPOLLOUT) status |= MYSQL_WAIT_WRITE;
+    if (events & EPOLLPRI) status |= MYSQL_WAIT_EXCEPT;
+    if (events & (EPOLLERR | EPOLLHUP)) status |= waiting & (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+    return status;
+}
+
+#else   // 客户端库没有非阻塞 API, 调用方继续使用阻塞执行器
+
+bool AsyncSql::isSupported() { return false; }
+
+bool AsyncSql::init(const char*, int, const char*, const char*, const char*, int, int) { return false; }
+
+void AsyncSql::query(std::string, std::vector<std::string>, Callback cb) { cb(false, nullptr); }
+
+bool AsyncSql::handleEvent(int, uint32_t) { return false; }
+
+void AsyncSql::_reset(Conn &conn) {
+    if (conn.mysql)
+        mysql_close(conn.mysql);
+    conn.mysql = nullptr;
+    conn.state = CLOSED;
+}
+
+#endif
+
+}
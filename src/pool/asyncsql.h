@@ -0,0 +1,132 @@
+/**
+ * @file asyncsql.h
+ * @brief  非阻塞数据库客户端, 由事件循环驱动
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __ASYNCSQL_H__
+#define __ASYNCSQL_H__
+
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <mysql/mysql.h>
+
+#include "../log/log.h"
+#include "../server/epoller.h"
+#include "../timer/heaptimer.h"
+
+namespace wsv
+{
+
+/*
+ * 使用 MariaDB 客户端库的非阻塞 API (mysql_real_query_start / _cont 等):
+ * 每个连接的套接字注册到所属事件循环的 Epoller, 客户端库需要等待时返回,
+ * 套接字就绪后由事件循环调用 handleEvent() 继续. 一个线程可同时有 connNum 个查询在途,
+ * 没有空闲连接时查询排队, 排队超过 queueTimeoutMS 的以失败回调; 回调 (续体) 在事件循环线程中执行.
+ * 连接设置了连接与读写超时, 服务端无响应时查询以失败结束并重连.
+ * 只能在所属事件循环的线程中使用. 客户端库没有非阻塞 API (如 Oracle libmysqlclient) 时 init() 返回 false.
+ */
+class AsyncSql
+{
+public:
+    // ok 为语句是否执行成功; res 为结果集, 没有结果集的语句为 nullptr, 回调返回后释放
+    typedef std::function<void(bool ok, MYSQL_RES *res)> Callback;
+
+    AsyncSql(Epoller *epoller, HeapTimer *timer);
+    ~AsyncSql();
+
+    AsyncSql(const AsyncSql&) = delete;
+    AsyncSql& operator=(const AsyncSql&) = delete;
+
+    // 发起 connNum 个连接, 不等待连接完成; queueTimeoutMS 为 0 时排队不限时
+    bool init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connNum, int queueTimeoutMS = 0);
+    void query(std::string sql, Callback cb);
+    // sql 中的 ? 依次替换为加引号的 params; 由执行该语句的连接转义, 服从服务端的 NO_BACKSLASH_ESCAPES 与协商的字符集
+    void query(std::string sql, std::vector<std::string> params, Callback cb);
+
+    // fd 属于本对象的连接时处理事件并返回 true
+    bool handleEvent(int fd, uint32_t events);
+
+    size_t queueSize() const;       // 等待空闲连接的查询数
+    size_t inflight() const;        // 正在执行的查询数
+
+    static bool isSupported();
+
+private:
+    enum STATE {
+        CLOSED = 0,
+        CONNECTING,
+        IDLE,
+        QUERYING,       // mysql_real_query_start / _cont
+        STORING,        // mysql_store_result_start / _cont
+    };
+    struct Conn
+    {
+        MYSQL *mysql = nullptr;
+        int fd = -1;                // 已注册到 Epoller 的套接字
+        uint32_t events = 0;        // 已注册的事件, 相同时不再 modFd
+        STATE state = CLOSED;
+        int waiting = 0;            // 客户端库等待的 MYSQL_WAIT_*
+        uint32_t seq = 0;           // 每次等待递增, 过期的超时回调据此忽略
+        int retryMS = 0;            // 连接失败后的重连间隔
+        TimeStamp retryAt;
+        std::string sql;            // 参数已替换
+        Callback cb;
+        // 非阻塞调用的输出参数, 操作完成时有效
+        MYSQL *connRet = nullptr;
+        int queryErr = 0;
+        MYSQL_RES *res = nullptr;
+    };
+    struct Query
+    {
+        std::string sql;
+        std::vector<std::string> params;
+        Callback cb;
+        TimeStamp enqueued;
+    };
+
+    void _connect(Conn &conn);
+    void _dispatch(Conn &conn);
+    void _resume(Conn &conn, int events);
+    void _advance(Conn &conn, int status);
+    void _wait(Conn &conn, int status);
+    void _watch(Conn &conn, uint32_t events);
+    void _finish(Conn &conn, bool ok, MYSQL_RES *res);
+    void _reset(Conn &conn);
+    void _retry(Conn &conn);
+    bool _isAlive() const;
+    void _failQueue();
+    void _expireQueue();
+    static bool _bind(MYSQL *mysql, const Query &query, std::string *sql);
+    void _onTimeout(Conn *conn, uint32_t seq);
+
+    static uint32_t _toEpoll(int status);
+    static int _fromEpoll(uint32_t events, int waiting);
+
+private:
+    Epoller *_epoller;
+    HeapTimer *_timer;
+    std::string _host;
+    std::string _user;
+    std::string _pwd;
+    std::string _dbName;
+    int _port;
+    int _queueTimeoutMS;
+    std::vector<std::unique_ptr<Conn>> _conns;  // 定时器回调持有 Conn 指针, 地址不能变
+    std::deque<Query> _queue;
+    size_t _inflight;
+
+    static constexpr int RETRY_MIN_MS = 100;
+    static constexpr int RETRY_MAX_MS = 5000;
+    static constexpr unsigned int CONNECT_TIMEOUT_S = 3;
+    static constexpr unsigned int IO_TIMEOUT_S = 10;      // 读写超时, 客户端库按次数重试, 实际等待可能是其数倍
+};
+
+}
+
+#endif // __ASYNCSQL_H__
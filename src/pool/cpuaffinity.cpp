@@ -0,0 +1,74 @@
+/**
+ * @file cpuaffinity.cpp
+ * @brief  线程绑核与 NUMA 节点查询
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "cpuaffinity.h"
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+
+namespace wsv
+{
+
+// 绑定当前线程
+bool CpuAffinity::pin(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// 从 sysfs 的 cpuN/nodeM 链接得到节点号, 非 NUMA 内核返回 -1
+int CpuAffinity::numaNode(int cpu) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+        return -1;
+    int node = -1;
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (strncmp(ent->d_name, "node", 4) == 0 && ent->d_name[4] >= '0' && ent->d_name[4] <= '9') {
+            node = atoi(ent->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+bool CpuAffinity::parse(const char *list, std::vector<int> &cpus) {
+    cpus.clear();
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return false;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first)
+                return false;
+            p = end;
+        }
+        if (last >= CPU_SETSIZE)
+            return false;
+        for (long cpu = first; cpu <= last; cpu++)
+            cpus.push_back(static_cast<int>(cpu));
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return false;
+    }
+    return !cpus.empty();
+}
+
+}
@@ -0,0 +1,32 @@
+/**
+ * @file cpuaffinity.h
+ * @brief  线程绑核与 NUMA 节点查询
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __CPUAFFINITY_H__
+#define __CPUAFFINITY_H__
+
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace wsv
+{
+
+/*
+ * 线程启动后先 pin() 再分配/首次访问自己的缓冲区: 默认的 local 内存策略按首次访问
+ * 所在 CPU 的节点分配物理页, 因此连接表, 读写缓冲区都会落在该核所属的 NUMA 节点.
+ */
+class CpuAffinity
+{
+public:
+    static bool pin(int cpu);
+    static int numaNode(int cpu);
+    static bool parse(const char *list, std::vector<int> &cpus);   // 形如 "0-3,8,10"
+};
+
+}
+
+#endif // __CPUAFFINITY_H__
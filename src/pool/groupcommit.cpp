@@ -0,0 +1,144 @@
+/**
+ * @file groupcommit.cpp
+ * @brief  合并各线程的数据库写操作, 一批在一个事务中提交
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "groupcommit.h"
+
+#include <algorithm>
+
+#include "sqlconnRAII.h"
+
+namespace wsv
+{
+
+GroupCommit* GroupCommit::Instance() {
+    static GroupCommit groupCommit;
+    return &groupCommit;
+}
+
+GroupCommit::GroupCommit() : _maxRows(0), _maxWait(0), _isClosed(true), _batches(0), _rows(0) { }
+
+GroupCommit::~GroupCommit() { close(); }
+
+void GroupCommit::init(int maxRows, int maxWaitUs) {
+    if (maxRows <= 0 || _thread)
+        return;
+    _maxRows = maxRows;
+    _maxWait = std::chrono::microseconds(std::max(maxWaitUs, 0));
+    _isClosed = false;
+    _thread = std::make_unique<std::thread>(&GroupCommit::_flusher, this);
+}
+
+bool GroupCommit::isEnabled() const { return _thread != nullptr; }
+
+GroupCommit::RESULT GroupCommit::submit(Op op) {
+    if (!isEnabled())
+        return _execute(op);
+    Pending pending;
+    pending.op = std::move(op);
+    pending.enqueued = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> locker(_mtx);
+    if (_isClosed) {
+        locker.unlock();
+        return _execute(pending.op);
+    }
+    _queue.push_back(&pending);
+    // 不等待时每个操作都唤醒后台线程; 否则攒够一批或第一个到达时唤醒, 其余由等待超时处理
+    if (_maxWait.count() == 0 || _queue.size() == 1 || _queue.size() >= _maxRows)
+        _cond.notify_one();
+    _doneCond.wait(locker, [&pending] { return pending.done; });
+    return pending.result;
+}
+
+void GroupCommit::close() {
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        if (_isClosed)
+            return;
+        _isClosed = true;
+    }
+    _cond.notify_one();
+    if (_thread && _thread->joinable())
+        _thread->join();
+    _thread.reset();
+}
+
+uint64_t GroupCommit::batches() const { return _batches.load(std::memory_order_relaxed); }
+
+uint64_t GroupCommit::rows() const { return _rows.load(std::memory_order_relaxed); }
+
+void GroupCommit::_flusher() {
+    std::vector<Pending*> batch;
+    std::unique_lock<std::mutex> locker(_mtx);
+    while (true) {
+        _cond.wait(locker, [this] { return _isClosed || !_queue.empty(); });
+        if (_queue.empty())
+            break;
+        // 等到攒够一批, 或第一个操作等满 maxWaitUs; 关闭时不再等待
+        auto deadline = _queue.front()->enqueued + _maxWait;
+        _cond.wait_until(locker, deadline, [this] { return _isClosed || _queue.size() >= _maxRows; });
+        while (!_queue.empty() && batch.size() < _maxRows) {
+            batch.push_back(_queue.front());
+            _queue.pop_front();
+        }
+        locker.unlock();
+        _flush(batch);
+        locker.lock();
+        for (Pending *pending : batch)
+            pending->done = true;
+        batch.clear();
+        _doneCond.notify_all();
+    }
+}
+
+void GroupCommit::_flush(std::vector<Pending*> &batch) {
+    _batches.fetch_add(1, std::memory_order_relaxed);
+    _rows.fetch_add(batch.size(), std::memory_order_relaxed);
+    if (batch.size() == 1) {
+        batch[0]->result = _execute(batch[0]->op);
+        return;
+    }
+    MYSQL *sql;
+    SqlConnRAII scr(&sql, SqlConnPool::Instance());
+    if (!sql || mysql_query(sql, "START TRANSACTION")) {
+        LOG_ERROR("GroupCommit: start transaction failed");
+        return;
+    }
+    // 唯一键冲突时服务端只回滚该语句, 事务继续; 其他错误 (如死锁) 可能已回滚整个事务,
+    // 之前执行成功的行也不存在了, 回滚后逐个以自动提交重新执行, 各自得到真实的结果
+    bool executed = false;
+    for (Pending *pending : batch) {
+        pending->result = pending->op(sql);
+        if (pending->result == FAILED) {
+            mysql_rollback(sql);
+            for (Pending *retry : batch)
+                retry->result = retry->op(sql);
+            return;
+        }
+        executed = executed || pending->result == DONE;
+    }
+    if (!executed) {
+        mysql_rollback(sql);
+        return;
+    }
+    if (mysql_commit(sql)) {
+        LOG_ERROR("GroupCommit: commit failed: %s", mysql_error(sql));
+        mysql_rollback(sql);
+        for (Pending *pending : batch)
+            if (pending->result == DONE)
+                pending->result = FAILED;
+    }
+}
+
+// 未启用或一批只有一个操作时不开事务, 以自动提交执行
+GroupCommit::RESULT GroupCommit::_execute(const Op &op) {
+    MYSQL *sql;
+    SqlConnRAII scr(&sql, SqlConnPool::Instance());
+    if (!sql)
+        return FAILED;
+    return op(sql);
+}
+
+}
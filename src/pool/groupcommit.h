@@ -0,0 +1,88 @@
+/**
+ * @file groupcommit.h
+ * @brief  合并各线程的数据库写操作, 一批在一个事务中提交
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __GROUPCOMMIT_H__
+#define __GROUPCOMMIT_H__
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <mysql/mysqld_error.h>  // ER_DUP_ENTRY
+
+#include "sqlconnpool.h"
+
+namespace wsv
+{
+
+/*
+ * 每个自动提交的 INSERT 在服务端各有一次日志刷盘. 启用后调用 submit() 的线程把写操作排队并等待,
+ * 后台线程攒到 maxRows 个或第一个等了 maxWaitUs 后取一个连接, 在一个事务中逐个执行, 一次 COMMIT;
+ * 执行期间到达的操作排到下一批. 唯一键冲突只影响该操作; 其他失败时回滚整批, 逐个以自动提交重新执行;
+ * COMMIT 失败时整批失败. maxWaitUs 为 0 时不等待, 只合并上一批执行期间积压的操作.
+ */
+class GroupCommit
+{
+public:
+    enum RESULT {
+        DONE = 0,
+        DUPLICATE,      // 唯一键冲突
+        FAILED,
+    };
+    // 在后台线程中用 sql 执行一个写操作, 不提交
+    typedef std::function<RESULT(MYSQL *sql)> Op;
+
+    static GroupCommit* Instance();
+
+    // maxRows <= 0 时不启用, submit() 由调用线程取连接直接执行
+    void init(int maxRows, int maxWaitUs);
+    bool isEnabled() const;
+    // 等待 op 所在的批次提交后返回其结果
+    RESULT submit(Op op);
+    // 执行完已排队的操作后停止后台线程, 在关闭数据库连接池之前调用
+    void close();
+
+    uint64_t batches() const;
+    uint64_t rows() const;
+
+private:
+    GroupCommit();
+    ~GroupCommit();
+
+    struct Pending
+    {
+        Op op;
+        RESULT result = FAILED;
+        bool done = false;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    void _flusher();
+    void _flush(std::vector<Pending*> &batch);
+    static RESULT _execute(const Op &op);
+
+private:
+    size_t _maxRows;
+    std::chrono::microseconds _maxWait;
+    std::deque<Pending*> _queue;
+    std::mutex _mtx;
+    std::condition_variable _cond;      // 通知后台线程有新操作
+    std::condition_variable _doneCond;  // 通知等待者批次已提交
+    bool _isClosed;
+    std::unique_ptr<std::thread> _thread;
+    std::atomic<uint64_t> _batches;
+    std::atomic<uint64_t> _rows;
+};
+
+}
+
+#endif // __GROUPCOMMIT_H__
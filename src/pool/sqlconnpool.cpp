@@ -6,6 +6,9 @@
  */
 #include "sqlconnpool.h"
 
+#include <cstring>
+#include <algorithm>
+
 namespace wsv
 {
 
@@ -14,66 +17,366 @@ SqlConnPool* SqlConnPool::Instance() {
     return &connPool;
 }
 
-SqlConnPool::SqlConnPool() : _maxConn(0)/*, _useCount(0), _freeCount(0)*/ { }
+SqlConnPool::SqlConnPool() : _port(0), _maxConn(0), _openCount(0), _retryAt(0), _clock(0), _wait(), _timeouts(0), _reconnects(0), _waiting(0), _isClosed(true), _wakeup(false) { }
 
 SqlConnPool::~SqlConnPool() { closePool(); }
 
-int SqlConnPool::init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize) {
+int SqlConnPool::init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize,
+                      const SqlPoolOptions &options) {
     if (connSize <= 0) {
         LOG_ERROR("connSize <= 0");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < connSize; i++) {
-        MYSQL *sql = nullptr;
-        if (!(sql = mysql_init(sql))) {
-            LOG_ERROR("MySql init error!");
-            exit(EXIT_FAILURE);
-        }
-        if (!(sql = mysql_real_connect(sql, host, user, pwd, dbName, port, nullptr, 0))) {
+    _host = host;
+    _port = port;
+    _user = user;
+    _pwd = pwd;
+    _dbName = dbName;
+    _maxConn = connSize;
+    _options = options;
+    _options.minConn = options.minConn > 0 ? std::min(options.minConn, connSize) : connSize;
+    _conns = std::make_unique<Conn[]>(connSize);
+    _clock = _nowMS();
+    sem_init(&_semId, 0, 0);
+    int opened = 0;
+    for (; opened < _options.minConn; opened++) {
+        _conns[opened].state = SLOT_OPENING;
+        if (!_open(_conns[opened], SLOT_IDLE)) {
             LOG_ERROR("MySql Connect error!");
-            --connSize;
             break;
         }
-        _connQueue.push(sql);
     }
-    _maxConn = connSize;
-    sem_init(&_semId, 0, _maxConn);
-    return _maxConn;
+    // 连接失败不再缩小连接池, 由后台线程继续重试
+    if (opened < _options.minConn)
+        LOG_WARN("SqlConnPool: %d of %d connections open, retry in background", opened, _options.minConn);
+    _isClosed = false;
+    _maintainer = std::make_unique<std::thread>(&SqlConnPool::_maintain, this);
+    return opened;
 }
 
+/*
+ * 拿到信号量即保证有空闲连接, 再从本线程上次用过的连接开始找; 没有其他线程竞争时
+ * 只有一次原子减与一次原子交换, 不加锁, 不进入内核, 也不读时钟.
+ * 没有空闲连接时通知后台线程新建 (未到上限时), 自己等待信号量, 从开始等待算起超过 checkoutTimeoutMS 返回 nullptr.
+ * 不在本线程建立连接: 连接超时以秒计, 数据库无响应时会远超等待上限
+ */
 MYSQL* SqlConnPool::getConn() {
-    MYSQL *sql = nullptr;
-    if (_connQueue.empty()) {
-        LOG_WARN("SqlConnPool busy!");
+    if (_maxConn <= 0) {
+        LOG_WARN("SqlConnPool has no connection!");
         return nullptr;
     }
-    sem_wait(&_semId);
-    { // lock
-        std::lock_guard<std::mutex> locker(_mtx);
-        sql = _connQueue.front();
-        _connQueue.pop();
+    if (sem_trywait(&_semId) == 0)
+        return _claimIdle(true);
+    auto start = std::chrono::steady_clock::now();
+    _waiting.fetch_add(1, std::memory_order_relaxed);
+    if (_openCount.load(std::memory_order_relaxed) < _maxConn && _nowMS() >= _retryAt.load(std::memory_order_relaxed))
+        _wakeMaintainer();
+    int ret;
+    if (_options.checkoutTimeoutMS <= 0) {
+        while ((ret = sem_wait(&_semId)) != 0 && errno == EINTR) { }
+    } else {
+        ret = _waitUntil(start + std::chrono::milliseconds(_options.checkoutTimeoutMS));
+    }
+    _waiting.fetch_sub(1, std::memory_order_relaxed);
+    if (ret != 0) {
+        _timeouts.fetch_add(1, std::memory_order_relaxed);
+        LOG_WARN("SqlConnPool checkout timeout!");
+        return nullptr;
     }
+    MYSQL *sql = _claimIdle(false);
+    _record(start);
     return sql;
 }
 
+// 等待上限按单调时钟计算, 墙上时间被调整时不会提前或推迟超时
+int SqlConnPool::_waitUntil(std::chrono::steady_clock::time_point deadline) {
+    int ret;
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 30)
+    auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long nsec = ts.tv_nsec + std::max<long long>(left.count(), 0);
+    ts.tv_sec += nsec / 1000000000LL;
+    ts.tv_nsec = nsec % 1000000000LL;
+    while ((ret = sem_clockwait(&_semId, CLOCK_MONOTONIC, &ts)) != 0 && errno == EINTR) { }
+#else
+    // 没有 sem_clockwait: 每次按墙上时间至多等 WAIT_SLICE_MS, 是否超时以 steady_clock 为准
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            ret = sem_trywait(&_semId);
+            break;
+        }
+        auto slice = std::min<std::chrono::steady_clock::duration>(deadline - now, std::chrono::milliseconds(WAIT_SLICE_MS));
+        long long nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(slice).count();
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        nsec += ts.tv_nsec;
+        ts.tv_sec += nsec / 1000000000LL;
+        ts.tv_nsec = nsec % 1000000000LL;
+        if ((ret = sem_timedwait(&_semId, &ts)) == 0 || (errno != ETIMEDOUT && errno != EINTR))
+            break;
+    }
+#endif
+    return ret;
+}
+
 void SqlConnPool::freeConn(MYSQL *conn) {
     if (!conn) {
         LOG_ERROR("SqlConn is nullptr");
         exit(EXIT_FAILURE);
     }
-    std::lock_guard<std::mutex> locker(_mtx);
-    _connQueue.push(conn); // 丢弃
-    sem_post(&_semId);
+    Conn *item = _find(conn);
+    if (!item) {
+        LOG_ERROR("SqlConn is not in pool");
+        return;
+    }
+    // 最近一次调用发现连接已断开: 直接关闭, 由后台线程重建
+    unsigned int err = mysql_errno(conn);
+    if (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST) {
+        LOG_WARN("SqlConnPool: connection lost, reconnect in background");
+        _close(*item);
+        _wakeMaintainer();
+        return;
+    }
+    _release(*item);
 }
 
 void SqlConnPool::closePool() {
-    std::lock_guard<std::mutex> locker(_mtx);
-    while (!_connQueue.empty()) {
-        auto item = _connQueue.front();
-        _connQueue.pop();
-        mysql_close(item);
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _isClosed = true;
+    }
+    _cond.notify_all();
+    if (_maintainer) {
+        _maintainer->join();
+        _maintainer.reset();
+    }
+    if (!_conns)
+        return;
+    for (int i = 0; i < _maxConn; i++) {
+        for (MYSQL_STMT *stmt : _conns[i].stmt) {
+            if (stmt) mysql_stmt_close(stmt);
+        }
+        if (MYSQL *sql = _conns[i].sql.load())
+            mysql_close(sql);
     }
+    _conns.reset();
+    _maxConn = 0;
+    _openCount = 0;
     mysql_library_end();
 }
 
+SqlConnPool::Stats SqlConnPool::stats() const {
+    Stats stats;
+    stats.open = _openCount.load(std::memory_order_relaxed);
+    stats.idle = 0;
+    if (_conns)
+        sem_getvalue(const_cast<sem_t*>(&_semId), &stats.idle);
+    for (int i = 0; i < WAIT_BUCKETS; i++)
+        stats.wait[i] = _wait[i].load(std::memory_order_relaxed);
+    for (int i = 0; _conns && i < _maxConn; i++)
+        stats.wait[0] += _conns[i].immediate.load(std::memory_order_relaxed);
+    stats.timeouts = _timeouts.load(std::memory_order_relaxed);
+    stats.reconnects = _reconnects.load(std::memory_order_relaxed);
+    return stats;
+}
+
+MYSQL_STMT* SqlConnPool::getStmt(MYSQL *conn, size_t id, const char *query) {
+    Conn *item = _find(conn);
+    if (!item || id >= MAX_STMT)
+        return nullptr;
+    if (item->stmt[id])
+        return item->stmt[id];
+    MYSQL_STMT *stmt = mysql_stmt_init(conn);
+    if (!stmt) {
+        LOG_ERROR("MySql stmt init error!");
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(stmt, query, strlen(query))) {
+        LOG_ERROR("MySql prepare error: %s", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    item->stmt[id] = stmt;
+    return stmt;
+}
+
+void SqlConnPool::dropStmt(MYSQL *conn, size_t id) {
+    Conn *item = _find(conn);
+    if (!item || id >= MAX_STMT || !item->stmt[id])
+        return;
+    mysql_stmt_close(item->stmt[id]);
+    item->stmt[id] = nullptr;
+}
+
+// 连接数不多, 线性查找; _conns 在 init() 后不变, 无需加锁
+SqlConnPool::Conn* SqlConnPool::_find(MYSQL *conn) {
+    for (int i = 0; i < _maxConn; i++) {
+        if (_conns[i].sql.load(std::memory_order_relaxed) == conn)
+            return &_conns[i];
+    }
+    return nullptr;
+}
+
+bool SqlConnPool::_claim(size_t i, int from, int to) {
+    std::atomic<int> &state = _conns[i].state;
+    return state.load(std::memory_order_relaxed) == from && state.compare_exchange_strong(from, to, std::memory_order_acquire);
+}
+
+// 已拿到信号量, 一定有空闲连接, 最多被其他线程抢先几次
+MYSQL* SqlConnPool::_claimIdle(bool immediate) {
+    static thread_local size_t affine = 0;
+    for (size_t n = 0; ; n++) {
+        size_t i = (affine + n) % _maxConn;
+        if (_claim(i, SLOT_IDLE, SLOT_BUSY)) {
+            affine = i;
+            // 不等待的次数记在连接自己的缓存行上, 各线程不争用同一个计数
+            if (immediate)
+                _conns[i].immediate.fetch_add(1, std::memory_order_relaxed);
+            return _conns[i].sql.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+MYSQL* SqlConnPool::_connect() {
+    MYSQL *sql = mysql_init(nullptr);
+    if (!sql) {
+        LOG_ERROR("MySql init error!");
+        return nullptr;
+    }
+    unsigned int timeout = CONNECT_TIMEOUT_SEC;
+    mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    if (!mysql_real_connect(sql, _host.c_str(), _user.c_str(), _pwd.c_str(), _dbName.c_str(), _port, nullptr, 0)) {
+        LOG_WARN("MySql Connect error: %s", mysql_error(sql));
+        mysql_close(sql);
+        return nullptr;
+    }
+    return sql;
+}
+
+// 槽位已由调用者置为 SLOT_OPENING; 成功后置为 to, 置为空闲时归还信号量
+bool SqlConnPool::_open(Conn &conn, SLOT_STATE to) {
+    MYSQL *sql = _connect();
+    if (!sql) {
+        _retryAt.store(_nowMS() + RETRY_MS, std::memory_order_relaxed);
+        conn.state.store(SLOT_EMPTY, std::memory_order_release);
+        return false;
+    }
+    conn.sql.store(sql, std::memory_order_relaxed);
+    conn.lastUsed.store(_nowMS(), std::memory_order_relaxed);
+    _openCount.fetch_add(1, std::memory_order_relaxed);
+    conn.state.store(to, std::memory_order_release);
+    if (to == SLOT_IDLE)
+        sem_post(&_semId);
+    return true;
+}
+
+// 由占用该连接的线程调用, 槽位变为空, 不归还信号量
+void SqlConnPool::_close(Conn &conn) {
+    for (MYSQL_STMT *&stmt : conn.stmt) {
+        if (stmt) mysql_stmt_close(stmt);
+        stmt = nullptr;
+    }
+    mysql_close(conn.sql.load(std::memory_order_relaxed));
+    conn.sql.store(nullptr, std::memory_order_relaxed);
+    _openCount.fetch_sub(1, std::memory_order_relaxed);
+    conn.state.store(SLOT_EMPTY, std::memory_order_release);
+}
+
+// 先释放连接再归还信号量, 拿到信号量的线程一定能找到空闲连接
+void SqlConnPool::_release(Conn &conn) {
+    conn.lastUsed.store(_clock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    conn.state.store(SLOT_IDLE, std::memory_order_release);
+    sem_post(&_semId);
+}
+
+void SqlConnPool::_record(std::chrono::steady_clock::time_point start) {
+    static const int64_t BOUND_US[WAIT_BUCKETS - 1] = { 100, 1000, 10000, 100000, 1000000 };
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    int i = 0;
+    while (i < WAIT_BUCKETS - 1 && us >= BOUND_US[i])
+        i++;
+    _wait[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+void SqlConnPool::_wakeMaintainer() {
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _wakeup = true;
+    }
+    _cond.notify_one();
+}
+
+// 后台线程: 新建等待中的线程需要的连接, 检查空闲连接, 补足最小连接数
+void SqlConnPool::_maintain() {
+    std::unique_lock<std::mutex> locker(_mtx);
+    while (!_isClosed) {
+        _cond.wait_for(locker, std::chrono::milliseconds(MAINTAIN_MS), [this] { return _isClosed || _wakeup; });
+        if (_isClosed)
+            break;
+        _wakeup = false;
+        locker.unlock();
+        // 先新建, 等待者不被 ping 耽误
+        _grow();
+        int64_t now = _nowMS();
+        _clock.store(now, std::memory_order_relaxed);
+        for (int i = 0; i < _maxConn; i++)
+            _check(_conns[i], now);
+        _grow();
+        locker.lock();
+    }
+}
+
+// 在空槽位上建立空闲连接, 直到不少于最小连接数且空闲连接不少于等待者; 失败时等下一轮再试
+void SqlConnPool::_grow() {
+    for (int i = 0; i < _maxConn; i++) {
+        int open = _openCount.load(std::memory_order_relaxed), idle = 0;
+        sem_getvalue(&_semId, &idle);
+        if (open >= _options.minConn && _waiting.load(std::memory_order_relaxed) <= idle)
+            break;
+        if (!_claim(i, SLOT_EMPTY, SLOT_OPENING))
+            continue;
+        if (!_open(_conns[i], SLOT_IDLE))
+            break;
+        if (open < _options.minConn)
+            _reconnects.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * 与取连接的线程一样先拿信号量再占用, 保证信号量计数与空闲连接数一致.
+ * 超过最小连接数且空闲太久的关闭; 空闲超过 pingIntervalMS 的 ping, 不通的关闭后由补足逻辑重建
+ */
+void SqlConnPool::_check(Conn &conn, int64_t now) {
+    if (conn.state.load(std::memory_order_relaxed) != SLOT_IDLE)
+        return;
+    int64_t idle = now - conn.lastUsed.load(std::memory_order_relaxed);
+    bool shrink = _openCount.load(std::memory_order_relaxed) > _options.minConn && idle >= _options.idleTimeoutMS;
+    bool ping = _options.pingIntervalMS > 0 && idle >= _options.pingIntervalMS;
+    if (!shrink && !ping)
+        return;
+    if (sem_trywait(&_semId) != 0)
+        return;
+    int expected = SLOT_IDLE;
+    if (!conn.state.compare_exchange_strong(expected, SLOT_BUSY, std::memory_order_acquire)) {
+        sem_post(&_semId);
+        return;
+    }
+    if (shrink) {
+        _close(conn);
+        return;
+    }
+    if (mysql_ping(conn.sql.load(std::memory_order_relaxed)) != 0) {
+        LOG_WARN("SqlConnPool: ping error: %s, reconnect", mysql_error(conn.sql.load(std::memory_order_relaxed)));
+        _close(conn);
+        return;
+    }
+    _release(conn);
+}
+
+int64_t SqlConnPool::_nowMS() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 }
@@ -7,39 +7,135 @@
 #ifndef __SQLCONNPOOL_H__
 #define __SQLCONNPOOL_H__
 
-#include <queue>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <condition_variable>
 
+#include <time.h>           // clock_gettime
 #include <semaphore.h>
 
 #include <mysql/mysql.h>
+#include <mysql/errmsg.h>   // CR_SERVER_GONE_ERROR
 
 #include "../log/log.h"
 
 namespace wsv
 {
 
+struct SqlPoolOptions
+{
+    int minConn = 0;                // 最小连接数, 0 时与最大连接数相同
+    int checkoutTimeoutMS = 1000;   // 取连接的等待上限, 超时返回 nullptr; 0 一直等待
+    int pingIntervalMS = 30000;     // 空闲超过该时间的连接 ping 一次, 0 不检查
+    int idleTimeoutMS = 60000;      // 超过最小连接数的连接空闲该时间后关闭
+};
+
+/*
+ * 连接槽位数 (最大连接数) 在 init() 后固定, 信号量计数空闲连接. 取连接时先试本线程上次用过的连接,
+ * 以原子状态占用, 常见情况下不加锁; 同一线程反复使用同一连接, 其预处理语句缓存也保持有效.
+ * 没有空闲连接且未到上限时通知后台线程新建, 取连接的线程只等信号量, 建立连接再慢也不超过等待上限;
+ * 后台线程还 ping 空闲连接, 重连断开的连接, 关闭超过最小连接数且长时间空闲的连接.
+ * 取连接有等待上限, 数据库变慢时快速失败而不是一直占住线程.
+ */
 class SqlConnPool
 {
 public:
+    static const size_t MAX_STMT = 8;   // 每个连接缓存的预处理语句数, 语句编号由调用方分配
+    static const int WAIT_BUCKETS = 6;  // 取连接等待时间直方图: <0.1ms <1ms <10ms <100ms <1s >=1s
+
+    struct Stats
+    {
+        int open;                       // 已建立的连接数
+        int idle;
+        uint64_t wait[WAIT_BUCKETS];    // 成功取到连接的次数, 按等待时间分桶
+        uint64_t timeouts;              // 等待超时的次数
+        uint64_t reconnects;            // 断开后重建的连接数
+    };
+
     static SqlConnPool* Instance();
 
-    int init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize);
+    // connSize 为最大连接数, 启动时只建立最小连接数个
+    int init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize,
+             const SqlPoolOptions &options = SqlPoolOptions());
 
     MYSQL* getConn();
     void freeConn(MYSQL *conn);
     void closePool();
+    Stats stats() const;
+
+    // 取 conn 上编号为 id 的预处理语句, 第一次使用时以 query 预处理; 只能由持有 conn 的线程调用
+    MYSQL_STMT* getStmt(MYSQL *conn, size_t id, const char *query);
+    // 语句执行出错 (如连接断开) 后丢弃, 下次使用时重新预处理
+    void dropStmt(MYSQL *conn, size_t id);
 
 private:
     SqlConnPool();
     ~SqlConnPool();
 
+    enum SLOT_STATE {
+        SLOT_EMPTY = 0,     // 没有连接
+        SLOT_OPENING,       // 正在建立, 由建立者独占
+        SLOT_IDLE,
+        SLOT_BUSY,
+    };
+    /* 按缓存行对齐, 各线程占用不同连接时不互相干扰 */
+    struct alignas(64) Conn
+    {
+        std::atomic<MYSQL*> sql{nullptr};
+        std::atomic<int> state{SLOT_EMPTY};
+        std::atomic<int64_t> lastUsed{0};   // 最近一次归还的时间 (ms, 取自 _clock)
+        std::atomic<uint64_t> immediate{0}; // 不用等待就取到该连接的次数
+        MYSQL_STMT *stmt[MAX_STMT] = {};
+    };
+
+    Conn* _find(MYSQL *conn);
+    bool _claim(size_t i, int from, int to);
+    MYSQL* _claimIdle(bool immediate);
+    MYSQL* _connect();
+    bool _open(Conn &conn, SLOT_STATE to);
+    void _close(Conn &conn);
+    void _release(Conn &conn);
+    void _record(std::chrono::steady_clock::time_point start);
+    void _wakeMaintainer();
+    void _maintain();
+    void _grow();
+    int _waitUntil(std::chrono::steady_clock::time_point deadline);
+    void _check(Conn &conn, int64_t now);
+
+    static int64_t _nowMS();
+
 private:
+    std::string _host;
+    std::string _user;
+    std::string _pwd;
+    std::string _dbName;
+    int _port;
     int _maxConn;
-    /* int _useCount; */
-    /* int _freeCount; */
+    SqlPoolOptions _options;
     sem_t _semId;
+    std::unique_ptr<Conn[]> _conns;     // init() 后不再变化, 无锁读取
+    std::atomic<int> _openCount;
+    std::atomic<int64_t> _retryAt;      // 建立连接失败后, 到该时间之前取连接的线程不再尝试新建
+    std::atomic<int64_t> _clock;        // 后台线程每次检查时更新的粗略时间 (ms), 归还连接时不读时钟
+    std::atomic<uint64_t> _wait[WAIT_BUCKETS];
+    std::atomic<uint64_t> _timeouts;
+    std::atomic<uint64_t> _reconnects;
+    std::atomic<int> _waiting;          // 没有空闲连接而在等待的线程数, 多于空闲连接时后台线程新建
+
     std::mutex _mtx;
-    std::queue<MYSQL*> _connQueue;
+    std::condition_variable _cond;
+    bool _isClosed;
+    bool _wakeup;                       // 有线程等待新建或连接断开, 后台线程立即处理
+    std::unique_ptr<std::thread> _maintainer;
+
+    static constexpr int MAINTAIN_MS = 1000;      // 后台检查的间隔
+    static constexpr int CONNECT_TIMEOUT_SEC = 3;
+    static constexpr int RETRY_MS = 1000;
+    static constexpr int WAIT_SLICE_MS = 10;     // 没有 sem_clockwait 时每次等待的上限
 };
 
 }
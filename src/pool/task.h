@@ -0,0 +1,90 @@
+/**
+ * @file task.h
+ * @brief  定长小缓冲区的任务类型, 代替 std::function, 构造与移动都不分配内存
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __TASK_H__
+#define __TASK_H__
+
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include <cstddef>
+
+namespace wsv
+{
+
+/*
+ * 可调用对象直接放在对象内的 CAPACITY 字节中, 整个 Task 正好一个缓存行.
+ * 放不下或移动可能抛异常的可调用对象在编译期报错, 而不是退回堆分配:
+ * 连接事件的 lambda / std::bind 只捕获几个指针和整数, 远小于上限.
+ */
+class Task
+{
+public:
+    static const size_t CAPACITY = 48;
+
+    Task() noexcept : _invoke(nullptr), _manage(nullptr) { }
+
+    template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&func) {
+        typedef typename std::decay<F>::type Func;
+        static_assert(sizeof(Func) <= CAPACITY, "callable too large for Task, capture less");
+        static_assert(alignof(Func) <= alignof(std::max_align_t), "callable over-aligned for Task");
+        static_assert(std::is_nothrow_move_constructible<Func>::value, "callable must be nothrow movable");
+        new (_storage) Func(std::forward<F>(func));
+        _invoke = [](void *p) { (*static_cast<Func*>(p))(); };
+        _manage = [](void *dst, void *src) {
+            if (dst)
+                new (dst) Func(std::move(*static_cast<Func*>(src)));
+            static_cast<Func*>(src)->~Func();
+        };
+    }
+
+    Task(Task &&other) noexcept : _invoke(other._invoke), _manage(other._manage) {
+        if (_manage)
+            _manage(_storage, other._storage);
+        other._invoke = nullptr;
+        other._manage = nullptr;
+    }
+
+    Task& operator=(Task &&other) noexcept {
+        if (this != &other) {
+            reset();
+            _invoke = other._invoke;
+            _manage = other._manage;
+            if (_manage)
+                _manage(_storage, other._storage);
+            other._invoke = nullptr;
+            other._manage = nullptr;
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void reset() {
+        if (_manage)
+            _manage(nullptr, _storage);     // 只析构
+        _invoke = nullptr;
+        _manage = nullptr;
+    }
+
+    explicit operator bool() const { return _invoke != nullptr; }
+
+    void operator()() { _invoke(_storage); }
+
+private:
+    alignas(std::max_align_t) unsigned char _storage[CAPACITY];
+    void (*_invoke)(void*);
+    void (*_manage)(void *dst, void *src);  // dst 非空时移动到 dst, 之后析构 src
+};
+
+}
+
+#endif // __TASK_H__
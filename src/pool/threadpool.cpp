@@ -0,0 +1,210 @@
+/**
+ * @file threadpool.cpp
+ * @brief  线程池
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "threadpool.h"
+
+namespace wsv
+{
+
+// 当前线程所属的线程池与下标, 用于把工作线程提交的任务放进本线程队列
+static thread_local const ThreadPool *currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static size_t roundUpPow2(size_t n) {
+    size_t cap = 1;
+    while (cap < n)
+        cap <<= 1;
+    return cap;
+}
+
+ThreadPool::TaskRing::TaskRing(size_t capacity)
+    : _slots(new Slot[roundUpPow2(capacity)]), _mask(roundUpPow2(capacity) - 1), _head(0), _tail(0) {
+    for (size_t i = 0; i <= _mask; i++)
+        _slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool ThreadPool::TaskRing::push(Task &task) {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = _slots[pos & _mask];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.task = std::move(task);
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;   // 满: 槽位还没被上一圈的消费者取走
+        } else {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ThreadPool::TaskRing::pop(Task &task) {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = _slots[pos & _mask];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                task = std::move(slot.task);
+                slot.seq.store(pos + _mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;   // 空
+        } else {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t ThreadPool::TaskRing::size() const {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount, const std::vector<int> &cpus, size_t maxQueue)
+    : _inject(INJECT_CAPACITY), _maxQueue(maxQueue), _isClosed(false), _overflowSize(0), _sleepers(0), _epoch(0) {
+    assert(threadCount > 0);
+    for (size_t i = 0; i < threadCount; i++)
+        _workers.emplace_back(new Worker());
+    // 所有 Worker 构造完再启动线程, 窃取时遍历 _workers 不会遇到未构造的元素
+    for (size_t i = 0; i < threadCount; i++) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        _workers[i]->thread = std::thread(&ThreadPool::_run, this, i, cpu);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    _isClosed.store(true);
+    _wake(true);
+    for (auto &worker : _workers)
+        worker->thread.join();
+}
+
+size_t ThreadPool::queueSize() const {
+    size_t size = _inject.size() + _overflowSize.load(std::memory_order_relaxed);
+    for (auto &worker : _workers)
+        size += worker->local.size();
+    return size;
+}
+
+size_t ThreadPool::threadCount() const { return _workers.size(); }
+
+bool ThreadPool::_submit(Task &&task, bool bounded) {
+    if (bounded && _maxQueue > 0 && queueSize() >= _maxQueue)
+        return false;
+    bool pushed = currentPool == this ? _workers[currentIndex]->local.push(task) : false;
+    if (!pushed && !_inject.push(task)) {
+        std::lock_guard<std::mutex> locker(_overflowMtx);
+        _overflow.push_back(std::move(task));
+        _overflowSize.fetch_add(1, std::memory_order_relaxed);
+    }
+    // 与 _park() 中的 "登记挂起 -> 再检查队列" 配对: 双方至少有一方看到对方
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load(std::memory_order_relaxed) > 0)
+        _wake(false);
+    return true;
+}
+
+void ThreadPool::_run(size_t index, int cpu) {
+    if (cpu >= 0)
+        CpuAffinity::pin(cpu);
+    currentPool = this;
+    currentIndex = index;
+    int idle = 0;
+    for (;;) {
+        if (_runOne(index)) {
+            idle = 0;
+            continue;
+        }
+        if (_isClosed.load(std::memory_order_acquire) && !_hasWork())
+            break;
+        if (idle < SPIN_ROUNDS) {
+            cpuRelax();
+        } else if (idle < SPIN_ROUNDS + YIELD_ROUNDS) {
+            std::this_thread::yield();
+        } else {
+            _park();
+            idle = 0;
+            continue;
+        }
+        ++idle;
+    }
+}
+
+bool ThreadPool::_runOne(size_t index) {
+    Task task;
+    bool found = _workers[index]->local.pop(task) || _inject.pop(task) || _popOverflow(task);
+    // 从下一个线程开始窃取, 各线程的起点错开
+    for (size_t k = 1; !found && k < _workers.size(); k++)
+        found = _workers[(index + k) % _workers.size()]->local.pop(task);
+    if (!found)
+        return false;
+    task();
+    return true;
+}
+
+bool ThreadPool::_popOverflow(Task &task) {
+    if (_overflowSize.load(std::memory_order_relaxed) == 0)
+        return false;
+    std::lock_guard<std::mutex> locker(_overflowMtx);
+    if (_overflow.empty())
+        return false;
+    task = std::move(_overflow.front());
+    _overflow.pop_front();
+    _overflowSize.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::_hasWork() const {
+    if (_inject.size() > 0 || _overflowSize.load(std::memory_order_relaxed) > 0)
+        return true;
+    for (auto &worker : _workers)
+        if (worker->local.size() > 0)
+            return true;
+    return false;
+}
+
+void ThreadPool::_park() {
+    uint64_t epoch = _epoch.load(std::memory_order_acquire);
+    _sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_hasWork() && !_isClosed.load(std::memory_order_acquire)) {
+        std::unique_lock<std::mutex> locker(_parkMtx);
+        _parkCond.wait(locker, [&] {
+            return _epoch.load(std::memory_order_relaxed) != epoch || _isClosed.load(std::memory_order_relaxed);
+        });
+    }
+    _sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::_wake(bool all) {
+    {
+        std::lock_guard<std::mutex> locker(_parkMtx);
+        _epoch.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (all)
+        _parkCond.notify_all();
+    else
+        _parkCond.notify_one();
+}
+
+}
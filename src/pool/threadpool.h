@@ -8,74 +8,108 @@
 #define __THREADPOOL_H__
 
 #include <mutex>
-#include <condition_variable>
-#include <queue>
+#include <deque>
+#include <atomic>
+#include <memory>
 #include <thread>
-#include <functional>
+#include <functional>       // std::bind, 提交方常用
+#include <vector>
+#include <condition_variable>
 
 #include <cassert>
+#include <cstdint>
+
+#include "task.h"
+#include "cpuaffinity.h"
 
 namespace wsv
 {
 
+/*
+ * 工作窃取线程池. 事件循环 (池外线程) 提交的任务进入无锁的注入队列,
+ * 工作线程自己提交的任务进入本线程的队列. 工作线程依次从本线程队列, 注入队列,
+ * 其他线程的队列取任务; 都取不到时先自旋一会儿, 仍没有才挂起.
+ * 只有存在挂起的线程时提交方才加锁唤醒, 忙时入队只有一次 CAS.
+ * 析构时执行完已提交的任务后 join 所有线程.
+ */
 class ThreadPool
 {
 public:
-    explicit ThreadPool(size_t threadCount = 8) : _poolImpl(std::make_shared<Pool>()) {
-        assert(threadCount > 0);
-        for (size_t i = 0; i < threadCount; i++) {
-            std::thread([=] {
-                std::unique_lock<std::mutex> locker(_poolImpl->mtx);
-                for (;;) {
-                    if (!_poolImpl->tasks.empty()) {
-                        auto task = std::move(_poolImpl->tasks.front());
-                        _poolImpl->tasks.pop();
-                        locker.unlock();
-                        task();
-                        locker.lock();
-                    } else if (_poolImpl->isClosed) {
-                        break;
-                    } else {
-                        _poolImpl->cond.wait(locker);
-                    }
-                 }
-            }).detach();
-        }
-    }
-
-    ThreadPool() = default;
-    ThreadPool(ThreadPool&&) = default;
-
-    ~ThreadPool() {
-        if (_poolImpl) {
-            {
-                std::lock_guard<std::mutex> locker(_poolImpl->mtx);
-                _poolImpl->isClosed = true;
-            }
-            _poolImpl->cond.notify_all();
-        }
-    }
+    // cpus 非空时第 i 个线程绑定到 cpus[i % cpus.size()]; maxQueue 为 tryAddTask 的队列上限, 0 不限制
+    explicit ThreadPool(size_t threadCount = 8, const std::vector<int> &cpus = std::vector<int>(), size_t maxQueue = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
 
     template<class F>
-    void addTask(F &&task) {
-        if (_poolImpl) {
-            {
-                std::lock_guard<std::mutex> locker(_poolImpl->mtx);
-                _poolImpl->tasks.emplace(std::forward<F>(task));
-            }
-            _poolImpl->cond.notify_one();
-        }
-    }
+    void addTask(F &&task) { _submit(Task(std::forward<F>(task)), false); }
+
+    // 队列已满时不入队, 返回 false
+    template<class F>
+    bool tryAddTask(F &&task) { return _submit(Task(std::forward<F>(task)), true); }
+
+    size_t queueSize() const;       // 近似值, 各队列的长度之和
+    size_t threadCount() const;
+
+    static const size_t INJECT_CAPACITY = 16384;    // 超出部分进入加锁的后备队列
+    static const size_t LOCAL_CAPACITY = 1024;
+    static const int SPIN_ROUNDS = 64;              // 挂起前的空转次数
+    static const int YIELD_ROUNDS = 4;              // 空转后让出 CPU 的次数
 
 private:
-    struct Pool
+    /* 有界 MPMC 环形队列: 每个槽位的序号表明它当前可写还是可读, 任务直接存放在槽位中 */
+    class TaskRing
+    {
+    public:
+        explicit TaskRing(size_t capacity);
+
+        bool push(Task &task);      // 成功时任务被移走
+        bool pop(Task &task);
+        size_t size() const;
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> seq;
+            Task task;
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        size_t _mask;
+        alignas(64) std::atomic<size_t> _head;
+        alignas(64) std::atomic<size_t> _tail;
+    };
+
+    struct Worker
     {
-        std::mutex mtx;
-        std::condition_variable cond;
-        bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        TaskRing local;
+        std::thread thread;
+        Worker() : local(LOCAL_CAPACITY) { }
     };
-    std::shared_ptr<Pool> _poolImpl;
+
+    bool _submit(Task &&task, bool bounded);
+    void _run(size_t index, int cpu);
+    bool _runOne(size_t index);
+    bool _popOverflow(Task &task);
+    bool _hasWork() const;
+    void _park();
+    void _wake(bool all);
+
+private:
+    std::vector<std::unique_ptr<Worker>> _workers;
+    TaskRing _inject;
+    size_t _maxQueue;
+    std::atomic<bool> _isClosed;
+
+    std::mutex _overflowMtx;
+    std::deque<Task> _overflow;
+    std::atomic<size_t> _overflowSize;
+
+    std::mutex _parkMtx;
+    std::condition_variable _parkCond;
+    std::atomic<int> _sleepers;
+    std::atomic<uint64_t> _epoch;       // 每次唤醒递增, 挂起前记下, 避免错过唤醒
 };
 
 }
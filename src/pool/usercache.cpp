@@ -0,0 +1,152 @@
+/**
+ * @file usercache.cpp
+ * @brief  用户凭据缓存, 同一用户名的并发查询合并
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "usercache.h"
+
+#include <random>
+#include <algorithm>
+
+namespace wsv
+{
+
+UserCache* UserCache::Instance() {
+    static UserCache cache;
+    return &cache;
+}
+
+UserCache::UserCache() : _ttl(0), _shardCapacity(0), _seed(0), _hits(0), _misses(0), _coalesced(0) { }
+
+// 在使用之前调用; ttlMS <= 0 时不启用, 每次都查询数据库
+void UserCache::init(int ttlMS, size_t capacity) {
+    if (ttlMS <= 0 || capacity == 0)
+        return;
+    _ttl = std::chrono::milliseconds(ttlMS);
+    _shardCapacity = std::max<size_t>(capacity / SHARD_NUM, 1);
+    std::random_device rd;
+    _seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    _shards = std::make_unique<Shard[]>(SHARD_NUM);
+}
+
+bool UserCache::isEnabled() const { return _shards != nullptr; }
+
+UserCache::STATUS UserCache::lookup(std::string_view name, std::string_view pwd, bool *match, const Loader &load) {
+    std::string stored;
+    if (!isEnabled()) {
+        STATUS status = load(&stored);
+        *match = status == FOUND && stored == pwd;
+        return status;
+    }
+    Shard &shard = _shard(name);
+    std::string key(name);
+    std::unique_lock<std::mutex> locker(shard.mtx);
+    uint64_t digest;
+    if (_find(shard, key, &digest)) {
+        _hits.fetch_add(1, std::memory_order_relaxed);
+        *match = digest == _digest(pwd);
+        return FOUND;
+    }
+    auto it = shard.flights.find(key);
+    if (it != shard.flights.end()) {
+        // 已有线程在查询该用户, 等待它的结果
+        std::shared_ptr<Flight> flight = it->second;
+        _coalesced.fetch_add(1, std::memory_order_relaxed);
+        flight->cond.wait(locker, [&flight] { return flight->done; });
+        *match = flight->status == FOUND && flight->digest == _digest(pwd);
+        return flight->status;
+    }
+    _misses.fetch_add(1, std::memory_order_relaxed);
+    auto flight = std::make_shared<Flight>();
+    shard.flights.emplace(key, flight);
+    locker.unlock();
+
+    STATUS status = load(&stored);
+    *match = status == FOUND && stored == pwd;
+    digest = status == FOUND ? _digest(stored) : 0;
+
+    locker.lock();
+    if (status == FOUND)
+        _insert(shard, key, digest);
+    flight->done = true;
+    flight->status = status;
+    flight->digest = digest;
+    shard.flights.erase(key);
+    flight->cond.notify_all();
+    return status;
+}
+
+bool UserCache::peek(std::string_view name, std::string_view pwd, bool *match) {
+    if (!isEnabled())
+        return false;
+    Shard &shard = _shard(name);
+    std::string key(name);
+    uint64_t digest;
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    if (!_find(shard, key, &digest)) {
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    _hits.fetch_add(1, std::memory_order_relaxed);
+    *match = digest == _digest(pwd);
+    return true;
+}
+
+// 注册成功后写入, 随后的登录不再查询数据库
+void UserCache::put(std::string_view name, std::string_view pwd) {
+    if (!isEnabled())
+        return;
+    Shard &shard = _shard(name);
+    std::string key(name);
+    uint64_t digest = _digest(pwd);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    _insert(shard, key, digest);
+}
+
+uint64_t UserCache::hits() const { return _hits.load(std::memory_order_relaxed); }
+
+uint64_t UserCache::misses() const { return _misses.load(std::memory_order_relaxed); }
+
+uint64_t UserCache::coalesced() const { return _coalesced.load(std::memory_order_relaxed); }
+
+UserCache::Shard& UserCache::_shard(std::string_view name) {
+    return _shards[std::hash<std::string_view>()(name) % SHARD_NUM];
+}
+
+// 持有分片锁时调用, 过期的条目顺便删除
+bool UserCache::_find(Shard &shard, const std::string &key, uint64_t *digest) {
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end())
+        return false;
+    if (it->second.expires <= Clock::now()) {
+        shard.entries.erase(it);
+        return false;
+    }
+    *digest = it->second.digest;
+    return true;
+}
+
+// 持有分片锁时调用; 分片已满时随意淘汰一个条目, 过期时间保证缓存内容不会太旧
+void UserCache::_insert(Shard &shard, const std::string &key, uint64_t digest) {
+    if (shard.entries.size() >= _shardCapacity && shard.entries.count(key) == 0)
+        shard.entries.erase(shard.entries.begin());
+    shard.entries[key] = { digest, Clock::now() + _ttl };
+}
+
+// 带随机种子的 FNV-1a 再做一次 splitmix64 混合, 只用于比对, 不是密码存储用的哈希
+uint64_t UserCache::_digest(std::string_view pwd) const {
+    uint64_t h = 14695981039346656037ULL ^ _seed;
+    for (unsigned char c : pwd) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+}
@@ -0,0 +1,100 @@
+/**
+ * @file usercache.h
+ * @brief  用户凭据缓存, 同一用户名的并发查询合并
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __USERCACHE_H__
+#define __USERCACHE_H__
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace wsv
+{
+
+/*
+ * 放在 SqlConnPool 前面, 缓存查到的 用户名 -> 密码摘要, 条目 ttlMS 后过期.
+ * 按用户名哈希分片, 每片一把锁; 未命中时同一用户名只有一个线程查询数据库,
+ * 其余线程等待它的结果 (single-flight). 不存在的用户不缓存, 注册成功后写入.
+ * 只保存带随机种子的 64 位摘要, 不保存明文密码.
+ */
+class UserCache
+{
+public:
+    enum STATUS {
+        FOUND = 0,
+        NOT_FOUND,
+        DB_ERROR,
+    };
+    // 查询数据库, 用户存在时写入 pwd 并返回 FOUND
+    typedef std::function<STATUS(std::string *pwd)> Loader;
+
+    static UserCache* Instance();
+
+    void init(int ttlMS, size_t capacity);
+    bool isEnabled() const;
+
+    // 查找用户并比对密码, 返回 FOUND 时 *match 为密码是否一致; 未启用时直接调用 load
+    STATUS lookup(std::string_view name, std::string_view pwd, bool *match, const Loader &load);
+    // 只查缓存, 不访问数据库; 命中时返回 true 并写入 *match
+    bool peek(std::string_view name, std::string_view pwd, bool *match);
+    void put(std::string_view name, std::string_view pwd);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+    uint64_t coalesced() const;     // 等待其他线程查询结果的次数, 与命中一起为省下的查询数
+
+private:
+    UserCache();
+    ~UserCache() = default;
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        uint64_t digest;
+        Clock::time_point expires;
+    };
+    /* 进行中的查询, 等待者持有 shared_ptr, 结果由查询者填写 */
+    struct Flight
+    {
+        bool done = false;
+        STATUS status = DB_ERROR;
+        uint64_t digest = 0;
+        std::condition_variable cond;
+    };
+    struct alignas(64) Shard
+    {
+        std::mutex mtx;
+        std::unordered_map<std::string, Entry> entries;
+        std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    };
+
+    Shard& _shard(std::string_view name);
+    bool _find(Shard &shard, const std::string &key, uint64_t *digest);
+    void _insert(Shard &shard, const std::string &key, uint64_t digest);
+    uint64_t _digest(std::string_view pwd) const;
+
+private:
+    std::chrono::milliseconds _ttl;
+    size_t _shardCapacity;
+    uint64_t _seed;
+    std::unique_ptr<Shard[]> _shards;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+    std::atomic<uint64_t> _coalesced;
+
+    static const size_t SHARD_NUM = 16;
+};
+
+}
+
+#endif // __USERCACHE_H__
@@ -0,0 +1,147 @@
+/**
+ * @file userfilter.cpp
+ * @brief  已注册用户名的 Bloom 过滤器, 注册时确定不存在的用户名跳过查询
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "userfilter.h"
+
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+
+namespace wsv
+{
+
+// 块内 8 个字各用一个奇数乘子从同一个 32 位哈希取出位下标
+static const uint32_t SALT[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+UserFilter* UserFilter::Instance() {
+    static UserFilter filter;
+    return &filter;
+}
+
+UserFilter::UserFilter() : _blockNum(0), _count(0), _checks(0), _skipped(0) { }
+
+UserFilter::LOAD_RESULT UserFilter::load(MYSQL *sql) {
+    if (!sql)
+        return LOAD_ERROR;
+    if (!_hasUniqueKey(sql))
+        return NO_UNIQUE_KEY;
+
+    // 先取行数确定大小, 留出一倍给之后注册的用户; 载入期间新增的行只会让过滤器稍满一些
+    if (mysql_query(sql, "SELECT COUNT(*) FROM user"))
+        return LOAD_ERROR;
+    MYSQL_RES *res = mysql_store_result(sql);
+    if (!res)
+        return LOAD_ERROR;
+    MYSQL_ROW row = mysql_fetch_row(res);
+    size_t rows = row && row[0] ? strtoull(row[0], nullptr, 10) : 0;
+    mysql_free_result(res);
+    init(std::max(rows * 2, MIN_CAPACITY));
+
+    // 逐行读取, 不把整张表缓存在客户端
+    if (mysql_query(sql, "SELECT username FROM user") || !(res = mysql_use_result(sql))) {
+        _blocks.reset();
+        return LOAD_ERROR;
+    }
+    size_t count = 0;
+    while ((row = mysql_fetch_row(res))) {
+        unsigned long *lengths = mysql_fetch_lengths(res);
+        if (row[0]) {
+            _set(std::string_view(row[0], lengths[0]), false);
+            count++;
+        }
+    }
+    _count = count;
+    mysql_free_result(res);
+    // 读到一半断开时少了部分用户名, 会漏报, 不能启用
+    if (mysql_errno(sql)) {
+        _blocks.reset();
+        return LOAD_ERROR;
+    }
+    return LOADED;
+}
+
+void UserFilter::init(size_t capacity) {
+    _blockNum = std::max<size_t>((capacity * BITS_PER_KEY + WORDS * 64 - 1) / (WORDS * 64), 1);
+    _blocks = std::make_unique<Block[]>(_blockNum);
+    _count = 0;
+}
+
+bool UserFilter::isEnabled() const { return _blocks != nullptr; }
+
+void UserFilter::add(std::string_view name) {
+    if (!isEnabled())
+        return;
+    _set(name, true);
+    _count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool UserFilter::mayContain(std::string_view name) {
+    if (!isEnabled())
+        return true;
+    _checks.fetch_add(1, std::memory_order_relaxed);
+    uint64_t hash = _hash(name);
+    const Block &block = _block(hash);
+    // 8 个字都读完再判断, 不逐位分支
+    uint64_t missing = 0;
+    for (int i = 0; i < WORDS; i++) {
+        uint64_t bit = 1ULL << ((static_cast<uint32_t>(hash) * SALT[i]) >> 26);
+        missing |= bit & ~block.word[i].load(std::memory_order_relaxed);
+    }
+    if (missing)
+        _skipped.fetch_add(1, std::memory_order_relaxed);
+    return missing == 0;
+}
+
+size_t UserFilter::count() const { return _count.load(std::memory_order_relaxed); }
+
+size_t UserFilter::bytes() const { return _blockNum * sizeof(Block); }
+
+uint64_t UserFilter::checks() const { return _checks.load(std::memory_order_relaxed); }
+
+uint64_t UserFilter::skipped() const { return _skipped.load(std::memory_order_relaxed); }
+
+// 只有单列唯一键能保证插入重复用户名时失败
+bool UserFilter::_hasUniqueKey(MYSQL *sql) {
+    if (mysql_query(sql, "SELECT 1 FROM information_schema.STATISTICS WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='user' "
+                         "GROUP BY INDEX_NAME HAVING COUNT(*)=1 AND MAX(COLUMN_NAME)='username' AND MAX(NON_UNIQUE)=0"))
+        return false;
+    MYSQL_RES *res = mysql_store_result(sql);
+    if (!res)
+        return false;
+    bool found = mysql_fetch_row(res) != nullptr;
+    mysql_free_result(res);
+    return found;
+}
+
+// 载入时只有一个线程写, 普通的读改写即可; 运行中各线程可能同时加入同一块, 用原子或
+void UserFilter::_set(std::string_view name, bool shared) {
+    uint64_t hash = _hash(name);
+    Block &block = _block(hash);
+    for (int i = 0; i < WORDS; i++) {
+        uint64_t bit = 1ULL << ((static_cast<uint32_t>(hash) * SALT[i]) >> 26);
+        uint64_t word = block.word[i].load(std::memory_order_relaxed);
+        if (word & bit)
+            continue;
+        if (shared)
+            block.word[i].fetch_or(bit, std::memory_order_relaxed);
+        else
+            block.word[i].store(word | bit, std::memory_order_relaxed);
+    }
+}
+
+uint64_t UserFilter::_hash(std::string_view name) {
+    return std::hash<std::string_view>()(name);
+}
+
+// 高 32 位按乘法映射到块下标, 低 32 位留给块内的位下标
+UserFilter::Block& UserFilter::_block(uint64_t hash) const {
+    return _blocks[((hash >> 32) * _blockNum) >> 32];
+}
+
+}
@@ -0,0 +1,79 @@
+/**
+ * @file userfilter.h
+ * @brief  已注册用户名的 Bloom 过滤器, 注册时确定不存在的用户名跳过查询
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __USERFILTER_H__
+#define __USERFILTER_H__
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+
+#include <mysql/mysql.h>
+
+namespace wsv
+{
+
+/*
+ * 分块 Bloom 过滤器: 每个用户名只落在一个 64 字节的块内, 块中 8 个字各置一位,
+ * 查询只访问一条缓存行. 启动时从 user 表批量载入, 之后每次插入成功时加入; 只增不删, 各位以原子操作置位, 读不加锁.
+ * 过滤器没有漏报, 回答 "不存在" 时注册直接插入; 其他进程 (如热升级时的旧进程) 插入的用户名可能不在过滤器中,
+ * 由 username 上的唯一键兜底, 没有该唯一键时不启用.
+ */
+class UserFilter
+{
+public:
+    enum LOAD_RESULT {
+        LOADED = 0,
+        NO_UNIQUE_KEY,      // username 上没有单列唯一键
+        LOAD_ERROR,
+    };
+
+    static UserFilter* Instance();
+
+    // 用 sql 读出 user 表的全部用户名, 成功后启用; 在开始处理请求之前调用
+    LOAD_RESULT load(MYSQL *sql);
+    // 按预计的用户数分配空的过滤器并启用
+    void init(size_t capacity);
+    bool isEnabled() const;
+
+    void add(std::string_view name);
+    // 未启用时返回 true; 返回 false 时该用户名一定不在 user 表中 (不计其他进程的插入)
+    bool mayContain(std::string_view name);
+
+    size_t count() const;       // 已加入的用户名数
+    size_t bytes() const;
+    uint64_t checks() const;
+    uint64_t skipped() const;   // 回答不存在, 省下查询的次数
+
+private:
+    UserFilter();
+    ~UserFilter() = default;
+
+    static const int WORDS = 8;
+    struct alignas(64) Block
+    {
+        std::atomic<uint64_t> word[WORDS];
+    };
+
+    void _set(std::string_view name, bool shared);
+    static bool _hasUniqueKey(MYSQL *sql);
+    static uint64_t _hash(std::string_view name);
+    Block& _block(uint64_t hash) const;
+
+private:
+    std::unique_ptr<Block[]> _blocks;   // load() / init() 后不再变化
+    size_t _blockNum;
+    std::atomic<size_t> _count;
+    std::atomic<uint64_t> _checks;
+    std::atomic<uint64_t> _skipped;
+
+    static constexpr size_t BITS_PER_KEY = 16;     // 按预计用户数计, 误判率约 0.1%
+    static constexpr size_t MIN_CAPACITY = 1 << 20; // 空表时也留出新注册用户的位置
+};
+
+}
+
+#endif // __USERFILTER_H__
@@ -0,0 +1,125 @@
+/**
+ * @file conntable.hpp
+ * @brief  按 fd 下标访问的预分配连接表
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __CONNTABLE_HPP__
+#define __CONNTABLE_HPP__
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+#include <sys/mman.h>
+
+namespace wsv
+{
+
+/*
+ * 槽位按 fd 下标一次性分配 (匿名映射, 未使用的页不占物理内存), 按缓存行对齐,
+ * 元素在第一次 acquire() 时原地构造, 此后地址不再变化.
+ * 每次 acquire() 都会递增槽位的代数, 定时器回调和线程池任务记下代数,
+ * 执行前用 isCurrent() 判断 fd 是否已被新连接复用.
+ */
+template<class T>
+class ConnTable
+{
+public:
+    explicit ConnTable(size_t capacity);
+    ~ConnTable();
+
+    ConnTable(const ConnTable&) = delete;
+    ConnTable& operator=(const ConnTable&) = delete;
+
+    T* acquire(int fd);
+    T* get(int fd);
+    uint32_t generation(int fd) const;
+    bool isCurrent(int fd, uint32_t gen) const;
+    bool contains(int fd) const;
+    size_t capacity() const;
+
+    template<class F>
+    void forEach(F func);
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint32_t> gen;
+        bool constructed;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    size_t _capacity;
+    size_t _mapSize;
+    Slot *_slots;
+};
+
+template<class T>
+ConnTable<T>::ConnTable(size_t capacity) : _capacity(capacity), _mapSize(capacity * sizeof(Slot)) {
+    void *mem = mmap(nullptr, _mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED)
+        exit(EXIT_FAILURE);
+    _slots = static_cast<Slot*>(mem); // 匿名映射已清零: gen = 0, constructed = false
+}
+
+template<class T>
+ConnTable<T>::~ConnTable() {
+    for (size_t i = 0; i < _capacity; i++)
+        if (_slots[i].constructed)
+            reinterpret_cast<T*>(&_slots[i].storage)->~T();
+    munmap(_slots, _mapSize);
+}
+
+template<class T>
+T* ConnTable<T>::acquire(int fd) {
+    assert(contains(fd));
+    Slot &slot = _slots[fd];
+    if (!slot.constructed) {
+        new (&slot.storage) T();
+        slot.constructed = true;
+    }
+    slot.gen.fetch_add(1, std::memory_order_release);
+    return reinterpret_cast<T*>(&slot.storage);
+}
+
+// 只用于已 acquire 过的 fd, 不做检查
+template<class T>
+T* ConnTable<T>::get(int fd) {
+    assert(contains(fd) && _slots[fd].constructed);
+    return reinterpret_cast<T*>(&_slots[fd].storage);
+}
+
+template<class T>
+uint32_t ConnTable<T>::generation(int fd) const {
+    assert(contains(fd));
+    return _slots[fd].gen.load(std::memory_order_acquire);
+}
+
+template<class T>
+bool ConnTable<T>::isCurrent(int fd, uint32_t gen) const {
+    return contains(fd) && _slots[fd].gen.load(std::memory_order_acquire) == gen;
+}
+
+template<class T>
+bool ConnTable<T>::contains(int fd) const { return fd >= 0 && static_cast<size_t>(fd) < _capacity; }
+
+template<class T>
+size_t ConnTable<T>::capacity() const { return _capacity; }
+
+// 遍历构造过的槽位 (包括已关闭的连接), 只在排空等少见场合使用
+template<class T>
+template<class F>
+void ConnTable<T>::forEach(F func) {
+    for (size_t i = 0; i < _capacity; i++)
+        if (_slots[i].constructed)
+            func(static_cast<int>(i), *reinterpret_cast<T*>(&_slots[i].storage));
+}
+
+}
+
+#endif // __CONNTABLE_HPP__
@@ -9,7 +9,7 @@
 namespace wsv
 {
 
-Epoller::Epoller(int maxEvent) : _epollFd(epoll_create1(0)), _events(maxEvent) {
+Epoller::Epoller(int maxEvent) : _epollFd(epoll_create1(EPOLL_CLOEXEC)), _events(maxEvent) {
     if (_epollFd < 0 || _events.size() <= 0) {
         LOG_ERROR("Epoller > Epoller: _epollFd < 0 or _events.size() <= 0");
         exit(EXIT_FAILURE);
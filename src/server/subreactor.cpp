@@ -0,0 +1,284 @@
+/**
+ * @file subreactor.cpp
+ * @brief  子 reactor: 独占线程的事件循环
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "subreactor.h"
+
+namespace wsv
+{
+
+SubReactor::SubReactor(int id, int timeoutMS, uint32_t connEvent, int maxFd, int cpu)
+    : _id(id), _timeoutMS(timeoutMS), _wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), _cpu(cpu), _listenFd(-1), _acceptBudget(1),
+    _connEvent(connEvent & ~EPOLLONESHOT), _isClosed(true), _isDraining(false), _drained(false),
+    _epoller(std::make_unique<Epoller>()), _timer(std::make_unique<HeapTimer>()), _users(maxFd), _blockingPool(nullptr) {
+    if (_wakeFd < 0 || !_epoller->addFd(_wakeFd, EPOLLIN)) {
+        LOG_ERROR("SubReactor[%d] > SubReactor: eventfd error", _id);
+        exit(EXIT_FAILURE);
+    }
+}
+
+SubReactor::~SubReactor() {
+    stop();
+    if (_listenFd >= 0)
+        ::close(_listenFd);
+    ::close(_wakeFd);
+}
+
+// 在 start() 之前调用; 监听套接字交给本线程, 由本线程在 drain 时注销并关闭, 或在析构时关闭
+void SubReactor::listen(int listenFd, int acceptBudget) {
+    _listenFd = listenFd;
+    _acceptBudget = acceptBudget > 0 ? acceptBudget : 1;
+    // 水平触发: 预算用完后下一轮 epoll 仍会通知
+    if (!_epoller->addFd(_listenFd, EPOLLIN)) {
+        LOG_ERROR("SubReactor[%d] > listen: add listen fd error", _id);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// 在 start() 之前调用; 执行器由 WebServer 持有, 先于子 reactor 销毁
+void SubReactor::setBlockingPool(ThreadPool *pool) { _blockingPool = pool; }
+
+// 在 start() 之前调用; 客户端库不支持非阻塞 API 时返回 false, 继续使用阻塞执行器
+bool SubReactor::initAsyncSql(int sqlPort, const char *sqlUser, const char *sqlPwd, const char *dbName, int connNum, int queueTimeoutMS) {
+    auto sql = std::make_unique<AsyncSql>(_epoller.get(), _timer.get());
+    if (!sql->init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connNum, queueTimeoutMS))
+        return false;
+    _asyncSql = std::move(sql);
+    return true;
+}
+
+void SubReactor::start() {
+    if (_thread) return;
+    _isClosed = false;
+    _thread = std::make_unique<std::thread>(&SubReactor::_loop, this);
+}
+
+void SubReactor::stop() {
+    if (!_thread) return;
+    _isClosed = true;
+    _wakeup();
+    if (_thread->joinable())
+        _thread->join();
+    _thread.reset();
+}
+
+void SubReactor::addConn(int fd, const sockaddr_in &addr) {
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _pending.emplace_back(fd, addr);
+    }
+    _wakeup();
+}
+
+void SubReactor::drain() {
+    _isDraining = true;
+    _wakeup();
+}
+
+void SubReactor::_wakeup() {
+    uint64_t one = 1;
+    if (::write(_wakeFd, &one, sizeof(one)) != sizeof(one))
+        LOG_WARN("SubReactor[%d] wakeup error!", _id);
+}
+
+void SubReactor::_handleWakeup() {
+    uint64_t cnt;
+    while (::read(_wakeFd, &cnt, sizeof(cnt)) > 0) { }
+    std::vector<std::pair<int, sockaddr_in>> pending;
+    std::vector<Task> posted;
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        pending.swap(_pending);
+        posted.swap(_posted);
+    }
+    for (auto &item : pending)
+        _addClient(item.first, item.second);
+    for (auto &task : posted)
+        task();
+    if (_isDraining && !_drained) {
+        // 空闲的长连接直接关闭; 正在写响应或已收到部分请求的连接继续处理, 响应带 Connection: close, 发完后关闭
+        _drained = true;
+        if (_listenFd >= 0) {
+            _epoller->delFd(_listenFd);
+            ::close(_listenFd);
+            _listenFd = -1;
+        }
+        _users.forEach([this](int, HttpConn &client) {
+            if (!client.isClosed() && client.isIdle())
+                _closeConn(&client);
+        });
+    }
+}
+
+void SubReactor::_loop() {
+    int timeMS = -1;
+    // 先绑核再访问连接表, 缓冲区等内存按首次访问分配在本地节点
+    if (_cpu >= 0 && !CpuAffinity::pin(_cpu))
+        LOG_WARN("SubReactor[%d] pin to cpu %d error!", _id, _cpu);
+    LOG_INFO("SubReactor[%d] start, cpu: %d, node: %d", _id, _cpu, _cpu >= 0 ? CpuAffinity::numaNode(_cpu) : -1);
+    while (!_isClosed) {
+        if (_timeoutMS > 0 || _asyncSql)
+            timeMS = _timer->getNextTick();
+        int eventCnt = _epoller->wait(timeMS);
+        for (int i = 0; i < eventCnt; i++) {
+            int fd = _epoller->getEventFd(i);
+            uint32_t events = _epoller->getEvents(i);
+            if (fd == _wakeFd) {
+                _handleWakeup();
+            } else if (fd == _listenFd) {
+                _dealListen();
+            } else if (_asyncSql && _asyncSql->handleEvent(fd, events)) {
+                continue;
+            } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                _closeConn(_users.get(fd));
+            } else if (events & EPOLLIN) {
+                _dealRead(_users.get(fd));
+            } else if (events & EPOLLOUT) {
+                _dealWrite(_users.get(fd));
+            } else {
+                LOG_ERROR("SubReactor[%d] unexpected event", _id);
+            }
+        }
+    }
+    LOG_INFO("SubReactor[%d] quit", _id);
+}
+
+void SubReactor::_dealListen() {
+    struct sockaddr_in addr;
+    for (int n = 0; n < _acceptBudget; n++) {
+        socklen_t len = sizeof(addr);
+        int fd = accept4(_listenFd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd <= 0)
+            return;
+        if (HttpConn::userCount >= static_cast<int>(_users.capacity()) || !_users.contains(fd)) {
+            const char *info = HttpResponse::BUSY_RESPONSE;
+            if (send(fd, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+                LOG_WARN("send error to client[%d] error!", fd);
+            ::close(fd);
+            LOG_WARN("Clients is full!");
+            continue;
+        }
+        _addClient(fd, addr);
+    }
+}
+
+void SubReactor::_addClient(int fd, const sockaddr_in &addr) {
+    assert(fd > 0);
+    _users.acquire(fd)->init(fd, addr);
+    if (_timeoutMS > 0)
+        _timer->add(fd, _timeoutMS, std::bind(&SubReactor::_onTimeout, this, fd, _users.generation(fd)));
+    _epoller->addFd(fd, EPOLLIN | _connEvent);
+    LOG_INFO("SubReactor[%d] Client[%d] in!", _id, fd);
+}
+
+void SubReactor::_dealRead(HttpConn *client) {
+    assert(client);
+    _extentTime(client);
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno);
+    if (ret <= 0 && readErrno != EAGAIN) {
+        _closeConn(client);
+        return;
+    }
+    _onProcess(client);
+}
+
+void SubReactor::_dealWrite(HttpConn *client) {
+    assert(client);
+    _extentTime(client);
+    if (_onWrite(client, true)) {
+        // 响应写完, 切回读事件再处理缓冲区中剩余的请求
+        _epoller->modFd(client->getFd(), _connEvent | EPOLLIN);
+        _onProcess(client);
+    }
+}
+
+void SubReactor::_extentTime(HttpConn *client) {
+    assert(client);
+    if (_timeoutMS > 0) { _timer->adjust(client->getFd(), _timeoutMS); }
+}
+
+void SubReactor::_closeConn(HttpConn *client) {
+    assert(client);
+    LOG_INFO("SubReactor[%d] Client[%d] quit!", _id, client->getFd());
+    _epoller->delFd(client->getFd());
+    client->close();
+}
+
+// 连接关闭后 fd 可能已被数据库连接复用, 过期的定时器不能再操作该 fd
+void SubReactor::_onTimeout(int fd, uint32_t gen) {
+    if (_users.isCurrent(fd, gen) && !_users.get(fd)->isClosed()) _closeConn(_users.get(fd));
+}
+
+void SubReactor::_onProcess(HttpConn *client) {
+    // 连接只属于本线程, 直接写出, 只有写阻塞时才关注 EPOLLOUT
+    while (client->process()) {
+        if (!_onWrite(client, false))
+            return;
+    }
+    if (client->isVerifying())
+        _dispatchVerify(client);
+}
+
+// 查询在阻塞执行器或本线程的非阻塞连接中执行, 本线程不等待; 期间连接可能超时关闭, 回调按代数判断
+void SubReactor::_dispatchVerify(HttpConn *client) {
+    auto cred = std::make_unique<HttpRequest::Credential>();
+    if (!client->takeVerify(cred.get()))
+        return;
+    uint32_t gen = _users.generation(client->getFd());
+    if (_asyncSql) {
+        HttpRequest::UserVerifyAsync(_asyncSql.get(), std::move(*cred), [this, client, gen](bool ok) {
+            if (!_users.isCurrent(client->getFd(), gen) || client->isClosed())
+                return;
+            client->onVerified(ok);
+            _onProcess(client);
+        });
+        return;
+    }
+    bool added = _blockingPool->tryAddTask([this, client, gen, cred = std::move(cred)] {
+        bool ok = HttpRequest::UserVerify(cred->name, cred->pwd, cred->isLogin);
+        _post([this, client, gen, ok] {
+            if (!_users.isCurrent(client->getFd(), gen) || client->isClosed())
+                return;
+            client->onVerified(ok);
+            _onProcess(client);
+        });
+    });
+    if (!added) {
+        // 交出前本轮没有其他响应, 直接回 503 并关闭
+        LOG_WARN("SubReactor[%d] blocking executor queue is full!", _id);
+        const char *info = HttpResponse::BUSY_RESPONSE;
+        if (send(client->getFd(), info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+            LOG_WARN("send error to client[%d] error!", client->getFd());
+        _closeConn(client);
+    }
+}
+
+void SubReactor::_post(Task &&task) {
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _posted.push_back(std::move(task));
+    }
+    _wakeup();
+}
+
+// 返回 true 表示响应已全部发出且连接保持, 可以继续处理下一个请求
+bool SubReactor::_onWrite(HttpConn *client, bool armedOut) {
+    int writeErrno = 0;
+    ssize_t ret = client->write(&writeErrno);
+    if (client->toWriteBytes() == 0) {
+        if (client->isKeepAlive())
+            return true;
+    } else if (ret > 0 || writeErrno == EAGAIN) {
+        // 未写完, 等待可写
+        if (!armedOut)
+            _epoller->modFd(client->getFd(), _connEvent | EPOLLOUT);
+        return false;
+    }
+    _closeConn(client);
+    return false;
+}
+
+}
@@ -0,0 +1,96 @@
+/**
+ * @file subreactor.h
+ * @brief  子 reactor: 独占线程的事件循环
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __SUBREACTOR_H__
+#define __SUBREACTOR_H__
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include <sys/eventfd.h>    // eventfd()
+
+#include "epoller.h"
+#include "conntable.hpp"
+#include "../pool/cpuaffinity.h"
+#include "../pool/threadpool.h"
+#include "../pool/asyncsql.h"
+#include "../log/log.h"
+#include "../http/httpconn.h"
+#include "../timer/heaptimer.h"
+
+namespace wsv
+{
+
+/*
+ * 每个 SubReactor 拥有自己的 Epoller / HeapTimer / 连接表, 运行在独立线程中.
+ * 主 reactor 只负责 accept, 通过 addConn() 投递 fd 后由本线程完成注册,
+ * 连接此后的读, 解析, 写都在该线程内完成, 不再需要 EPOLLONESHOT 重新注册.
+ * 开启 SO_REUSEPORT 分片时由 listen() 交给本线程一个独立的监听套接字, 直接在本线程 accept.
+ * 登录/注册请求交给阻塞执行器访问数据库, 结果投递回本线程后继续处理该连接;
+ * 启用 initAsyncSql() 时改由本线程的非阻塞数据库连接执行, 查询期间继续处理其他连接.
+ */
+class SubReactor
+{
+public:
+    SubReactor(int id, int timeoutMS, uint32_t connEvent, int maxFd, int cpu = -1);
+    ~SubReactor();
+
+    void listen(int listenFd, int acceptBudget);
+    void setBlockingPool(ThreadPool *pool);
+    bool initAsyncSql(int sqlPort, const char *sqlUser, const char *sqlPwd, const char *dbName, int connNum, int queueTimeoutMS);
+    void start();
+    void stop();
+    void addConn(int fd, const sockaddr_in &addr);
+    void drain();
+
+private:
+    void _loop();
+    void _wakeup();
+    void _handleWakeup();
+    void _dealListen();
+    void _addClient(int fd, const sockaddr_in &addr);
+
+    void _dealRead(HttpConn *client);
+    void _dealWrite(HttpConn *client);
+
+    void _extentTime(HttpConn *client);
+    void _closeConn(HttpConn *client);
+    void _onTimeout(int fd, uint32_t gen);
+
+    void _onProcess(HttpConn *client);
+    bool _onWrite(HttpConn *client, bool armedOut);
+    void _dispatchVerify(HttpConn *client);
+    void _post(Task &&task);
+
+private:
+    int _id;
+    int _timeoutMS;
+    int _wakeFd;
+    int _cpu;
+    int _listenFd;          // SO_REUSEPORT 分片时本线程自己 accept
+    int _acceptBudget;
+    uint32_t _connEvent;
+    std::atomic<bool> _isClosed;
+    std::atomic<bool> _isDraining;
+    bool _drained;
+    std::unique_ptr<Epoller> _epoller;
+    std::unique_ptr<HeapTimer> _timer;
+    std::unique_ptr<std::thread> _thread;
+    ConnTable<HttpConn> _users;
+    ThreadPool *_blockingPool;
+    std::unique_ptr<AsyncSql> _asyncSql;    // 使用本线程的 Epoller / HeapTimer, 在它们之前销毁
+
+    std::mutex _mtx;
+    std::vector<std::pair<int, sockaddr_in>> _pending; // 主 reactor 投递的新连接
+    std::vector<Task> _posted;                          // 阻塞执行器投递回来的完成回调
+};
+
+}
+
+#endif // __SUBREACTOR_H__
@@ -0,0 +1,182 @@
+/**
+ * @file upgrade.cpp
+ * @brief  平滑升级: 通过 Unix 域套接字 (SCM_RIGHTS) 把监听 fd 交给新进程
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "upgrade.h"
+
+extern char **environ;
+
+namespace wsv
+{
+
+const char *Upgrade::ENV_NAME = "WSV_UPGRADE_FD";
+
+// 返回子进程 pid, *channel 为等待就绪通知的一端
+pid_t Upgrade::spawn(const std::vector<int> &listenFds, int *channel) {
+    std::vector<std::string> args;
+    if (!_readCmdline(args)) {
+        LOG_ERROR("Upgrade: read /proc/self/cmdline error!");
+        return -1;
+    }
+    // 不含路径时 execve 无法搜索 PATH, 改用当前可执行文件
+    std::string path = args[0];
+    if (path.find('/') == std::string::npos) {
+        char buf[4096];
+        ssize_t len = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+        if (len <= 0) {
+            LOG_ERROR("Upgrade: readlink /proc/self/exe error!");
+            return -1;
+        }
+        path.assign(buf, len);
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        LOG_ERROR("Upgrade: socketpair error: %d", errno);
+        return -1;
+    }
+
+    // fork 之后子进程只能调用异步信号安全的函数, 参数与环境变量提前准备好
+    std::vector<char*> argv;
+    for (auto &arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    std::string envChannel = std::string(ENV_NAME) + "=" + std::to_string(sv[1]);
+    std::vector<char*> envp;
+    size_t nameLen = strlen(ENV_NAME);
+    for (char **env = environ; *env; env++)
+        if (strncmp(*env, ENV_NAME, nameLen) != 0 || (*env)[nameLen] != '=')
+            envp.push_back(*env);
+    envp.push_back(const_cast<char*>(envChannel.c_str()));
+    envp.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR("Upgrade: fork error: %d", errno);
+        ::close(sv[0]);
+        ::close(sv[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        fcntl(sv[1], F_SETFD, 0);   // 只让通道 fd 穿过 exec
+        execve(path.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+    ::close(sv[1]);
+    if (!_sendFds(sv[0], listenFds)) {
+        LOG_ERROR("Upgrade: send listen fd error: %d", errno);
+        ::close(sv[0]);
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return -1;
+    }
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL, 0) | O_NONBLOCK);
+    *channel = sv[0];
+    return pid;
+}
+
+// 不是由旧进程启动时返回 false
+bool Upgrade::inheritListenFds(std::vector<int> &listenFds, int *channel) {
+    *channel = -1;
+    const char *env = getenv(ENV_NAME);
+    if (!env)
+        return false;
+    int fd = atoi(env);
+    unsetenv(ENV_NAME);
+    if (fd <= 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+        return false;
+    if (!_recvFds(fd, listenFds)) {
+        ::close(fd);
+        return false;
+    }
+    *channel = fd;
+    return true;
+}
+
+void Upgrade::notifyReady(int channel) {
+    char ready = 'R';
+    if (send(channel, &ready, 1, MSG_NOSIGNAL) != 1)
+        LOG_WARN("Upgrade: notify ready error!");
+    ::close(channel);
+}
+
+// 对端关闭 (新进程初始化失败退出) 时返回 false
+bool Upgrade::waitReady(int channel) {
+    char ready = 0;
+    return recv(channel, &ready, 1, 0) == 1 && ready == 'R';
+}
+
+bool Upgrade::_sendFds(int channel, const std::vector<int> &fds) {
+    if (fds.empty() || fds.size() > static_cast<size_t>(MAX_FDS))
+        return false;
+    char data = 'F';
+    struct iovec iov = { &data, 1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    return sendmsg(channel, &msg, MSG_NOSIGNAL) == 1;
+}
+
+bool Upgrade::_recvFds(int channel, std::vector<int> &fds) {
+    char data;
+    struct iovec iov = { &data, 1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } ctrl;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+    if (recvmsg(channel, &msg, MSG_CMSG_CLOEXEC) != 1)
+        return false;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        return false;
+    size_t cnt = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    fds.resize(cnt);
+    memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * cnt);
+    return cnt > 0;
+}
+
+bool Upgrade::_readCmdline(std::vector<std::string> &args) {
+    int fd = open("/proc/self/cmdline", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    std::string data;
+    char buf[4096];
+    ssize_t len;
+    while ((len = ::read(fd, buf, sizeof(buf))) > 0)
+        data.append(buf, len);
+    ::close(fd);
+    // 参数以 '\0' 分隔
+    for (size_t pos = 0; pos < data.size(); ) {
+        size_t end = data.find('\0', pos);
+        if (end == std::string::npos)
+            end = data.size();
+        args.emplace_back(data, pos, end - pos);
+        pos = end + 1;
+    }
+    return !args.empty();
+}
+
+}
@@ -0,0 +1,51 @@
+/**
+ * @file upgrade.h
+ * @brief  平滑升级: 通过 Unix 域套接字 (SCM_RIGHTS) 把监听 fd 交给新进程
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __UPGRADE_H__
+#define __UPGRADE_H__
+
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "../log/log.h"
+
+namespace wsv
+{
+
+/*
+ * 旧进程: spawn() fork 并 exec 同一命令行, 通过环境变量告知子进程通道 fd,
+ *         随后把全部监听 fd 发过去, 等子进程回复就绪后开始排空连接.
+ * 新进程: inheritListenFds() 从通道取回监听 fd, 初始化完成后 notifyReady().
+ */
+class Upgrade
+{
+public:
+    static pid_t spawn(const std::vector<int> &listenFds, int *channel);
+    static bool inheritListenFds(std::vector<int> &listenFds, int *channel);
+    static void notifyReady(int channel);
+    static bool waitReady(int channel);
+
+    static const char *ENV_NAME;
+    static const int MAX_FDS = 64;  // SO_REUSEPORT 分片时有多个监听 fd
+
+private:
+    static bool _sendFds(int channel, const std::vector<int> &fds);
+    static bool _recvFds(int channel, std::vector<int> &fds);
+    static bool _readCmdline(std::vector<std::string> &args);
+};
+
+}
+
+#endif // __UPGRADE_H__
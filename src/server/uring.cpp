@@ -0,0 +1,295 @@
+/**
+ * @file uring.cpp
+ * @brief  io_uring 的最小封装 (直接使用系统调用, 不依赖 liburing)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "uring.h"
+
+namespace wsv
+{
+
+IoUring::IoUring(unsigned entries)
+    : _ringFd(-1), _features(0), _sqPtr(MAP_FAILED), _sqSize(0), _sqHead(nullptr), _sqTail(nullptr),
+    _sqMask(0), _sqEntries(0), _sqes(nullptr), _sqesSize(0), _sqeHead(0), _sqeTail(0),
+    _cqPtr(MAP_FAILED), _cqSize(0), _cqHead(nullptr), _cqTail(nullptr), _cqMask(0), _cqes(nullptr),
+    _bufRing(nullptr), _bufRingSize(0), _bufBase(nullptr), _bufCnt(0), _bufSize(0), _bufTail(0) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    _ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (_ringFd < 0)
+        return;
+    _features = params.features;
+
+    _sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (_features & IORING_FEAT_SINGLE_MMAP)
+        _sqSize = _cqSize = std::max(_sqSize, _cqSize);
+    _sqPtr = mmap(nullptr, _sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+    if (_sqPtr == MAP_FAILED)
+        goto fail;
+    if (_features & IORING_FEAT_SINGLE_MMAP) {
+        _cqPtr = _sqPtr;
+    } else {
+        _cqPtr = mmap(nullptr, _cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+        if (_cqPtr == MAP_FAILED)
+            goto fail;
+    }
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes = static_cast<io_uring_sqe*>(mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES));
+    if (_sqes == MAP_FAILED) {
+        _sqes = nullptr;
+        goto fail;
+    }
+
+    _sqHead = reinterpret_cast<unsigned*>(static_cast<char*>(_sqPtr) + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned*>(static_cast<char*>(_sqPtr) + params.sq_off.tail);
+    _sqMask = *reinterpret_cast<unsigned*>(static_cast<char*>(_sqPtr) + params.sq_off.ring_mask);
+    _sqEntries = *reinterpret_cast<unsigned*>(static_cast<char*>(_sqPtr) + params.sq_off.ring_entries);
+    {   // sqe 按顺序分配, 索引数组固定为恒等映射
+        unsigned *array = reinterpret_cast<unsigned*>(static_cast<char*>(_sqPtr) + params.sq_off.array);
+        for (unsigned i = 0; i < _sqEntries; i++)
+            array[i] = i;
+    }
+    _cqHead = reinterpret_cast<unsigned*>(static_cast<char*>(_cqPtr) + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned*>(static_cast<char*>(_cqPtr) + params.cq_off.tail);
+    _cqMask = *reinterpret_cast<unsigned*>(static_cast<char*>(_cqPtr) + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(_cqPtr) + params.cq_off.cqes);
+    _sqeHead = _sqeTail = *_sqTail;
+    return;
+
+fail:
+    ::close(_ringFd);
+    _ringFd = -1;
+}
+
+IoUring::~IoUring() {
+    if (_bufRing)
+        munmap(_bufRing, _bufRingSize);
+    delete[] _bufBase;
+    if (_sqes)
+        munmap(_sqes, _sqesSize);
+    if (_cqPtr != MAP_FAILED && _cqPtr != _sqPtr)
+        munmap(_cqPtr, _cqSize);
+    if (_sqPtr != MAP_FAILED)
+        munmap(_sqPtr, _sqSize);
+    if (_ringFd >= 0)
+        ::close(_ringFd);
+}
+
+// 需要 EXT_ARG (5.11+) 才能带超时等待
+bool IoUring::isValid() const { return _ringFd >= 0 && (_features & IORING_FEAT_EXT_ARG); }
+
+io_uring_sqe* IoUring::getSqe() {
+    unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if (_sqeTail - head >= _sqEntries)
+        return nullptr;
+    io_uring_sqe *sqe = &_sqes[_sqeTail & _sqMask];
+    ++_sqeTail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// 保证接下来的 n 个 sqe 不会被中途提交拆开 (链接请求需要在同一批提交)
+void IoUring::reserve(unsigned n) {
+    unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if (_sqEntries - (_sqeTail - head) < n)
+        submit();
+}
+
+io_uring_sqe* IoUring::_getSqeOrSubmit() {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        submit();
+        sqe = getSqe();
+    }
+    return sqe;
+}
+
+unsigned IoUring::_flush() {
+    unsigned toSubmit = _sqeTail - _sqeHead;
+    if (toSubmit) {
+        __atomic_store_n(_sqTail, _sqeTail, __ATOMIC_RELEASE);
+        _sqeHead = _sqeTail;
+    }
+    return toSubmit;
+}
+
+int IoUring::_enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize) {
+    int ret;
+    do {
+        ret = static_cast<int>(syscall(__NR_io_uring_enter, _ringFd, toSubmit, minComplete, flags, arg, argSize));
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+int IoUring::submit() {
+    unsigned toSubmit = _flush();
+    if (!toSubmit)
+        return 0;
+    return _enter(toSubmit, 0, 0, nullptr, 0);
+}
+
+int IoUring::submitAndWait(unsigned waitNr, int timeoutMs) {
+    unsigned toSubmit = _flush();
+    if (waitNr && peekCqe())
+        return toSubmit ? _enter(toSubmit, 0, 0, nullptr, 0) : 0;
+    if (timeoutMs < 0)
+        return _enter(toSubmit, waitNr, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+    __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    int ret = _enter(toSubmit, waitNr, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    return (ret < 0 && errno == ETIME) ? 0 : ret;
+}
+
+io_uring_cqe* IoUring::peekCqe() {
+    unsigned head = *_cqHead;
+    if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+        return nullptr;
+    return &_cqes[head & _cqMask];
+}
+
+void IoUring::cqeSeen() { __atomic_store_n(_cqHead, *_cqHead + 1, __ATOMIC_RELEASE); }
+
+bool IoUring::setupBufRing(unsigned short bgid, unsigned nbufs, unsigned bufSize) {
+    if (nbufs == 0 || (nbufs & (nbufs - 1)) || nbufs > 32768)
+        return false;
+    _bufRingSize = nbufs * sizeof(io_uring_buf);
+    void *ring = mmap(nullptr, _bufRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+    _bufRing = static_cast<io_uring_buf*>(ring);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(_bufRing);
+    reg.ring_entries = nbufs;
+    reg.bgid = bgid;
+    if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(_bufRing, _bufRingSize);
+        _bufRing = nullptr;
+        return false;
+    }
+    _bufCnt = nbufs;
+    _bufSize = bufSize;
+    _bufBase = new char[static_cast<size_t>(nbufs) * bufSize];
+    _bufTail = 0;
+    for (unsigned i = 0; i < nbufs; i++)
+        recycleBuffer(static_cast<unsigned short>(i));
+    return true;
+}
+
+char* IoUring::buffer(unsigned short bid) const { return _bufBase + static_cast<size_t>(bid) * _bufSize; }
+
+void IoUring::recycleBuffer(unsigned short bid) {
+    io_uring_buf *buf = &_bufRing[_bufTail & (_bufCnt - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(buffer(bid));
+    buf->len = _bufSize;
+    buf->bid = bid;
+    ++_bufTail;
+    // ring 的 tail 与第一个元素的 resv 字段重叠
+    __atomic_store_n(&_bufRing[0].resv, _bufTail, __ATOMIC_RELEASE);
+}
+
+/*
+ * provided buffer ring 与 EXT_ARG 在 5.19 已有, multishot recv 要到 6.0; 旧内核不认识该标志时
+ * 或返回 -EINVAL, 或当作普通 recv 完成一次. 在 socketpair 上收一个字节, 第一个完成事件带 F_MORE 才算支持,
+ * 之后关闭对端让请求以 EOF 结束, 收完探测的所有完成事件并归还缓冲区
+ */
+bool IoUring::probeRecvMultishot(unsigned short bgid) {
+    static const uint64_t PROBE_DATA = ~0ULL;
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0)
+        return false;
+    char byte = 0;
+    bool supported = false, first = true, done = ::write(sv[1], &byte, 1) != 1;
+    if (!done)
+        prepRecvMultishot(sv[0], bgid, PROBE_DATA);
+    while (!done) {
+        if (submitAndWait(1, 1000) < 0 || !peekCqe())
+            break;
+        io_uring_cqe *cqe;
+        while ((cqe = peekCqe())) {
+            if (cqe->user_data == PROBE_DATA) {
+                if (cqe->flags & IORING_CQE_F_BUFFER)
+                    recycleBuffer(static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+                if (first && cqe->res == 1 && (cqe->flags & IORING_CQE_F_MORE)) {
+                    supported = true;
+                    ::close(sv[1]);
+                    sv[1] = -1;
+                }
+                first = false;
+                done = !(cqe->flags & IORING_CQE_F_MORE);
+            }
+            cqeSeen();
+        }
+    }
+    ::close(sv[0]);
+    if (sv[1] >= 0)
+        ::close(sv[1]);
+    return supported && done;
+}
+
+void IoUring::prepAcceptMultishot(int fd, uint64_t userData) {
+    io_uring_sqe *sqe = _getSqeOrSubmit();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepRecvMultishot(int fd, unsigned short bgid, uint64_t userData) {
+    io_uring_sqe *sqe = _getSqeOrSubmit();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepSendMsg(int fd, const struct msghdr *msg, int msgFlags, uint64_t userData) {
+    io_uring_sqe *sqe = _getSqeOrSubmit();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = static_cast<uint32_t>(msgFlags);
+    sqe->user_data = userData;
+}
+
+void IoUring::prepRead(int fd, void *buf, size_t len, uint64_t userData) {
+    io_uring_sqe *sqe = _getSqeOrSubmit();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->user_data = userData;
+}
+
+void IoUring::prepCancel(uint64_t target, uint64_t userData) {
+    io_uring_sqe *sqe = _getSqeOrSubmit();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = userData;
+}
+
+void IoUring::prepPollOut(int fd, uint64_t userData) {
+    io_uring_sqe *sqe = _getSqeOrSubmit();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data = userData;
+}
+
+}
@@ -0,0 +1,96 @@
+/**
+ * @file uring.h
+ * @brief  io_uring 的最小封装 (直接使用系统调用, 不依赖 liburing)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+
+#include <unistd.h>
+#include <poll.h>           // POLLOUT
+#include <signal.h>         // _NSIG
+#include <sys/mman.h>
+#include <sys/socket.h>     // SOCK_NONBLOCK
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace wsv
+{
+
+class IoUring
+{
+public:
+    explicit IoUring(unsigned entries = 1024);
+    ~IoUring();
+
+    bool isValid() const;
+
+    io_uring_sqe* getSqe();
+    void reserve(unsigned n);
+    int submit();
+    int submitAndWait(unsigned waitNr, int timeoutMs = -1);
+
+    io_uring_cqe* peekCqe();
+    void cqeSeen();
+
+    // provided buffer ring: 内核从 bgid 组中挑选缓冲区接收数据
+    bool setupBufRing(unsigned short bgid, unsigned nbufs, unsigned bufSize);
+    char* buffer(unsigned short bid) const;
+    void recycleBuffer(unsigned short bid);
+    // 在 setupBufRing 之后、提交其他请求之前调用, 内核是否支持 multishot recv
+    bool probeRecvMultishot(unsigned short bgid);
+
+    void prepAcceptMultishot(int fd, uint64_t userData);
+    void prepRecvMultishot(int fd, unsigned short bgid, uint64_t userData);
+    void prepSendMsg(int fd, const struct msghdr *msg, int msgFlags, uint64_t userData);
+    void prepRead(int fd, void *buf, size_t len, uint64_t userData);
+    void prepCancel(uint64_t target, uint64_t userData);
+    void prepPollOut(int fd, uint64_t userData);
+
+private:
+    int _enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize);
+    unsigned _flush();
+    io_uring_sqe* _getSqeOrSubmit();
+
+private:
+    int _ringFd;
+    unsigned _features;
+
+    // SQ
+    void *_sqPtr;
+    size_t _sqSize;
+    unsigned *_sqHead;
+    unsigned *_sqTail;
+    unsigned _sqMask;
+    unsigned _sqEntries;
+    io_uring_sqe *_sqes;
+    size_t _sqesSize;
+    unsigned _sqeHead;      // 已提交给内核的位置
+    unsigned _sqeTail;      // 已分配的位置
+
+    // CQ
+    void *_cqPtr;
+    size_t _cqSize;
+    unsigned *_cqHead;
+    unsigned *_cqTail;
+    unsigned _cqMask;
+    io_uring_cqe *_cqes;
+
+    // provided buffers
+    io_uring_buf *_bufRing;     // 不用 io_uring_buf_ring: 其柔性数组在 C++ 中偏移不为 0
+    size_t _bufRingSize;
+    char *_bufBase;
+    unsigned _bufCnt;
+    unsigned _bufSize;
+    unsigned short _bufTail;
+};
+
+}
+
+#endif // __URING_H__
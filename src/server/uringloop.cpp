@@ -0,0 +1,368 @@
+/**
+ * @file uringloop.cpp
+ * @brief  基于 io_uring 完成事件的事件循环
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#include "uringloop.h"
+
+namespace wsv
+{
+
+UringLoop::UringLoop(int id, int listenFd, int timeoutMS, int maxFd, int cpu)
+    : _id(id), _listenFd(listenFd), _timeoutMS(timeoutMS), _maxFd(maxFd), _cpu(cpu),
+    _wakeFd(eventfd(0, EFD_CLOEXEC)), _wakeBuf(0), _isClosed(true), _isDraining(false), _drained(false),
+    _ring(std::make_unique<IoUring>()), _timer(std::make_unique<HeapTimer>()), _conns(maxFd), _blockingPool(nullptr) { }
+
+UringLoop::~UringLoop() {
+    stop();
+    if (_wakeFd >= 0)
+        ::close(_wakeFd);
+}
+
+bool UringLoop::init() {
+    if (_wakeFd < 0 || !_ring->isValid()) {
+        LOG_WARN("UringLoop[%d] io_uring unavailable", _id);
+        return false;
+    }
+    if (!_ring->setupBufRing(BUF_GROUP, BUF_COUNT, BUF_SIZE)) {
+        LOG_WARN("UringLoop[%d] provided buffer ring unsupported", _id);
+        return false;
+    }
+    if (!_ring->probeRecvMultishot(BUF_GROUP)) {
+        LOG_WARN("UringLoop[%d] multishot recv unsupported", _id);
+        return false;
+    }
+    return true;
+}
+
+// 在 start() 之前调用; 执行器由 WebServer 持有, 先于事件循环销毁
+void UringLoop::setBlockingPool(ThreadPool *pool) { _blockingPool = pool; }
+
+void UringLoop::start() {
+    if (_thread) return;
+    _isClosed = false;
+    _thread = std::make_unique<std::thread>(&UringLoop::loop, this);
+}
+
+void UringLoop::stop() {
+    _isClosed = true;
+    uint64_t one = 1;
+    if (_wakeFd >= 0 && ::write(_wakeFd, &one, sizeof(one)) != sizeof(one))
+        LOG_WARN("UringLoop[%d] wakeup error!", _id);
+    if (_thread && _thread->joinable())
+        _thread->join();
+    _thread.reset();
+}
+
+void UringLoop::drain() {
+    _isDraining = true;
+    uint64_t one = 1;
+    if (_wakeFd >= 0 && ::write(_wakeFd, &one, sizeof(one)) != sizeof(one))
+        LOG_WARN("UringLoop[%d] wakeup error!", _id);
+}
+
+void UringLoop::loop() {
+    if (_cpu >= 0 && !CpuAffinity::pin(_cpu))
+        LOG_WARN("UringLoop[%d] pin to cpu %d error!", _id, _cpu);
+    _armAccept();
+    _armWake();
+    LOG_INFO("UringLoop[%d] start, cpu: %d, node: %d", _id, _cpu, _cpu >= 0 ? CpuAffinity::numaNode(_cpu) : -1);
+    while (!_isClosed) {
+        int timeMS = -1;
+        if (_timeoutMS > 0)
+            timeMS = _timer->getNextTick();
+        if (_ring->submitAndWait(1, timeMS) < 0 && errno != EBUSY && errno != EAGAIN) {
+            LOG_ERROR("UringLoop[%d] io_uring_enter error: %d", _id, errno);
+            break;
+        }
+        // 先拷贝再归还 cqe, 处理过程中可能继续提交新的 sqe
+        io_uring_cqe *cqe;
+        while ((cqe = _ring->peekCqe())) {
+            uint64_t userData = cqe->user_data;
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            _ring->cqeSeen();
+            _handleCqe(userData, res, flags);
+        }
+    }
+    LOG_INFO("UringLoop[%d] quit", _id);
+}
+
+uint64_t UringLoop::_pack(OP_TYPE op, int fd) {
+    return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(fd);
+}
+
+void UringLoop::_handleCqe(uint64_t userData, int res, uint32_t flags) {
+    int fd = static_cast<int>(userData & 0xffffffff);
+    switch (static_cast<OP_TYPE>(userData >> 32)) {
+        case OP_ACCEPT:
+            _onAccept(res, flags);
+            break;
+        case OP_RECV:
+            _onRecv(fd, res, flags);
+            break;
+        case OP_SEND:
+            _onSend(fd, res);
+            break;
+        case OP_WAKE:
+            _runPosted();
+            if (_isDraining && !_drained) _onDrain();
+            if (!_isClosed) _armWake();
+            break;
+        case OP_POLLOUT:
+            _onPollOut(fd, res);
+            break;
+        case OP_CANCEL:
+            break;
+        default:
+            LOG_ERROR("UringLoop[%d] unexpected cqe", _id);
+            break;
+    }
+}
+
+void UringLoop::_armAccept() { _ring->prepAcceptMultishot(_listenFd, _pack(OP_ACCEPT, _listenFd)); }
+
+void UringLoop::_armWake() { _ring->prepRead(_wakeFd, &_wakeBuf, sizeof(_wakeBuf), _pack(OP_WAKE, _wakeFd)); }
+
+// 停止 accept (内核持有监听 fd 的引用, 必须取消 multishot accept), 关闭空闲连接;
+// 已收到部分请求的连接继续接收, 应答后关闭
+void UringLoop::_onDrain() {
+    _drained = true;
+    _ring->prepCancel(_pack(OP_ACCEPT, _listenFd), _pack(OP_CANCEL, _listenFd));
+    _conns.forEach([this](int fd, Conn &conn) {
+        if (!conn.closing && conn.sends == 0 && conn.http.isIdle())
+            _closeConn(fd);
+    });
+}
+
+void UringLoop::_armRecv(Conn &conn, int fd) {
+    _ring->prepRecvMultishot(fd, BUF_GROUP, _pack(OP_RECV, fd));
+    ++conn.inflight;
+}
+
+void UringLoop::_onAccept(int res, uint32_t flags) {
+    // 用 _isDraining 而不是 _drained: drain() 之后主线程随即关闭监听 fd, fd 号可能已被复用
+    if (!(flags & IORING_CQE_F_MORE) && !_isClosed && !_isDraining)
+        _armAccept();
+    if (res == -ECANCELED)
+        return;
+    if (res < 0) {
+        LOG_WARN("UringLoop[%d] accept error: %d", _id, -res);
+        return;
+    }
+    if (HttpConn::userCount >= _maxFd || res >= _maxFd) {
+        const char *info = HttpResponse::BUSY_RESPONSE;
+        if (send(res, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+            LOG_WARN("send error to client[%d] error!", res);
+        ::close(res);
+        LOG_WARN("Clients is full!");
+        return;
+    }
+    _addClient(res);
+}
+
+void UringLoop::_addClient(int fd) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &len);
+
+    Conn &conn = *_conns.acquire(fd);
+    conn.inflight = conn.sends = 0;
+    conn.closing = false;
+    conn.http.init(fd, addr);
+    if (_timeoutMS > 0)
+        _timer->add(fd, _timeoutMS, std::bind(&UringLoop::_onTimeout, this, fd, _conns.generation(fd)));
+    _armRecv(conn, fd);
+    LOG_INFO("UringLoop[%d] Client[%d] in!", _id, fd);
+}
+
+void UringLoop::_onRecv(int fd, int res, uint32_t flags) {
+    Conn &conn = *_conns.get(fd);
+    if (flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0 && !conn.closing)
+            conn.http.appendRead(_ring->buffer(bid), static_cast<size_t>(res));
+        _ring->recycleBuffer(bid);
+    }
+    bool more = flags & IORING_CQE_F_MORE;
+    if (!more)
+        --conn.inflight;
+    if (conn.closing) {
+        if (conn.inflight == 0)
+            conn.http.close();
+        return;
+    }
+    if (res == -ENOBUFS) {
+        // 缓冲区在本轮已全部归还, 重新挂上即可
+        _armRecv(conn, fd);
+        return;
+    }
+    if (res <= 0) {
+        _closeConn(fd);
+        return;
+    }
+    if (!more)
+        _armRecv(conn, fd);
+    _extentTime(fd);
+    // 上一个响应未发完前不解析后续请求, 保证顺序且不覆盖写缓冲区
+    if (conn.sends == 0)
+        _onProcess(conn, fd);
+}
+
+void UringLoop::_onProcess(Conn &conn, int fd) {
+    if (conn.http.process())
+        _send(conn, fd);
+    else if (conn.http.isVerifying())
+        _dispatchVerify(conn, fd);
+}
+
+void UringLoop::_dispatchVerify(Conn &conn, int fd) {
+    auto cred = std::make_unique<HttpRequest::Credential>();
+    if (!conn.http.takeVerify(cred.get()))
+        return;
+    uint32_t gen = _conns.generation(fd);
+    bool added = _blockingPool->tryAddTask([this, fd, gen, cred = std::move(cred)] {
+        bool ok = HttpRequest::UserVerify(cred->name, cred->pwd, cred->isLogin);
+        _post([this, fd, gen, ok] {
+            if (!_conns.isCurrent(fd, gen))
+                return;
+            Conn &cur = *_conns.get(fd);
+            if (cur.closing)
+                return;
+            cur.http.onVerified(ok);
+            _onProcess(cur, fd);
+        });
+    });
+    if (!added) {
+        // 交出前本轮没有其他响应, 也没有在途的 send, 直接回 503 并关闭
+        LOG_WARN("UringLoop[%d] blocking executor queue is full!", _id);
+        const char *info = HttpResponse::BUSY_RESPONSE;
+        if (send(fd, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+            LOG_WARN("send error to client[%d] error!", fd);
+        _closeConn(fd);
+    }
+}
+
+void UringLoop::_post(Task &&task) {
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _posted.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    if (::write(_wakeFd, &one, sizeof(one)) != sizeof(one))
+        LOG_WARN("UringLoop[%d] wakeup error!", _id);
+}
+
+void UringLoop::_runPosted() {
+    std::vector<Task> posted;
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        posted.swap(_posted);
+    }
+    for (auto &task : posted)
+        task();
+}
+
+void UringLoop::_send(Conn &conn, int fd) {
+    if (conn.http.iovCnt() == 0) {
+        _sendFile(conn, fd);
+        return;
+    }
+    // 本轮所有流水线响应一次 SENDMSG 发出; 后面还有 sendfile 时带 MSG_MORE 与文件合并成段
+    memset(&conn.msg, 0, sizeof(conn.msg));
+    conn.msg.msg_iov = const_cast<struct iovec*>(conn.http.iov());
+    conn.msg.msg_iovlen = conn.http.iovCnt();
+    int msgFlags = MSG_NOSIGNAL | MSG_WAITALL | (conn.http.fileRemain() > 0 ? MSG_MORE : 0);
+    _ring->prepSendMsg(fd, &conn.msg, msgFlags, _pack(OP_SEND, fd));
+    ++conn.inflight;
+    ++conn.sends;
+}
+
+void UringLoop::_onSend(int fd, int res) {
+    Conn &conn = *_conns.get(fd);
+    --conn.inflight;
+    --conn.sends;
+    if (conn.closing) {
+        if (conn.inflight == 0)
+            conn.http.close();
+        return;
+    }
+    if (res > 0) {
+        conn.http.hasWritten(static_cast<size_t>(res));
+    } else if (res != -ECANCELED) {
+        _closeConn(fd);
+        return;
+    }
+    if (conn.sends > 0)
+        return;
+    if (conn.http.toWriteBytes() > 0) {
+        // 发送不完整或还有 sendfile 的部分, 从当前位置继续
+        _send(conn, fd);
+        return;
+    }
+    _onSendDone(conn, fd);
+}
+
+// io_uring 没有 sendfile 操作: 数据在页缓存中时非阻塞 sendfile 不会睡眠, 直接在本线程发送
+void UringLoop::_sendFile(Conn &conn, int fd) {
+    int err = 0;
+    while (conn.http.fileRemain() > 0 && conn.http.sendFile(&err) > 0) { }
+    if (conn.http.fileRemain() == 0) {
+        _onSendDone(conn, fd);
+    } else if (err == EAGAIN) {
+        _ring->prepPollOut(fd, _pack(OP_POLLOUT, fd));
+        ++conn.inflight;
+        ++conn.sends;
+    } else {
+        _closeConn(fd);
+    }
+}
+
+void UringLoop::_onPollOut(int fd, int res) {
+    Conn &conn = *_conns.get(fd);
+    --conn.inflight;
+    --conn.sends;
+    if (conn.closing) {
+        if (conn.inflight == 0)
+            conn.http.close();
+        return;
+    }
+    if (res < 0 && res != -ECANCELED) {
+        _closeConn(fd);
+        return;
+    }
+    _sendFile(conn, fd);
+}
+
+void UringLoop::_onSendDone(Conn &conn, int fd) {
+    if (!conn.http.isKeepAlive()) {
+        _closeConn(fd);
+        return;
+    }
+    _extentTime(fd);
+    _onProcess(conn, fd);
+}
+
+void UringLoop::_extentTime(int fd) {
+    if (_timeoutMS > 0) { _timer->adjust(fd, _timeoutMS); }
+}
+
+void UringLoop::_onTimeout(int fd, uint32_t gen) {
+    if (_conns.isCurrent(fd, gen)) _closeConn(fd);
+}
+
+void UringLoop::_closeConn(int fd) {
+    Conn &conn = *_conns.get(fd);
+    if (conn.closing)
+        return;
+    LOG_INFO("UringLoop[%d] Client[%d] quit!", _id, fd);
+    conn.closing = true;
+    // 唤醒在途的 recv/send, 全部完成后才关闭 fd, 避免 fd 被复用后收到旧的完成事件
+    shutdown(fd, SHUT_RDWR);
+    if (conn.inflight == 0)
+        conn.http.close();
+}
+
+}
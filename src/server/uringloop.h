@@ -0,0 +1,120 @@
+/**
+ * @file uringloop.h
+ * @brief  基于 io_uring 完成事件的事件循环
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __URINGLOOP_H__
+#define __URINGLOOP_H__
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <sys/eventfd.h>    // eventfd()
+
+#include "uring.h"
+#include "conntable.hpp"
+#include "../pool/cpuaffinity.h"
+#include "../pool/threadpool.h"
+#include "../log/log.h"
+#include "../http/httpconn.h"
+#include "../timer/heaptimer.h"
+
+namespace wsv
+{
+
+/*
+ * 与 Epoller 的就绪通知不同, 这里直接向内核提交 I/O 并处理完成事件:
+ * multishot accept 接收新连接, multishot recv 从 provided buffer ring 取数据,
+ * 响应头与文件通过链接的 send 一次提交; 走 sendfile 的大文件在头部发完后由本线程
+ * 非阻塞 sendfile, 套接字写满时挂 POLL_ADD 等待可写. 每轮循环只需一次 io_uring_enter.
+ * 多个 UringLoop 可以同时在同一个监听 fd 上 accept, 由内核分配连接;
+ * 开启 SO_REUSEPORT 分片时每个 UringLoop 各有一个监听 fd.
+ * 登录/注册请求交给阻塞执行器, 完成回调经 eventfd 投递回本线程.
+ */
+class UringLoop
+{
+public:
+    UringLoop(int id, int listenFd, int timeoutMS, int maxFd, int cpu = -1);
+    ~UringLoop();
+
+    bool init();
+    void setBlockingPool(ThreadPool *pool);
+    void loop();
+    void start();
+    void stop();
+    void drain();
+
+private:
+    enum OP_TYPE {
+        OP_ACCEPT = 1,
+        OP_RECV,
+        OP_SEND,
+        OP_WAKE,
+        OP_CANCEL,
+        OP_POLLOUT,
+    };
+    struct Conn
+    {
+        HttpConn http;
+        int inflight = 0;       // 尚未完成的 sqe 数, 为 0 时才能真正 close(fd)
+        int sends = 0;          // 尚未完成的 send (含等待可写的 poll) 数
+        bool closing = false;
+        struct msghdr msg;      // SENDMSG 在完成前由内核读取, 需与连接同生命周期
+    };
+
+    void _handleCqe(uint64_t userData, int res, uint32_t flags);
+    void _onAccept(int res, uint32_t flags);
+    void _onRecv(int fd, int res, uint32_t flags);
+    void _onSend(int fd, int res);
+    void _onPollOut(int fd, int res);
+
+    void _armAccept();
+    void _armWake();
+    void _onDrain();
+    void _armRecv(Conn &conn, int fd);
+    void _addClient(int fd);
+    void _onProcess(Conn &conn, int fd);
+    void _send(Conn &conn, int fd);
+    void _sendFile(Conn &conn, int fd);
+    void _onSendDone(Conn &conn, int fd);
+    void _dispatchVerify(Conn &conn, int fd);
+    void _post(Task &&task);
+    void _runPosted();
+    void _extentTime(int fd);
+    void _closeConn(int fd);
+    void _onTimeout(int fd, uint32_t gen);
+
+    static uint64_t _pack(OP_TYPE op, int fd);
+
+private:
+    static const unsigned short BUF_GROUP = 0;
+    static const unsigned BUF_COUNT = 1024;
+    static const unsigned BUF_SIZE = 4096;
+
+    int _id;
+    int _listenFd;
+    int _timeoutMS;
+    int _maxFd;
+    int _cpu;
+    int _wakeFd;
+    uint64_t _wakeBuf;
+    std::atomic<bool> _isClosed;
+    std::atomic<bool> _isDraining;
+    bool _drained;
+    std::unique_ptr<IoUring> _ring;
+    std::unique_ptr<HeapTimer> _timer;
+    std::unique_ptr<std::thread> _thread;
+    ConnTable<Conn> _conns;
+    ThreadPool *_blockingPool;
+
+    std::mutex _mtx;
+    std::vector<Task> _posted;      // 阻塞执行器投递回来的完成回调
+};
+
+}
+
+#endif // __URINGLOOP_H__
@@ -9,22 +9,100 @@
 namespace wsv
 {
 
+static int signalPipe = -1;
+
+// 信号处理函数中只写管道, 由主循环处理
+static void onSignal(int sig) {
+    int saveErrno = errno;
+    char c = static_cast<char>(sig);
+    if(write(signalPipe, &c, 1) < 0) { }
+    errno = saveErrno;
+}
+
 WebServer::WebServer(int port, int trigMode, int timeoutMS, bool optLinger, int sqlPort, const char *sqlUser, const char *sqlPwd,
-        const char *dbName, int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueueSize)
-    : _openLinger(optLinger), _isClosed(false), _port(port), _timeoutMS(timeoutMS),
-    _srcDir(getcwd(nullptr, 256)),
+        const char *dbName, int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueueSize,
+        const ServerOptions &options)
+    : _openLinger(optLinger), _isClosed(false), _acceptPending(false), _isDraining(false), _port(port), _listenFd(-1),
+    _timeoutMS(timeoutMS), _signalFd(-1), _upgradeFd(-1), _notifyFd(-1), _readyFd(-1), _wakeFd(-1), _upgradePid(-1),
+    _srcDir(getcwd(nullptr, 256)), _nextReactor(0), _options(options),
     _timer(std::make_unique<HeapTimer>()),
-    _threadPool(std::make_unique<ThreadPool>(threadNum)),
-    _epoller(std::make_unique<Epoller>()) {
+    _threadPool(options.reactorNum > 0 || options.ioBackend == ServerOptions::IO_URING ? nullptr : std::make_unique<ThreadPool>(threadNum, options.cpuList, options.maxQueue)),
+    _queueFullCount(0), _sqlCheckouts(0), _userLookups(0), _userChecks(0), _commitBatches(0), _epoller(std::make_unique<Epoller>()), _users(options.maxConn),
+    _parked(std::make_unique<std::atomic<bool>[]>(options.maxConn)) {
     if (!_srcDir)
         exit(EXIT_FAILURE);
     strncat(_srcDir, "/resources/", 16);
     HttpConn::userCount = 0;
+    HttpConn::isDraining = false;
     HttpConn::srcDir = _srcDir;
-    SqlConnPool::Instance()->init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    HttpConn::pipelineMax = std::max(1, std::min(_options.pipelineDepth, (IOV_MAX - 1) / 3)); // 每个响应头至多跨两块, 另加文件
+    HttpResponse::sendfileMin = _options.sendfileMin;
+    rlim_t fdLimit = _raiseFdLimit();
+    FdCache::Instance()->setCapacity(_options.fdCacheSize);
+    SqlPoolOptions sqlOptions;
+    sqlOptions.minConn = _options.sqlConnMin;
+    sqlOptions.checkoutTimeoutMS = _options.sqlCheckoutTimeoutMS;
+    sqlOptions.pingIntervalMS = _options.sqlPingIntervalMS;
+    sqlOptions.idleTimeoutMS = _options.sqlIdleTimeoutMS;
+    SqlConnPool::Instance()->init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum, sqlOptions);
+    UserCache::Instance()->init(_options.userCacheTTLMS, _options.userCacheSize);
+    GroupCommit::Instance()->init(_options.registerBatchRows, _options.registerBatchWaitUs);
+    UserFilter::LOAD_RESULT filterResult = UserFilter::LOAD_ERROR;
+    double filterLoadMS = 0;
+    if(_options.userFilter) {
+        auto start = std::chrono::steady_clock::now();
+        MYSQL *sql;
+        SqlConnRAII scr(&sql, SqlConnPool::Instance());
+        filterResult = UserFilter::Instance()->load(sql);
+        filterLoadMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    // 线程数超过数据库连接数时多出的线程只会等连接, 默认两者相同
+    int blockingNum = _options.blockingThreadNum > 0 ? _options.blockingThreadNum : std::max(connPoolNum, 1);
+    // 有上限: 限流的许可在查询开始前就已归还, 数据库变慢时登录/注册在这里排队
+    _blockingPool = std::make_unique<ThreadPool>(blockingNum, std::vector<int>(), std::max(_options.blockingMaxQueue, 0));
 
     _initEventMode(trigMode);
     if(!_initSocket()) _isClosed = true;
+    if(!_isClosed && !_initSignal()) _isClosed = true;
+    if(!_isClosed && options.fileCacheBytes > 0) {
+        // 走 sendfile 的文件不进内存缓存
+        size_t maxFile = options.sendfileMin > 0 ? std::min(options.fileCacheMaxFile, options.sendfileMin - 1) : options.fileCacheMaxFile;
+        if(FileCache::Instance()->init(_srcDir, options.fileCacheBytes, maxFile)) {
+            _notifyFd = FileCache::Instance()->notifyFd();
+            _epoller->addFd(_notifyFd, EPOLLIN);
+        }
+    }
+    if(!_isClosed && options.ioBackend == ServerOptions::IO_URING && !_initUring(std::max(options.reactorNum, 1))) {
+        _uringLoops.clear();
+        LOG_WARN("io_uring init failed, fall back to epoll");
+        if(options.reactorNum <= 0) _threadPool = std::make_unique<ThreadPool>(threadNum, options.cpuList, options.maxQueue);
+    }
+    if(!_isClosed && _threadPool) {
+        _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(_wakeFd < 0 || !_epoller->addFd(_wakeFd, EPOLLIN)) _isClosed = true;
+    }
+    if(_threadPool && options.adaptiveLimit) {
+        // 下限为线程数的两倍: 工作线程都被落库请求占住时, 静态文件请求仍有排队的份额
+        _limiter = std::make_unique<AdaptiveLimiter>(threadNum * 4, threadNum * 2, options.concurrencyLimitMax, options.queueWaitTargetUs, 0.5);
+    }
+    for(int i = 0; _uringLoops.empty() && i < options.reactorNum; i++) {
+        _reactors.emplace_back(std::make_unique<SubReactor>(i, _timeoutMS, _connEvent, _options.maxConn, _cpuOf(i)));
+        if(_listenFd < 0 && static_cast<size_t>(i) < _listenFds.size())
+            _reactors.back()->listen(_listenFds[i], _options.acceptBudget);
+        _reactors.back()->setBlockingPool(_blockingPool.get());
+    }
+    bool asyncSql = false;
+    if(!_isClosed && options.asyncSqlConn > 0 && _uringLoops.empty()) {
+        // 子 reactor 各自驱动自己的连接; 线程池模式由主循环驱动, 完成后再交给线程池
+        asyncSql = true;
+        for(auto &reactor : _reactors)
+            asyncSql = reactor->initAsyncSql(sqlPort, sqlUser, sqlPwd, dbName, options.asyncSqlConn, options.sqlCheckoutTimeoutMS) && asyncSql;
+        if(_reactors.empty()) {
+            _asyncSql = std::make_unique<AsyncSql>(_epoller.get(), _timer.get());
+            asyncSql = _asyncSql->init("localhost", sqlPort, sqlUser, sqlPwd, dbName, options.asyncSqlConn, options.sqlCheckoutTimeoutMS);
+            if(!asyncSql) _asyncSql.reset();
+        }
+    }
 
     if(openLog) {
         Log::Instance()->init(logLevel, "./log", ".log", logQueueSize);
@@ -33,55 +111,201 @@ WebServer::WebServer(int port, int trigMode, int timeoutMS, bool optLinger, int
             LOG_INFO("========== Server init ==========");
             LOG_INFO("Port:%d, OpenLinger: %s", _port, optLinger? "true":"false");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s", (_listenEvent & EPOLLET ? "ET": "LT"), (_connEvent & EPOLLET ? "ET": "LT"));
+            LOG_INFO("Backlog: %d, DeferAccept: %ds, AcceptBudget: %d", _options.backlog, _options.deferAcceptSec, _options.acceptBudget);
+            LOG_INFO("ReusePort: %s, CpuSteering: %s, Pinned CPU num: %d", _listenFds.size() > 1 ? "true" : "false",
+                    _listenFds.size() > 1 && _options.cpuSteering ? "true" : "false", (int)_options.cpuList.size());
+            if(_limiter) { LOG_INFO("AdaptiveLimit: %d~%d, QueueWaitTarget: %dus, MaxQueue: %d", threadNum * 2, options.concurrencyLimitMax, options.queueWaitTargetUs, options.maxQueue); }
+            else if(options.adaptiveLimit) { LOG_WARN("AdaptiveLimit only works with ThreadPool, ignored"); }
             LOG_INFO("LogSys level: %d", logLevel);
+            LOG_INFO("IO backend: %s", _uringLoops.empty() ? "epoll" : "io_uring");
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("Pipeline depth: %d", HttpConn::pipelineMax);
+            LOG_INFO("Max conn: %d, fd limit: %lu", _options.maxConn, (unsigned long)fdLimit);
+            if(fdLimit < static_cast<rlim_t>(_options.maxConn) + RESERVED_FD) { LOG_WARN("RLIMIT_NOFILE is below max conn, accept will fail first"); }
+            if(_notifyFd >= 0) { LOG_INFO("FileCache: %zu bytes, max file %zu bytes", _options.fileCacheBytes, _options.fileCacheMaxFile); }
+            if(_options.sendfileMin > 0) { LOG_INFO("Sendfile min: %zu bytes, FdCache size: %d", _options.sendfileMin, _options.fdCacheSize); }
+            if(!_uringLoops.empty()) { LOG_INFO("SqlConnPool num: %d, UringLoop num: %d", connPoolNum, (int)_uringLoops.size()); }
+            else if(_reactors.empty()) { LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum); }
+            else { LOG_INFO("SqlConnPool num: %d, SubReactor num: %d", connPoolNum, (int)_reactors.size()); }
+            LOG_INFO("Blocking executor num: %d, max queue: %d", blockingNum, _options.blockingMaxQueue);
+            LOG_INFO("SqlConnPool min: %d, checkout timeout: %dms, ping interval: %dms, idle timeout: %dms",
+                    _options.sqlConnMin > 0 ? std::min(_options.sqlConnMin, connPoolNum) : connPoolNum,
+                    _options.sqlCheckoutTimeoutMS, _options.sqlPingIntervalMS, _options.sqlIdleTimeoutMS);
+            if(filterResult == UserFilter::LOADED) { LOG_INFO("UserFilter: %zu users, %zu KB, loaded in %.1fms", UserFilter::Instance()->count(), UserFilter::Instance()->bytes() / 1024, filterLoadMS); }
+            else if(_options.userFilter && filterResult == UserFilter::NO_UNIQUE_KEY) { LOG_WARN("UserFilter needs a unique key on user.username, disabled"); }
+            else if(_options.userFilter) { LOG_WARN("UserFilter load failed, disabled"); }
+            if(GroupCommit::Instance()->isEnabled()) { LOG_INFO("Register batch: %d rows, wait %dus", _options.registerBatchRows, _options.registerBatchWaitUs); }
+            if(UserCache::Instance()->isEnabled()) { LOG_INFO("UserCache ttl: %dms, size: %zu", _options.userCacheTTLMS, _options.userCacheSize); }
+            if(asyncSql) { LOG_INFO("Async sql conn: %d per loop", options.asyncSqlConn); }
+            else if(options.asyncSqlConn > 0) { LOG_WARN("Async sql needs MariaDB client library and epoll, use blocking executor"); }
         }
     }
 }
 WebServer::~WebServer() {
-    close(_listenFd);
+    // 等工作线程执行完剩余任务并退出, 任务仍会访问连接表等成员.
+    // 线程池的任务会提交给阻塞执行器, 阻塞执行器的回调投递到主循环或事件循环, 按此顺序停止
+    _threadPool.reset();
+    _blockingPool.reset();
     _isClosed = true;
+    // 事件循环停止后再关闭监听套接字, 分片的监听套接字由子 reactor 析构时关闭
+    bool reactorOwned = _listenFd < 0 && !_reactors.empty();
+    _reactors.clear(); // 先停止子 reactor, 再关闭数据库连接池
+    _uringLoops.clear();
+    if(!reactorOwned)
+        for(int fd : _listenFds) close(fd);
+    if(_signalFd >= 0) {
+        signal(SIGUSR2, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        close(_signalFd);
+        close(signalPipe);
+        signalPipe = -1;
+    }
+    if(_upgradeFd >= 0) close(_upgradeFd);
+    if(_readyFd >= 0) close(_readyFd);
+    if(_wakeFd >= 0) close(_wakeFd);
     free(_srcDir);
+    GroupCommit::Instance()->close();
     SqlConnPool::Instance()->closePool();
 }
 
 void WebServer::start() {
     int timeMS = -1; // epoll wait timeout == -1 无事件将阻塞
     if(!_isClosed) { LOG_INFO("========== Server start =========="); }
+    // io_uring: 事件循环各占一个线程, 主线程只处理信号与升级
+    for(auto &loop : _uringLoops)
+        loop->start();
+    for(auto &reactor : _reactors)
+        reactor->start();
+    if(_readyFd >= 0) {
+        // 由旧进程启动: 已可以接收连接, 通知旧进程开始排空
+        if(!_isClosed) Upgrade::notifyReady(_readyFd);
+        else close(_readyFd);
+        _readyFd = -1;
+    }
     while(!_isClosed) {
-        if (_timeoutMS > 0)
+        if (_timeoutMS > 0 || _asyncSql)
             timeMS = _timer->getNextTick();
+        if(_acceptPending)
+            timeMS = 0; // 上一轮 accept 预算用完, 监听队列中还有连接
+        if(_isDraining && (timeMS < 0 || timeMS > 100))
+            timeMS = 100; // 排空期间定期检查剩余连接数
+        if(timeMS < 0 || timeMS > REPORT_INTERVAL_MS)
+            timeMS = REPORT_INTERVAL_MS;
         int eventCnt = _epoller->wait(timeMS);
+        bool acceptReady = _acceptPending;
         for(int i = 0; i < eventCnt; i++) {
             // 处理事件
             int fd = _epoller->getEventFd(i);
             uint32_t events = _epoller->getEvents(i);
             if(fd == _listenFd) {
-                _dealListen();
+                acceptReady = true;
+            } else if(fd == _signalFd) {
+                _dealSignal();
+            } else if(fd == _upgradeFd) {
+                _dealUpgrade();
+            } else if(fd == _notifyFd) {
+                FileCache::Instance()->dealNotify();
+            } else if(fd == _wakeFd) {
+                _runPosted();
+            } else if(_asyncSql && _asyncSql->handleEvent(fd, events)) {
+                continue;
+            } else if(_isDraining && (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) == EPOLLRDHUP && _users.get(fd)->toWriteBytes() > 0) {
+                // 排空时本端关闭了读方向, 响应还没写完: 只等待可写
+                _epoller->modFd(fd, (_connEvent & ~EPOLLRDHUP) | EPOLLOUT);
             } else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(_users.count(fd) > 0);
-                _closeConn(&_users[fd]);
+                _closeConn(_users.get(fd));
             } else if(events & EPOLLIN) {
-                assert(_users.count(fd) > 0);
-                _dealRead(&_users[fd]);
+                _dealRead(_users.get(fd));
             } else if(events & EPOLLOUT) {
-                assert(_users.count(fd) > 0);
-                _dealWrite(&_users[fd]);
+                _dealWrite(_users.get(fd));
             } else {
                 LOG_ERROR("Unexpected event");
             }
         }
+        // 已有连接的事件先处理, 再 accept 新连接
+        if(acceptReady && !_isDraining) _dealListen();
+        _reportOverload();
+        if(_isDraining && (HttpConn::userCount <= 0 || std::chrono::steady_clock::now() >= _drainDeadline)) {
+            LOG_INFO("========== Server drained, %d connections left ==========", (int)HttpConn::userCount);
+            _isClosed = true;
+        }
+    }
+}
+
+// 由旧进程 exec 启动时直接使用传递过来的监听 fd
+bool WebServer::_inheritSocket() {
+    if(!Upgrade::inheritListenFds(_listenFds, &_readyFd))
+        return false;
+    for(int fd : _listenFds) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if(getsockname(fd, (struct sockaddr *)&addr, &len) < 0 || ntohs(addr.sin_port) != _port) {
+            LOG_ERROR("Inherited listen fd is not port:%d!", _port);
+            for(int lfd : _listenFds) close(lfd);
+            _listenFds.clear();
+            close(_readyFd);
+            _readyFd = -1;
+            return false;
+        }
     }
+    LOG_INFO("Inherit %d listen fd from old process", (int)_listenFds.size());
+    return true;
 }
 
 bool WebServer::_initSocket() {
-    int ret;
-    struct sockaddr_in addr;
     if(_port > 65535 || _port < 1024) {
         LOG_ERROR("Port:%d error!",  _port);
         return false;
     }
+    // SO_REUSEPORT 分片: 每个子 reactor / io_uring 事件循环各自 accept 一个监听套接字
+    size_t shards = _options.reusePort && _options.reactorNum > 0 ? _options.reactorNum : 1;
+    _inheritSocket();
+    while(_listenFds.size() > shards) {
+        // 旧进程分片更多, 多出的监听队列中尚未 accept 的连接会被重置
+        LOG_WARN("Close extra inherited listen fd %d", _listenFds.back());
+        close(_listenFds.back());
+        _listenFds.pop_back();
+    }
+    while(_listenFds.size() < shards) {
+        int fd = _openListenFd();
+        if(fd < 0)
+            return false;
+        _listenFds.push_back(fd);
+    }
+    if(shards > 1 && _options.cpuSteering && !_attachCpuSteering()) {
+        LOG_WARN("Attach reuseport cBPF error!");
+    }
+    if(shards == 1) {
+        _listenFd = _listenFds[0];
+        if(_epoller->addFd(_listenFd,  _listenEvent | EPOLLIN) == 0) {
+            LOG_ERROR("Add listen error!");
+            return false;
+        }
+    }
+    LOG_INFO("Server port:%d, listen fd num:%d", _port, (int)_listenFds.size());
+    return true;
+}
+
+// 软限制不够时先在硬限制内提高, 仍不够再尝试提高硬限制 (需要 CAP_SYS_RESOURCE); 返回生效的软限制
+rlim_t WebServer::_raiseFdLimit() {
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) < 0)
+        return 0;
+    rlim_t want = static_cast<rlim_t>(_options.maxConn) + RESERVED_FD;
+    if(rl.rlim_cur >= want)
+        return rl.rlim_cur;
+    struct rlimit raised = { want, std::max(want, rl.rlim_max) };
+    if(setrlimit(RLIMIT_NOFILE, &raised) == 0)
+        return want;
+    raised = { std::min(want, rl.rlim_max), rl.rlim_max };
+    if(setrlimit(RLIMIT_NOFILE, &raised) == 0)
+        return raised.rlim_cur;
+    return rl.rlim_cur;
+}
+
+int WebServer::_openListenFd() {
+    int ret;
+    struct sockaddr_in addr;
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
     addr.sin_port = htons(_port);
@@ -92,50 +316,89 @@ bool WebServer::_initSocket() {
         optLinger.l_linger = 1;
     }
 
-    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
-    if(_listenFd < 0) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
         LOG_ERROR("Create socket error!", _port);
-        return false;
+        return -1;
     }
 
-    ret = setsockopt(_listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(fd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if(ret < 0) {
-        close(_listenFd);
+        close(fd);
         LOG_ERROR("Init linger error!", _port);
-        return false;
+        return -1;
     }
 
     int optval = 1;
     // 端口复用
     // 只有最后一个套接字会正常接收数据
-    ret = setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
+    ret = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
     if(ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(_listenFd);
-        return false;
+        close(fd);
+        return -1;
+    }
+
+    if(_options.reusePort) {
+        // 同一端口上的多个监听套接字组成一组, 内核按四元组哈希 (或 cBPF 程序) 选择
+        ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (const void*)&optval, sizeof(int));
+        if(ret == -1) {
+            LOG_ERROR("set SO_REUSEPORT error !");
+            close(fd);
+            return -1;
+        }
     }
 
-    ret = bind(_listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
     if(ret < 0) {
         LOG_ERROR("Bind Port:%d error!", _port);
-        close(_listenFd);
-        return false;
+        close(fd);
+        return -1;
+    }
+
+    if(_options.deferAcceptSec > 0) {
+        // 三次握手完成后不立即唤醒, 等到请求数据到达 (或超时)
+        ret = setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &_options.deferAcceptSec, sizeof(int));
+        if(ret < 0) {
+            LOG_WARN("set TCP_DEFER_ACCEPT error!");
+        }
     }
 
-    ret = listen(_listenFd, 6);
+    ret = listen(fd, _options.backlog > 0 ? _options.backlog : SOMAXCONN);
     if(ret < 0) {
         LOG_ERROR("Listen port:%d error!", _port);
-        close(_listenFd);
-        return false;
+        close(fd);
+        return -1;
     }
-    ret = _epoller->addFd(_listenFd,  _listenEvent | EPOLLIN);
-    if(ret == 0) {
-        LOG_ERROR("Add listen error!");
-        close(_listenFd);
-        return false;
+    setFdNonBlock(fd);
+    return fd;
+}
+
+// 按收包 CPU 选择监听套接字: 组内下标即 listen 的先后顺序, 与事件循环编号一致.
+// 收包 CPU 是 cpuList[i] 时交给绑定在该核上的第 i 个事件循环, 其余按 CPU 取模
+bool WebServer::_attachCpuSteering() {
+    std::vector<struct sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for(size_t i = 0; i < _listenFds.size() && i < _options.cpuList.size(); i++) {
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(_options.cpuList[i]), 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+    }
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(_listenFds.size())));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+    struct sock_fprog prog;
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    return setsockopt(_listenFds[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
+
+bool WebServer::_initUring(int loopNum) {
+    for(int i = 0; i < loopNum; i++) {
+        _uringLoops.emplace_back(std::make_unique<UringLoop>(i, _listenFds[i % _listenFds.size()], _timeoutMS, _options.maxConn, _cpuOf(i)));
+        _uringLoops.back()->setBlockingPool(_blockingPool.get());
+        if(!_uringLoops.back()->init())
+            return false;
     }
-    setFdNonBlock(_listenFd);
-    LOG_INFO("Server port:%d", _port);
+    if(_listenFd >= 0) _epoller->delFd(_listenFd);
     return true;
 }
 
@@ -159,47 +422,257 @@ void WebServer::_initEventMode(int trigMode) {
     HttpConn::isET = (_connEvent & EPOLLET);
 }
 
+bool WebServer::_initSignal() {
+    int fds[2];
+    if(pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        LOG_ERROR("Create signal pipe error!");
+        return false;
+    }
+    _signalFd = fds[0];
+    signalPipe = fds[1];
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sa.sa_flags = SA_RESTART;
+    sigfillset(&sa.sa_mask);
+    // SIGUSR2: 启动新进程并交出监听 fd; SIGQUIT: 不再 accept, 处理完在途请求后退出
+    if(sigaction(SIGUSR2, &sa, nullptr) < 0 || sigaction(SIGQUIT, &sa, nullptr) < 0) {
+        LOG_ERROR("Set signal handler error!");
+        return false;
+    }
+    // sendfile/writev 没有 MSG_NOSIGNAL, 对端已关闭时由 EPIPE 处理
+    signal(SIGPIPE, SIG_IGN);
+    return _epoller->addFd(_signalFd, EPOLLIN);
+}
+
 void WebServer::_addClient(int fd, sockaddr_in addr) {
     assert(fd > 0);
-    _users[fd].init(fd, addr);
+    if(!_reactors.empty()) {
+        // 轮询分发, 连接在整个生命周期内都留在同一个子 reactor
+        _reactors[_nextReactor++ % _reactors.size()]->addConn(fd, addr);
+        return;
+    }
+    _users.acquire(fd)->init(fd, addr);
     if(_timeoutMS > 0) {
-        _timer->add(fd, _timeoutMS, std::bind(&WebServer::_closeConn, this, &_users[fd]));
+        _timer->add(fd, _timeoutMS, std::bind(&WebServer::_onTimeout, this, fd, _users.generation(fd)));
     }
+    _parked[fd] = true;
     _epoller->addFd(fd, EPOLLIN | _connEvent);
-    setFdNonBlock(fd);
-    LOG_INFO("Client[%d] in!", _users[fd].getFd());
+    LOG_INFO("Client[%d] in!", fd);
 }
 
 void WebServer::_dealListen() {
- struct sockaddr_in addr;
+    struct sockaddr_in addr;
     socklen_t len = sizeof(addr);
-    do {
-        int fd = accept(_listenFd, (struct sockaddr *)&addr, &len);
-        if(fd <= 0) { return;}
-        else if(HttpConn::userCount >= MAX_FD) {
-            _sendError(fd, "Server busy!");
+    int budget = _options.acceptBudget > 0 ? _options.acceptBudget : 1;
+    _acceptPending = false;
+    for(int n = 0; n < budget; n++) {
+        // accept4 直接得到非阻塞 fd, 省去一次 fcntl
+        int fd = accept4(_listenFd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd <= 0) { return; }
+        else if(HttpConn::userCount >= _options.maxConn || fd >= _options.maxConn) {
+            _sendError(fd, HttpResponse::BUSY_RESPONSE);
             LOG_WARN("Clients is full!");
-            return;
+            continue;
         }
         _addClient(fd, addr);
-    } while(_listenEvent & EPOLLET);
+    }
+    // 预算用完: LT 下一轮 epoll 仍会通知, ET 不会再有新的边沿
+    _acceptPending = _listenEvent & EPOLLET;
+}
+
+void WebServer::_dealSignal() {
+    char sig;
+    while(read(_signalFd, &sig, 1) > 0) {
+        if(sig == SIGUSR2) {
+            _upgrade();
+        } else if(sig == SIGQUIT) {
+            LOG_INFO("SIGQUIT received, draining");
+            _drain();
+        }
+    }
+}
+
+void WebServer::_upgrade() {
+    if(_isDraining || _upgradeFd >= 0) {
+        LOG_WARN("Upgrade already in progress!");
+        return;
+    }
+    _upgradePid = Upgrade::spawn(_listenFds, &_upgradeFd);
+    if(_upgradePid < 0)
+        return;
+    _epoller->addFd(_upgradeFd, EPOLLIN | EPOLLRDHUP);
+    LOG_INFO("Upgrade: new process %d started", (int)_upgradePid);
+}
+
+void WebServer::_dealUpgrade() {
+    bool ready = Upgrade::waitReady(_upgradeFd);
+    _epoller->delFd(_upgradeFd);
+    close(_upgradeFd);
+    _upgradeFd = -1;
+    if(!ready) {
+        // 新进程初始化失败, 继续服务
+        LOG_ERROR("Upgrade: new process %d failed!", (int)_upgradePid);
+        waitpid(_upgradePid, nullptr, WNOHANG);
+        return;
+    }
+    LOG_INFO("Upgrade: new process %d ready, draining", (int)_upgradePid);
+    _drain();
+}
+
+// 新连接交给新进程 (或不再接收), 在途请求处理完, 空闲长连接关闭, 之后的响应都带 Connection: close
+void WebServer::_drain() {
+    if(_isDraining)
+        return;
+    _isDraining = true;
+    _acceptPending = false;
+    _drainDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_options.drainTimeoutMS);
+    HttpConn::isDraining = true;
+    for(auto &loop : _uringLoops)
+        loop->drain();
+    if(_uringLoops.empty() && _listenFd >= 0)
+        _epoller->delFd(_listenFd);
+    // 分片的监听套接字交给了子 reactor, 由它在自己的线程注销并关闭: 主线程关闭时子 reactor 可能正在 accept,
+    // 且关闭后的 fd 无法再从它的 epoll 中注销. io_uring 的 accept 持有 fd 的引用, 由事件循环按 user_data 取消
+    bool reactorOwned = _listenFd < 0 && !_reactors.empty();
+    if(!reactorOwned)
+        for(int fd : _listenFds) close(fd);
+    _listenFds.clear();
+    _listenFd = -1;
+    for(auto &reactor : _reactors)
+        reactor->drain();
+    if(_threadPool) {
+        // 只处理空闲连接; 标记可能刚由工作线程设置而 fd 尚未重新注册, 不能在这里关闭 fd,
+        // 只关闭读方向, 注册后触发 EPOLLRDHUP 由主循环关闭. 正在处理或已收到部分请求的连接
+        // 由工作线程处理完, 响应带 Connection: close, 之后再空闲时由工作线程关闭
+        _users.forEach([this](int fd, HttpConn &client) {
+            if(client.isClosed() || !_parked[fd].exchange(false)) return;
+            if(client.isIdle()) shutdown(fd, SHUT_RD);
+            else _parked[fd] = true;
+        });
+    }
+    LOG_INFO("Draining, %d connections left", (int)HttpConn::userCount);
 }
 
 void WebServer::_dealWrite(HttpConn *client) {
     assert(client);
+    _parked[client->getFd()] = false;
     _extentTime(client);
-    _threadPool->addTask(std::bind(&WebServer::_onWrite, this, client));
+    _threadPool->addTask(std::bind(&WebServer::_onWrite, this, client, _users.generation(client->getFd())));
 }
 
 void WebServer::_dealRead(HttpConn *client) {
     assert(client);
+    _parked[client->getFd()] = false;
     _extentTime(client);
-    _threadPool->addTask(std::bind(&WebServer::_onRead, this, client));
+    uint32_t gen = _users.generation(client->getFd());
+    if(!_limiter) {
+        if(!_threadPool->tryAddTask(std::bind(&WebServer::_onRead, this, client, gen))) {
+            ++_queueFullCount;
+            _rejectConn(client);
+        }
+        return;
+    }
+    // 接近上限时才区分请求类型, 平时不多一次系统调用
+    AdaptiveLimiter::PRIORITY prio = _limiter->nearLimit() ? _classify(client) : AdaptiveLimiter::HIGH;
+    if(!_limiter->tryAcquire(prio)) {
+        _rejectConn(client);
+        return;
+    }
+    auto enqueue = std::chrono::steady_clock::now();
+    bool added = _threadPool->tryAddTask([this, client, gen, enqueue] {
+        auto wait = std::chrono::steady_clock::now() - enqueue;
+        _limiter->onStart(std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+        _onRead(client, gen);
+        _limiter->release();
+    });
+    if(!added) {
+        _limiter->release();
+        ++_queueFullCount;
+        _rejectConn(client);
+    }
+}
+
+// 过载: 读掉请求后直接回预先构造的 503 (带 Retry-After) 并关闭, 不进入线程池.
+// 不读掉就 close 会发 RST, 客户端可能收不到响应
+void WebServer::_rejectConn(HttpConn *client) {
+    int readErrno = 0;
+    client->read(&readErrno);
+    const char *info = HttpResponse::BUSY_RESPONSE;
+    if(send(client->getFd(), info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        LOG_WARN("send error to client[%d] error!", client->getFd());
+    }
+    _closeConn(client);
+}
+
+// 只看请求方法: POST (登录/注册) 要访问数据库, 比静态文件请求先被拒绝
+AdaptiveLimiter::PRIORITY WebServer::_classify(HttpConn *client) {
+    char method[4];
+    if(recv(client->getFd(), method, sizeof(method), MSG_PEEK | MSG_DONTWAIT) == sizeof(method) && memcmp(method, "POST", 4) == 0)
+        return AdaptiveLimiter::LOW;
+    return AdaptiveLimiter::HIGH;
+}
+
+void WebServer::_reportOverload() {
+    auto now = std::chrono::steady_clock::now();
+    if(now - _lastReport < std::chrono::milliseconds(REPORT_INTERVAL_MS))
+        return;
+    _lastReport = now;
+    if(_limiter) {
+        LOG_INFO("Overload: limit %d, inflight %d, queue wait %lldus, rejected %llu (static) %llu (post), queue full %llu",
+                _limiter->limit(), _limiter->inflight(), (long long)_limiter->queueWaitUs(),
+                (unsigned long long)_limiter->rejected(AdaptiveLimiter::HIGH),
+                (unsigned long long)_limiter->rejected(AdaptiveLimiter::LOW), (unsigned long long)_queueFullCount);
+    } else if(_threadPool && _options.maxQueue > 0) {
+        LOG_INFO("Overload: queue %d, queue full %llu", (int)_threadPool->queueSize(), (unsigned long long)_queueFullCount);
+    }
+    // 各执行器的排队任务数, 都空闲时不输出
+    size_t cpuQueue = _threadPool ? _threadPool->queueSize() : 0;
+    size_t blockingQueue = _blockingPool->queueSize();
+    if(cpuQueue > 0 || blockingQueue > 0) {
+        LOG_INFO("Executor queue: cpu %zu, blocking %zu", cpuQueue, blockingQueue);
+    }
+    // 数据库连接池: 取连接等待时间的直方图 (累计), 有新的取连接时输出
+    SqlConnPool::Stats sql = SqlConnPool::Instance()->stats();
+    uint64_t checkouts = sql.timeouts;
+    for(uint64_t n : sql.wait) checkouts += n;
+    if(checkouts != _sqlCheckouts) {
+        _sqlCheckouts = checkouts;
+        LOG_INFO("SqlConnPool: open %d, idle %d, wait <0.1ms %llu <1ms %llu <10ms %llu <100ms %llu <1s %llu >=1s %llu, timeout %llu, reconnect %llu",
+                sql.open, sql.idle, (unsigned long long)sql.wait[0], (unsigned long long)sql.wait[1], (unsigned long long)sql.wait[2],
+                (unsigned long long)sql.wait[3], (unsigned long long)sql.wait[4], (unsigned long long)sql.wait[5],
+                (unsigned long long)sql.timeouts, (unsigned long long)sql.reconnects);
+    }
+    // 用户缓存: 命中与合并的查找都省下一次数据库查询
+    UserCache *cache = UserCache::Instance();
+    uint64_t hits = cache->hits(), misses = cache->misses(), coalesced = cache->coalesced();
+    if(hits + misses + coalesced != _userLookups) {
+        _userLookups = hits + misses + coalesced;
+        LOG_INFO("UserCache: hit %llu, miss %llu, coalesced %llu, hit rate %.1f%%, queries saved %llu",
+                (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)coalesced,
+                100.0 * (hits + coalesced) / _userLookups, (unsigned long long)(hits + coalesced));
+    }
+    UserFilter *filter = UserFilter::Instance();
+    if(filter->checks() != _userChecks) {
+        _userChecks = filter->checks();
+        LOG_INFO("UserFilter: %zu users, register checks %llu, select skipped %llu", filter->count(),
+                (unsigned long long)_userChecks, (unsigned long long)filter->skipped());
+    }
+    GroupCommit *commit = GroupCommit::Instance();
+    if(commit->batches() != _commitBatches) {
+        _commitBatches = commit->batches();
+        LOG_INFO("Register batch: %llu batches, %llu rows, %.1f rows per commit", (unsigned long long)_commitBatches,
+                (unsigned long long)commit->rows(), (double)commit->rows() / _commitBatches);
+    }
+    if(_asyncSql && (_asyncSql->queueSize() > 0 || _asyncSql->inflight() > 0)) {
+        LOG_INFO("Async sql: queue %zu, inflight %zu", _asyncSql->queueSize(), _asyncSql->inflight());
+    }
 }
 
 void WebServer::_sendError(int fd, const char *info) {
     assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
+    // fd 为非阻塞, 发不出去就直接丢弃, 不阻塞事件循环
+    int ret = send(fd, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL);
     if(ret < 0) {
         LOG_WARN("send error to client[%d] error!", fd);
     }
@@ -218,8 +691,18 @@ void WebServer::_closeConn(HttpConn *client) {
     client->close();
 }
 
-void WebServer::_onRead(HttpConn *client) {
+// 定时器回调可能晚于 fd 被新连接复用, 代数不一致时忽略; 已关闭的连接其 fd 可能已属于数据库连接.
+// 工作线程持有的连接不能在这里释放状态, 推迟一个超时周期; 已重新注册的连接标记可能刚设置而尚未 modFd,
+// 与排空相同只关闭 socket, 由主循环在随后的 EPOLLHUP 中关闭
+void WebServer::_onTimeout(int fd, uint32_t gen) {
+    if(!_users.isCurrent(fd, gen) || _users.get(fd)->isClosed()) return;
+    if(_parked[fd].exchange(false)) shutdown(fd, SHUT_RDWR);
+    else _timer->add(fd, _timeoutMS, std::bind(&WebServer::_onTimeout, this, fd, gen));
+}
+
+void WebServer::_onRead(HttpConn *client, uint32_t gen) {
     assert(client);
+    if(!_users.isCurrent(client->getFd(), gen)) return;
     int ret = -1;
     int readErrno = 0;
     ret = client->read(&readErrno);
@@ -230,8 +713,9 @@ void WebServer::_onRead(HttpConn *client) {
     _onProcess(client);
 }
 
-void WebServer::_onWrite(HttpConn *client) {
+void WebServer::_onWrite(HttpConn *client, uint32_t gen) {
     assert(client);
+    if(!_users.isCurrent(client->getFd(), gen)) return;
     int ret = -1;
     int writeErrno = 0;
     ret = client->write(&writeErrno);
@@ -245,6 +729,7 @@ void WebServer::_onWrite(HttpConn *client) {
     else if(ret < 0) {
         if(writeErrno == EAGAIN) {
             // 继续传输
+            _parked[client->getFd()] = true;
             _epoller->modFd(client->getFd(), _connEvent | EPOLLOUT);
             return;
         }
@@ -254,15 +739,83 @@ void WebServer::_onWrite(HttpConn *client) {
 
 void WebServer::_onProcess(HttpConn *client) {
     if(client->process()) {
+        _parked[client->getFd()] = true;
         _epoller->modFd(client->getFd(), _connEvent | EPOLLOUT);
+    } else if(client->isVerifying()) {
+        // 结果回来之前不重新注册事件 (EPOLLONESHOT), 连接不会被其他工作线程同时处理
+        _dispatchVerify(client);
+    } else if(HttpConn::isDraining && client->isIdle()) {
+        _closeConn(client);
     } else {
+        // 先标记再注册: 主线程只在分发事件时清除标记, 看到标记时连接一定不在其他工作线程中
+        _parked[client->getFd()] = true;
         _epoller->modFd(client->getFd(), _connEvent | EPOLLIN);
     }
 }
 
+// 数据库查询在阻塞执行器或主循环的非阻塞连接中执行, 完成后经主循环重新交给线程池, 工作线程不等待数据库
+void WebServer::_dispatchVerify(HttpConn *client) {
+    auto cred = std::make_unique<HttpRequest::Credential>();
+    if(!client->takeVerify(cred.get())) return;
+    uint32_t gen = _users.generation(client->getFd());
+    if(_asyncSql) {
+        _post([this, client, gen, cred = std::move(cred)] {
+            HttpRequest::UserVerifyAsync(_asyncSql.get(), std::move(*cred), [this, client, gen](bool ok) {
+                _threadPool->addTask(std::bind(&WebServer::_onVerified, this, client, gen, ok));
+            });
+        });
+        return;
+    }
+    bool added = _blockingPool->tryAddTask([this, client, gen, cred = std::move(cred)] {
+        bool ok = HttpRequest::UserVerify(cred->name, cred->pwd, cred->isLogin);
+        _post([this, client, gen, ok] {
+            _threadPool->addTask(std::bind(&WebServer::_onVerified, this, client, gen, ok));
+        });
+    });
+    if(!added) {
+        // 交出前本轮没有其他响应, 直接回 503 并关闭
+        LOG_WARN("Blocking executor queue is full!");
+        _rejectConn(client);
+    }
+}
+
+void WebServer::_onVerified(HttpConn *client, uint32_t gen, bool ok) {
+    assert(client);
+    if(!_users.isCurrent(client->getFd(), gen) || client->isClosed()) return;
+    client->onVerified(ok);
+    _onProcess(client);
+}
+
+void WebServer::_post(Task &&task) {
+    {
+        std::lock_guard<std::mutex> locker(_postMtx);
+        _posted.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    if(write(_wakeFd, &one, sizeof(one)) != sizeof(one)) {
+        LOG_WARN("WebServer wakeup error!");
+    }
+}
+
+void WebServer::_runPosted() {
+    uint64_t cnt;
+    while(read(_wakeFd, &cnt, sizeof(cnt)) > 0) { }
+    std::vector<Task> posted;
+    {
+        std::lock_guard<std::mutex> locker(_postMtx);
+        posted.swap(_posted);
+    }
+    for(auto &task : posted)
+        task();
+}
+
+int WebServer::_cpuOf(size_t i) const {
+    return _options.cpuList.empty() ? -1 : _options.cpuList[i % _options.cpuList.size()];
+}
+
 int WebServer::setFdNonBlock(int fd) {
     assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
 }
 
 }
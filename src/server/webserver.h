@@ -7,64 +7,173 @@
 #ifndef __WEBSERVER_H__
 #define __WEBSERVER_H__
 
+#include <mutex>
+#include <chrono>
+#include <climits>          // IOV_MAX
+
+#include <signal.h>         // sigaction()
+#include <sys/eventfd.h>    // eventfd()
+#include <sys/resource.h>   // RLIMIT_NOFILE
 #include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_DEFER_ACCEPT
+#include <linux/filter.h>   // SO_ATTACH_REUSEPORT_CBPF 程序
+
+#include "upgrade.h"
 
 #include "epoller.h"
+#include "subreactor.h"
+#include "uringloop.h"
+#include "conntable.hpp"
 #include "../log/log.h"
 #include "../http/httpconn.h"
 #include "../timer/heaptimer.h"
 #include "../pool/sqlconnRAII.h"
 #include "../pool/threadpool.h"
+#include "../pool/asyncsql.h"
+#include "../pool/usercache.h"
+#include "../pool/userfilter.h"
+#include "../pool/groupcommit.h"
+#include "../pool/adaptivelimiter.h"
 
 namespace wsv
 {
 
+/* 扩展配置, 默认值保持原有行为 */
+struct ServerOptions
+{
+    enum IO_BACKEND {
+        IO_EPOLL = 0,
+        IO_URING,
+    };
+
+    int reactorNum = 0;     // > 0 时启用多 reactor 模式: 主线程只 accept, 连接轮询分发给子 reactor
+    IO_BACKEND ioBackend = IO_EPOLL;    // io_uring 不可用时回退到 epoll; io_uring 下 reactorNum 为事件循环数
+    int backlog = SOMAXCONN;            // listen() 队列长度
+    int deferAcceptSec = 0;             // > 0 时设置 TCP_DEFER_ACCEPT: 收到请求数据才唤醒 accept
+    int acceptBudget = 64;              // 每次唤醒最多 accept 的连接数, 剩余的留到下一轮
+    bool reusePort = false;             // reactorNum > 0 时每个子 reactor / io_uring 事件循环一个 SO_REUSEPORT 监听套接字
+    bool cpuSteering = false;           // reusePort 时挂载 cBPF 程序, 按收包 CPU 选择监听套接字
+    std::vector<int> cpuList;           // 工作线程 / 事件循环依次绑定的 CPU, 为空时不绑定
+    int maxQueue = 0;                   // 线程池任务队列上限, 队列满时新请求直接回 503; 0 不限制
+    bool adaptiveLimit = false;         // 线程池模式下按排队时间自适应限制并发请求数, 超限直接回 503
+    int queueWaitTargetUs = 5000;       // 排队时间超过该值时减小并发上限
+    int concurrencyLimitMax = 1024;     // 并发上限的最大值
+    int drainTimeoutMS = 30000;         // SIGUSR2 升级 / SIGQUIT 退出时等待在途请求完成的上限
+    size_t sendfileMin = 0;             // 不小于该大小的文件用缓存的 fd 走 sendfile, 否则 mmap; 0 全部 mmap
+    int fdCacheSize = 256;              // sendfile 文件 fd 缓存的条目数
+    size_t fileCacheBytes = 0;          // 静态文件内存缓存的字节上限, 0 关闭
+    size_t fileCacheMaxFile = 256 * 1024;   // 超过该大小的文件不进内存缓存
+    int pipelineDepth = 16;             // 每个连接一轮最多应答的流水线请求数, 其余留到本轮发完之后
+    int maxConn = 65536;                // 连接数上限, 也是按 fd 下标的连接表大小; 启动时按需提高 RLIMIT_NOFILE
+    int blockingThreadNum = 0;          // 阻塞执行器 (登录/注册查询数据库) 的线程数, 0 时与数据库连接数相同
+    int blockingMaxQueue = 1024;        // 阻塞执行器的排队上限, 满时登录/注册直接回 503; 0 不限制
+    int sqlConnMin = 0;                 // 数据库连接池的最小连接数, 0 时与 connPoolNum 相同; 较小时按需增长到 connPoolNum
+    int sqlCheckoutTimeoutMS = 1000;    // 取数据库连接 (非阻塞连接时为排队) 的等待上限, 超时按登录/注册失败处理; 0 一直等待
+    int sqlPingIntervalMS = 30000;      // 空闲数据库连接的检查间隔, 断开的重连; 0 不检查
+    int sqlIdleTimeoutMS = 60000;       // 超过最小连接数的数据库连接空闲该时间后关闭
+    int asyncSqlConn = 0;               // > 0 时每个 epoll 事件循环建立该数量的非阻塞数据库连接, 替代阻塞执行器; 需要 MariaDB 客户端库
+    int userCacheTTLMS = 0;             // 登录/注册查到的用户在内存中缓存的时间, 0 关闭, 每次都查询数据库
+    size_t userCacheSize = 100000;      // 用户缓存的条目上限
+    bool userFilter = false;            // 启动时载入全部用户名到 Bloom 过滤器, 注册时确定不存在的跳过查询; 需要 username 上的唯一键
+    int registerBatchRows = 0;          // > 0 时阻塞执行器中注册的 INSERT 排队, 每批至多该数量在一个事务中提交; 一批不会多于阻塞执行器的线程数
+    int registerBatchWaitUs = 1000;     // 每批第一个注册的最长等待时间, 越长一批越大, 单个注册的延迟也越高; 0 只合并积压的
+};
+
 class WebServer
 {
 public:
     WebServer(int port, int trigMode, int timeoutMS, bool optLinger,
             int sqlPort, const char *sqlUser, const char *sqlPwd,
             const char *dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueueSize);
+            bool openLog, int logLevel, int logQueueSize,
+            const ServerOptions &options = ServerOptions());
     ~WebServer();
 
     void start();
 
 private:
+    bool _inheritSocket();
     bool _initSocket();
+    int _openListenFd();
+    bool _attachCpuSteering();
+    bool _initUring(int loopNum);
+    rlim_t _raiseFdLimit();
     void _initEventMode(int trigMode);
+    bool _initSignal();
     void _addClient(int fd, sockaddr_in addr);
 
+    void _dealSignal();
+    void _dealUpgrade();
+    void _upgrade();
+    void _drain();
+
     void _dealListen();
     void _dealWrite(HttpConn *client);
     void _dealRead(HttpConn *client);
 
     void _sendError(int fd, const char *info);
+    void _rejectConn(HttpConn *client);
+    AdaptiveLimiter::PRIORITY _classify(HttpConn *client);
+    void _reportOverload();
     void _extentTime(HttpConn *client);
     void _closeConn(HttpConn *client);
+    void _onTimeout(int fd, uint32_t gen);
 
-    void _onRead(HttpConn *client);
-    void _onWrite(HttpConn *client);
+    void _onRead(HttpConn *client, uint32_t gen);
+    void _onWrite(HttpConn *client, uint32_t gen);
 
     void _onProcess(HttpConn *client);
+    void _dispatchVerify(HttpConn *client);
+    void _onVerified(HttpConn *client, uint32_t gen, bool ok);
+    void _post(Task &&task);
+    void _runPosted();
+
+    int _cpuOf(size_t i) const;
 
     static int setFdNonBlock(int fd);
 
 private:
     bool _openLinger;
     bool _isClosed;
+    bool _acceptPending;
+    bool _isDraining;
     int _port;
-    int _listenFd;
+    int _listenFd;          // 主线程 accept 的监听套接字, 分片时为 -1
     int _timeoutMS;
+    int _signalFd;          // 信号处理函数写入的管道读端
+    int _upgradeFd;         // 旧进程: 等待新进程就绪的通道
+    int _notifyFd;          // 静态文件缓存的 inotify fd
+    int _readyFd;           // 新进程: 初始化完成后通知旧进程的通道
+    int _wakeFd;            // 线程池模式下阻塞执行器投递完成回调后唤醒主循环
+    pid_t _upgradePid;
+    std::chrono::steady_clock::time_point _drainDeadline;
     uint32_t _listenEvent;
     uint32_t _connEvent;
     char *_srcDir;
+    size_t _nextReactor;
+    ServerOptions _options;
     std::unique_ptr<HeapTimer> _timer;
     std::unique_ptr<ThreadPool> _threadPool;
+    std::unique_ptr<ThreadPool> _blockingPool;     // 只执行访问数据库的任务, 与处理请求的线程池 / 事件循环分开
+    std::unique_ptr<AdaptiveLimiter> _limiter;
+    uint64_t _queueFullCount;
+    uint64_t _sqlCheckouts;     // 上次输出时数据库连接池的取连接次数, 没有变化时不输出
+    uint64_t _userLookups;      // 上次输出时用户缓存的查找次数
+    uint64_t _userChecks;       // 上次输出时用户名过滤器的查询次数
+    uint64_t _commitBatches;    // 上次输出时批量提交的批次数
+    std::chrono::steady_clock::time_point _lastReport;
     std::unique_ptr<Epoller> _epoller;
-    std::unordered_map<int, HttpConn> _users;
+    ConnTable<HttpConn> _users;
+    std::unique_ptr<std::atomic<bool>[]> _parked;  // 线程池模式: 连接已重新注册事件, 没有工作线程持有
+    std::vector<int> _listenFds;
+    std::vector<std::unique_ptr<SubReactor>> _reactors;
+    std::vector<std::unique_ptr<UringLoop>> _uringLoops;
+    std::mutex _postMtx;
+    std::vector<Task> _posted;
+    std::unique_ptr<AsyncSql> _asyncSql;    // 线程池模式下由主循环驱动, 在 _epoller 之前销毁
 
-    static const int MAX_FD = 65536;
+    static constexpr int REPORT_INTERVAL_MS = 5000;
+    static constexpr int RESERVED_FD = 64;    // 监听/日志/数据库/epoll 等非连接 fd 的余量
 };
 
 }
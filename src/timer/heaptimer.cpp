@@ -31,13 +31,12 @@ void HeapTimer::_siftup(size_t i) {
         LOG_ERROR("HeapTimer > _sfitup: i >= _heap.size()");
         exit(EXIT_FAILURE);
     }
-    size_t j = (i-1)/2;
-    while (j >= 0) { // FIXME: always true
+    while (i > 0) {
+        size_t j = (i-1)/2;
         if (_heap[j] < _heap[i])
             break;
         _swapNode(i, j);
         i = j;
-        j = (i-1)/2;
     }
 }
 
@@ -83,8 +82,6 @@ void HeapTimer::add(int id, int timeout, const TimeoutCallBack &cb) {
         _ref[id] = i;
         _heap.push_back({id, Clock::now() + Millisecond(timeout), cb});
         _siftup(i);
-        TimerNode node = _heap.front();
-        node.callBack();
     } else { // change
         i = _ref[id];
         _heap[i].expires = Clock::now() + Millisecond(timeout);
@@ -138,8 +135,9 @@ void HeapTimer::tick() { // 清除超时结点
         TimerNode node = _heap.front();
         if (std::chrono::duration_cast<Millisecond>(node.expires - Clock::now()).count() > 0)
             break;
-        node.callBack();
+        // 先移除再回调, 回调中可以为同一 id 重新设置定时器
         pop();
+        node.callBack();
     }
 }
 
@@ -0,0 +1,86 @@
+/**
+ * @file bench_alloc.cpp
+ * @brief  每个请求的堆分配次数: 经 socketpair 驱动 HttpConn 完整地解析/生成/发送响应
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_alloc && ./bench_alloc [次数]
+#include <new>
+#include <atomic>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+
+#include "../src/http/httpconn.h"
+
+using namespace wsv;
+
+static std::atomic<uint64_t> allocCount(0);
+
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static const char *CASES[][2] = {
+    { "short", "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n" },
+    { "long",  "GET /images/profile-image.jpg HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept-Encoding: gzip\r\nConnection: keep-alive\r\n\r\n" },
+    { "404",   "GET /no/such/file/in/resources.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n" },
+    { "form",  "POST /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n"
+               "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: 47\r\n\r\n"
+               "username=someone.with.a.long.name&password=abc1" },
+};
+
+static void drain(int fd) {
+    char buf[65536];
+    while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) { }
+}
+
+// 每轮发送 depth 个流水线请求, 返回平均每个请求的分配次数
+static double run(HttpConn &conn, int peer, const std::string &req, int depth, int n) {
+    std::string batch;
+    for (int i = 0; i < depth; i++)
+        batch += req;
+    int err = 0;
+    uint64_t before = 0;
+    for (int i = -100; i < n; i++) {     // 前 100 轮预热, 不计数
+        if (i == 0)
+            before = allocCount.load();
+        if (send(peer, batch.data(), batch.size(), 0) != static_cast<ssize_t>(batch.size()))
+            exit(EXIT_FAILURE);
+        conn.read(&err);
+        while (conn.process()) {
+            while (conn.toWriteBytes() > 0 && conn.write(&err) > 0)
+                drain(peer);
+            drain(peer);
+        }
+    }
+    return static_cast<double>(allocCount.load() - before) / (static_cast<double>(n) * depth);
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 10000;
+    HttpConn::srcDir = "../resources/";
+    HttpConn::isET = false;
+    printf("%-6s %12s %12s\n", "case", "allocs/req", "pipelined x4");
+    for (auto &c : CASES) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+            return EXIT_FAILURE;
+        HttpConn conn;
+        struct sockaddr_in addr = {};
+        conn.init(sv[0], addr);
+        double one = run(conn, sv[1], c[1], 1, n);
+        double four = run(conn, sv[1], c[1], 4, n / 4);
+        printf("%-6s %12.2f %12.2f\n", c[0], one, four);
+        conn.close();
+        ::close(sv[1]);
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ * @file bench_buffer.cpp
+ * @brief  连续缓冲区 Buffer 与块链缓冲区 ChainBuffer 的对比: 读小请求, 流水线响应, 大块读取, 空闲连接占用
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_buffer && ./bench_buffer [次数]
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+
+#include "../src/buffer/buffer.h"
+#include "../src/buffer/chainbuffer.h"
+
+using namespace wsv;
+
+static const char *REQUEST = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+static const char *HEADER = "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nkeep-alive: max=6, timeout=120\r\n"
+                            "Content-type: text/html\r\nContent-length: 3148\r\n\r\n";
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void drain(int fd) {
+    char buf[65536];
+    while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) { }
+}
+
+// 对端发来一个小请求, 读入后整体取走
+template <typename BUFF>
+static double readSmall(int fd, int peer, int n) {
+    BUFF buff;
+    int err = 0;
+    size_t len = strlen(REQUEST);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        if (send(peer, REQUEST, len, 0) != static_cast<ssize_t>(len))
+            exit(EXIT_FAILURE);
+        buff.readFd(fd, &err);
+        buff.retrieve(buff.readableBytes());
+    }
+    return n / seconds(start);
+}
+
+// 对端一次发来 size 字节, 分多次读入后取走
+template <typename BUFF>
+static double readLarge(int fd, int peer, size_t size, int n) {
+    BUFF buff;
+    std::string data(size, 'x');
+    int err = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        size_t sent = 0;
+        while (sent < size) {
+            ssize_t len = send(peer, data.data() + sent, size - sent, MSG_DONTWAIT);
+            if (len > 0)
+                sent += len;
+            if (buff.readFd(fd, &err) <= 0 && len <= 0)
+                exit(EXIT_FAILURE);
+        }
+        while (buff.readableBytes() < size)
+            buff.readFd(fd, &err);
+        buff.retrieve(buff.readableBytes());
+    }
+    return n * size / seconds(start) / 1e6;
+}
+
+// 16 个响应头追加后一次发出
+static double writeBuffer(int fd, int peer, int n) {
+    Buffer buff;
+    int err = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < 16; j++)
+            buff.append(HEADER);
+        while (buff.readableBytes() > 0)
+            buff.writeFd(fd, &err);
+        buff.retrieveAll();
+        drain(peer);
+    }
+    return n * 16 / seconds(start);
+}
+
+static double writeChain(int fd, int peer, int n) {
+    ChainBuffer buff;
+    std::pmr::vector<struct iovec> iov;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < 16; j++)
+            buff.append(HEADER);
+        iov.clear();
+        buff.appendIov(iov, 0, buff.readableBytes());
+        if (writev(fd, iov.data(), static_cast<int>(iov.size())) != static_cast<ssize_t>(buff.readableBytes()))
+            exit(EXIT_FAILURE);
+        buff.retrieveAll();
+        drain(peer);
+    }
+    return n * 16 / seconds(start);
+}
+
+// conns 个连接各处理过一个请求后空闲, 统计缓冲区仍占用的字节
+static size_t idleBuffer(int conns) {
+    std::vector<std::unique_ptr<Buffer>> buffs;
+    size_t bytes = 0;
+    for (int i = 0; i < conns; i++) {
+        buffs.emplace_back(new Buffer());
+        buffs.back()->append(REQUEST);
+        buffs.back()->retrieveAll();
+        bytes += buffs.back()->writableBytes() + buffs.back()->prependableBytes();
+    }
+    return bytes;
+}
+
+static size_t idleChain(int conns) {
+    std::vector<std::unique_ptr<ChainBuffer>> buffs;
+    size_t slabs = ChunkPool::slabCount();
+    for (int i = 0; i < conns; i++) {
+        buffs.emplace_back(new ChainBuffer());
+        buffs.back()->append(REQUEST);
+        buffs.back()->retrieveAll();
+    }
+    // 归还的块留在池中供其他连接复用, 新切分的 slab 就是全部占用
+    return (ChunkPool::slabCount() - slabs) * ChunkPool::CHUNK_SIZE * ChunkPool::CHUNKS_PER_SLAB;
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        return EXIT_FAILURE;
+    int size = 1 << 20;
+    setsockopt(sv[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    printf("%-22s %14s %14s\n", "case", "Buffer", "ChainBuffer");
+    printf("%-22s %14.0f %14.0f\n", "read 69B (req/s)", readSmall<Buffer>(sv[0], sv[1], n), readSmall<ChainBuffer>(sv[0], sv[1], n));
+    printf("%-22s %14.0f %14.0f\n", "read 256KB (MB/s)",
+           readLarge<Buffer>(sv[0], sv[1], 256 << 10, n / 200), readLarge<ChainBuffer>(sv[0], sv[1], 256 << 10, n / 200));
+    printf("%-22s %14.0f %14.0f\n", "write 16x122B (rsp/s)", writeBuffer(sv[1], sv[0], n / 4), writeChain(sv[1], sv[0], n / 4));
+    printf("%-22s %14zu %14zu\n", "idle x10000 (bytes)", idleBuffer(10000), idleChain(10000));
+    ::close(sv[0]);
+    ::close(sv[1]);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file bench_groupcommit.cpp
+ * @brief  注册批量提交测试: 不同批次大小与等待时间下的注册吞吐与延迟, 同批中重复用户名的结果
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_groupcommit
+// 用法: ./bench_groupcommit [port] [user] [pwd] [dbName] [线程数] [秒数], 连接数与线程数相同
+// 也可由 test_asyncsql.sh 启动临时的 mariadbd 后运行: TEST=test/bench_groupcommit test/test_asyncsql.sh [线程数] [秒数]
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/pool/sqlconnRAII.h"
+#include "../src/http/httprequest.h"
+
+using namespace wsv;
+
+struct Config { int rows; int waitUs; };
+
+// threads 个线程各自注册不同的用户名约 seconds 秒, 输出吞吐与延迟分位数
+static void run(const Config &config, int threads, double seconds) {
+    GroupCommit *commit = GroupCommit::Instance();
+    commit->init(config.rows, config.waitUs);
+    uint64_t batches = commit->batches(), rows = commit->rows();
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> failed(0);
+    std::vector<std::vector<double>> latency(threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::string prefix = "gc_" + std::to_string(config.rows) + "_" + std::to_string(config.waitUs) + "_" + std::to_string(t) + "_";
+            for (int n = 0; !stop.load(std::memory_order_relaxed); n++) {
+                auto begin = std::chrono::steady_clock::now();
+                failed += !HttpRequest::UserVerify(prefix + std::to_string(n), "pwd", false);
+                latency[t].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &w : workers)
+        w.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    commit->close();
+
+    std::vector<double> all;
+    for (auto &l : latency)
+        all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    batches = commit->batches() - batches;
+    rows = commit->rows() - rows;
+    char label[64];
+    snprintf(label, sizeof(label), config.rows > 0 ? "batch %d rows, wait %dus" : "no batch", config.rows, config.waitUs);
+    printf("%-26s %8.0f reg/s, p50 %6.2fms, p99 %6.2fms, %5.1f rows/commit, %llu failed\n", label, all.size() / sec,
+           all[all.size() / 2], all[all.size() * 99 / 100], batches ? (double)rows / batches : 1.0, (unsigned long long)failed.load());
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 3306;
+    const char *user = argc > 2 ? argv[2] : "root";
+    const char *pwd = argc > 3 ? argv[3] : "";
+    const char *dbName = argc > 4 ? argv[4] : "yourdb";
+    int threads = argc > 5 ? atoi(argv[5]) : 32;
+    double seconds = argc > 6 ? atof(argv[6]) : 3;
+
+    SqlConnPool *pool = SqlConnPool::Instance();
+    if (pool->init("127.0.0.1", port, user, pwd, dbName, threads) <= 0) {
+        printf("connect error\n");
+        return EXIT_FAILURE;
+    }
+    {
+        MYSQL *sql = nullptr;
+        SqlConnRAII scr(&sql, pool);
+        mysql_query(sql, "CREATE TABLE IF NOT EXISTS user(username char(50) NOT NULL, password char(50) NULL, UNIQUE KEY(username)) ENGINE=InnoDB");
+        mysql_query(sql, "DELETE FROM user WHERE username LIKE 'gc\\_%'");
+    }
+    // 与 -g 相同, 新用户名不查询直接插入, 只测 INSERT 与提交
+    UserFilter::Instance()->init(1 << 20);
+
+    const Config configs[] = { { 0, 0 }, { 8, 0 }, { 64, 0 }, { 64, 1000 }, { 64, 5000 } };
+    for (const Config &config : configs)
+        run(config, threads, seconds);
+
+    // 同一批中的重复用户名: 只有一个成功, 其余由唯一键拒绝
+    GroupCommit::Instance()->init(threads, 5000);
+    std::atomic<int> ok(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&] { ok += HttpRequest::UserVerify("gc_dup", "pwd", false); });
+    for (auto &w : workers)
+        w.join();
+    GroupCommit::Instance()->close();
+    printf("same name from %d threads: %d registered (want 1)\n", threads, ok.load());
+
+    {
+        MYSQL *sql = nullptr;
+        SqlConnRAII scr(&sql, pool);
+        mysql_query(sql, "DELETE FROM user WHERE username LIKE 'gc\\_%'");
+    }
+    pool->closePool();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file bench_idle.cpp
+ * @brief  空闲长连接的内存占用: 建立大量回环连接, 每个完成一次请求后保持空闲, 统计服务器每连接的常驻内存
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_idle
+// 运行: web_server -n 1100000 -t 0 &  ./bench_idle <服务器 pid> [连接数] [端口]
+// 需要: ulimit -n 足够大 (或以 root 运行), net.ipv4.ip_local_port_range 尽量宽;
+// 源地址在 127.0.0.1 ~ 127.0.0.255 间轮换, 每个源地址的端口各自独立, 可以超过 65535 个连接
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+static const char REQUEST[] = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+static const int BATCH = 1000;
+static const int CONNS_PER_SOURCE = 30000;
+
+// 单位 KB
+static long readRss(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    char line[256];
+    long rss = -1;
+    while (fgets(line, sizeof(line), fp))
+        if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+            break;
+    fclose(fp);
+    return rss;
+}
+
+static int connectOne(int port, int i) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int on = 1;
+    setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof(on));
+    struct sockaddr_in src = {};
+    src.sin_family = AF_INET;
+    src.sin_addr.s_addr = htonl(0x7f000001 + i / CONNS_PER_SOURCE % 255);
+    struct sockaddr_in dst = {};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(port);
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval timeout = { 5, 0 };     // 服务器 fd 耗尽时连接停在 accept 队列里, 不会有响应
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&src), sizeof(src)) < 0
+            || connect(fd, reinterpret_cast<struct sockaddr*>(&dst), sizeof(dst)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 读完一个响应: 头部 + Content-length 字节
+static bool readResponse(int fd) {
+    std::string resp;
+    char buf[8192];
+    size_t need = std::string::npos;
+    while (resp.size() < need) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len <= 0)
+            return false;
+        resp.append(buf, len);
+        size_t end = resp.find("\r\n\r\n");
+        if (need == std::string::npos && end != std::string::npos) {
+            const char *cl = strcasestr(resp.c_str(), "Content-length:");
+            need = end + 4 + (cl ? strtoul(cl + 15, nullptr, 10) : 0);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s serverPid [conns] [port]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int pid = atoi(argv[1]);
+    int conns = argc > 2 ? atoi(argv[2]) : 1000000;
+    int port = argc > 3 ? atoi(argv[3]) : 12309;
+
+    struct rlimit rl = { static_cast<rlim_t>(conns) + 64, static_cast<rlim_t>(conns) + 64 };
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+        fprintf(stderr, "setrlimit failed, limited by ulimit -n\n");
+
+    long before = readRss(pid);
+    std::vector<int> fds;
+    fds.reserve(conns);
+    auto start = std::chrono::steady_clock::now();
+    while (static_cast<int>(fds.size()) < conns) {
+        // 一批连接各发一个请求再统一收响应, 服务器上同时活跃的连接不超过一批
+        size_t first = fds.size();
+        for (int i = 0; i < BATCH && static_cast<int>(fds.size()) < conns; i++) {
+            int fd = connectOne(port, static_cast<int>(fds.size()));
+            if (fd < 0)
+                break;
+            fds.push_back(fd);
+        }
+        if (fds.size() == first) {
+            perror("connect");
+            break;
+        }
+        for (size_t i = first; i < fds.size(); i++)
+            if (send(fds[i], REQUEST, sizeof(REQUEST) - 1, 0) != static_cast<ssize_t>(sizeof(REQUEST) - 1))
+                return EXIT_FAILURE;
+        size_t done = first;
+        while (done < fds.size() && readResponse(fds[done]))
+            ++done;
+        if (done < fds.size()) {
+            fprintf(stderr, "no response on connection %zu, stop here\n", done);
+            for (size_t i = done; i < fds.size(); i++)
+                close(fds[i]);
+            fds.resize(done);
+            break;
+        }
+        if (fds.size() % 100000 < BATCH)
+            printf("  %zu connections, server rss %ld KB\n", fds.size(), readRss(pid));
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sleep(1);
+    long after = readRss(pid);
+    printf("idle connections: %zu (%.1f s)\n", fds.size(), sec);
+    printf("server rss: %ld KB -> %ld KB, %.0f bytes/conn\n", before, after,
+           fds.empty() ? 0.0 : (after - before) * 1024.0 / fds.size());
+    for (int fd : fds)
+        close(fd);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file bench_parser.cpp
+ * @brief  请求解析微基准: 单线程每秒解析的请求数 (含响应阶段常用的头部查找)
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_parser && ./bench_parser [次数]
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/http/httprequest.h"
+
+using namespace wsv;
+
+static const char *CASES[][2] = {
+    { "curl",
+      "GET /index.html HTTP/1.1\r\n"
+      "Host: 127.0.0.1:12309\r\n"
+      "User-Agent: curl/7.81.0\r\n"
+      "Accept: */*\r\n"
+      "Connection: keep-alive\r\n\r\n" },
+    { "browser",
+      "GET /images/profile-image.jpg HTTP/1.1\r\n"
+      "Host: www.example.com:12309\r\n"
+      "Connection: keep-alive\r\n"
+      "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+      "sec-ch-ua-mobile: ?0\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+      "sec-ch-ua-platform: \"Linux\"\r\n"
+      "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+      "Sec-Fetch-Site: same-origin\r\n"
+      "Sec-Fetch-Mode: no-cors\r\n"
+      "Sec-Fetch-Dest: image\r\n"
+      "Referer: http://www.example.com:12309/picture\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+      "Cookie: _ga=GA1.1.1234567890.1697000000; session=3f2a9c1e7b5d4a6f8e0c2b4d6f8a0c2e; theme=dark\r\n\r\n" },
+    { "post",
+      "POST /submit HTTP/1.1\r\n"
+      "Host: 127.0.0.1:12309\r\n"
+      "User-Agent: curl/7.81.0\r\n"
+      "Accept: */*\r\n"
+      "Content-Type: application/x-www-form-urlencoded\r\n"
+      "Content-Length: 30\r\n\r\n"
+      "username=alice&password=secret" },
+};
+
+// 以 browser 请求为基础, 用 Cookie 补足到约 size 字节 (大 Cookie / 长 UA 的场景)
+static std::string padded(size_t size) {
+    std::string req = CASES[1][1];
+    req.resize(req.size() - 2);
+    std::string cookie = "Cookie: ";
+    for (int i = 0; req.size() + cookie.size() + 4 < size; i++)
+        cookie += "k" + std::to_string(i) + "=" + std::string(40, 'a' + i % 26) + "; ";
+    cookie.resize(size > req.size() + 4 ? size - req.size() - 4 : cookie.size());
+    return req + cookie + "\r\n\r\n";
+}
+
+static size_t lookup(const HttpRequest &request) {
+    return request.header("Host").size() + request.header("Accept-Encoding").size()
+        + request.header("If-None-Match").size() + request.header("Range").size();
+}
+
+static void run(const char *name, const std::string &req, int n) {
+    ChainBuffer buff;
+    HttpRequest request;
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        buff.append(req.data(), req.size());
+        request.init();
+        request.parse(buff);
+        sink += lookup(request);
+        buff.retrieveAll();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-8s %5zu B  %10.0f req/s  %8.1f MB/s  path=%s\n", name, req.size(), n / sec, n * req.size() / sec / 1e6, sink ? request.path().c_str() : "");
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 500000;
+    std::vector<std::pair<const char*, std::string>> cases;
+    for (auto &c : CASES)
+        cases.emplace_back(c[0], c[1]);
+    cases.emplace_back("hdr200", std::string(CASES[0][1]) .insert(strlen(CASES[0][1]) - 2, "Accept-Language: en-US,en;q=0.5\r\nAccept-Encoding: gzip\r\n"));
+    cases.emplace_back("hdr1k", padded(1024));
+    cases.emplace_back("hdr8k", padded(8192));
+
+    const char *LEVEL_NAME[] = { "scalar", "sse2", "avx2" };
+    for (int level = Scanner::SCALAR; level <= Scanner::AVX2; level++) {
+        if (!Scanner::setLevel(static_cast<Scanner::LEVEL>(level)))
+            continue;
+        printf("%s:\n", LEVEL_NAME[level]);
+        for (auto &c : cases)
+            run(c.first, c.second, c.first[0] == 'h' && c.second.size() > 4096 ? n / 8 : n);
+    }
+}
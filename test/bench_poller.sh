@@ -0,0 +1,26 @@
+#!/bin/sh
+# 对比 epoll 与 io_uring 后端在四种 trigMode 下的吞吐
+# 用法: test/bench_poller.sh [clients] [seconds]
+# 需先构建 web_server (默认 build/bin/web_server) 与 webbench-1.5/webbench, 在仓库根目录运行
+cd "$(dirname "$0")/.." || exit 1
+CLIENTS=${1:-500}
+SECONDS_=${2:-10}
+SERVER=${SERVER:-build/bin/web_server}
+WEBBENCH=${WEBBENCH:-webbench-1.5/webbench}
+URL=${URL:-http://127.0.0.1:12309/}
+
+for backend in epoll io_uring; do
+    flag=""
+    [ "$backend" = "io_uring" ] && flag="-u"
+    for mode in 0 1 2 3; do
+        $SERVER -m $mode $flag > /dev/null 2>&1 &
+        pid=$!
+        sleep 1
+        result=$($WEBBENCH -c "$CLIENTS" -t "$SECONDS_" "$URL" 2>&1 | grep -E "Speed|Requests" | tr '\n' ' ')
+        echo "$backend trigMode=$mode: $result"
+        kill $pid
+        wait $pid 2>/dev/null
+        # io_uring 实例异步销毁, 等监听端口真正释放后再启动下一轮
+        sleep 2
+    done
+done
@@ -0,0 +1,163 @@
+/**
+ * @file bench_pool.cpp
+ * @brief  线程池竞争测试: 原来的单锁 + std::function 队列与工作窃取线程池的吞吐和每任务分配次数
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_pool && ./bench_pool [线程数] [任务数]
+#include <new>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/pool/threadpool.h"
+
+using namespace wsv;
+
+static std::atomic<uint64_t> allocCount(0);
+
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// 改动前的实现: 所有线程共用一把锁, 一个条件变量和一个 std::function 队列
+class LockedPool
+{
+public:
+    explicit LockedPool(size_t threadCount) {
+        for (size_t i = 0; i < threadCount; i++) {
+            _threads.emplace_back([this] {
+                std::unique_lock<std::mutex> locker(_mtx);
+                for (;;) {
+                    if (!_tasks.empty()) {
+                        auto task = std::move(_tasks.front());
+                        _tasks.pop();
+                        locker.unlock();
+                        task();
+                        locker.lock();
+                    } else if (_isClosed) {
+                        break;
+                    } else {
+                        _cond.wait(locker);
+                    }
+                }
+            });
+        }
+    }
+
+    ~LockedPool() {
+        {
+            std::lock_guard<std::mutex> locker(_mtx);
+            _isClosed = true;
+        }
+        _cond.notify_all();
+        for (auto &t : _threads)
+            t.join();
+    }
+
+    template<class F>
+    void addTask(F &&task) {
+        {
+            std::lock_guard<std::mutex> locker(_mtx);
+            _tasks.emplace(std::forward<F>(task));
+        }
+        _cond.notify_one();
+    }
+
+private:
+    std::mutex _mtx;
+    std::condition_variable _cond;
+    bool _isClosed = false;
+    std::queue<std::function<void()>> _tasks;
+    std::vector<std::thread> _threads;
+};
+
+struct Conn
+{
+    std::atomic<uint64_t> handled{0};
+};
+
+// 模拟一次连接事件: 少量计算
+static void onEvent(Conn *conn, uint32_t gen) {
+    uint64_t x = gen;
+    for (int i = 0; i < 64; i++)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    conn->handled.fetch_add(1 + (x == 0), std::memory_order_relaxed);
+}
+
+static void waitDone(Conn &conn, uint64_t total) {
+    while (conn.handled.load(std::memory_order_relaxed) < total)
+        std::this_thread::yield();
+}
+
+// producers 个线程同时提交, 每个任务捕获与 WebServer::_onRead 相同的 (对象, 连接, 代数)
+template<class POOL>
+static void run(const char *name, size_t threads, int producers, uint64_t tasks) {
+    Conn conn;
+    uint64_t before;
+    double sec;
+    {
+        POOL pool(threads);
+        std::vector<std::thread> submitters;
+        submitters.reserve(producers);
+        before = allocCount.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < producers; p++) {
+            submitters.emplace_back([&pool, &conn, p, producers, tasks] {
+                for (uint64_t i = p; i < tasks; i += producers) {
+                    uint32_t gen = static_cast<uint32_t>(i);
+                    pool.addTask(std::bind(&onEvent, &conn, gen));
+                }
+            });
+        }
+        for (auto &t : submitters)
+            t.join();
+        waitDone(conn, tasks);
+        sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    printf("  %-14s producers=%d  %10.0f tasks/s  %5.2f allocs/task\n", name, producers, tasks / sec,
+           static_cast<double>(allocCount.load() - before - producers) / tasks);    // 每个 std::thread 分配一次
+}
+
+// 工作线程内提交后续任务 (本线程队列 + 窃取), 每个根任务派生 fanout 个子任务
+static void runFanout(size_t threads, uint64_t roots, int fanout) {
+    Conn conn;
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        ThreadPool *p = &pool;
+        for (uint64_t i = 0; i < roots; i++) {
+            pool.addTask([p, &conn, fanout] {
+                for (int k = 0; k < fanout; k++)
+                    p->addTask(std::bind(&onEvent, &conn, static_cast<uint32_t>(k)));
+            });
+        }
+        waitDone(conn, roots * fanout);
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-14s fanout=%d     %10.0f tasks/s\n", "stealing", fanout, roots * fanout / sec);
+}
+
+int main(int argc, char *argv[]) {
+    size_t threads = argc > 1 ? atoi(argv[1]) : std::max(2u, std::thread::hardware_concurrency());
+    uint64_t tasks = argc > 2 ? atoll(argv[2]) : 2000000;
+    printf("threads=%zu tasks=%llu\n", threads, (unsigned long long)tasks);
+    for (int producers : { 1, 4 }) {
+        run<LockedPool>("mutex+queue", threads, producers, tasks);
+        run<ThreadPool>("work-stealing", threads, producers, tasks);
+    }
+    runFanout(threads, tasks / 16, 16);
+}
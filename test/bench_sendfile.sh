@@ -0,0 +1,33 @@
+#!/bin/sh
+# 对比 mmap+writev 与 sendfile 在不同文件大小下的吞吐
+# 用法: test/bench_sendfile.sh [clients] [seconds]
+# 需先构建 web_server (默认 build/bin/web_server) 与 webbench-1.5/webbench, 在仓库根目录运行
+cd "$(dirname "$0")/.." || exit 1
+CLIENTS=${1:-200}
+SECONDS_=${2:-10}
+SERVER=${SERVER:-build/bin/web_server}
+WEBBENCH=${WEBBENCH:-webbench-1.5/webbench}
+SIZES=${SIZES:-"1K 16K 256K 4M 64M"}
+
+mkdir -p resources/bench
+for size in $SIZES; do
+    head -c "$size" /dev/urandom > "resources/bench/$size.bin" 2>/dev/null || \
+        dd if=/dev/urandom of="resources/bench/$size.bin" bs="$size" count=1 2>/dev/null
+done
+
+for mode in mmap sendfile; do
+    flag=""
+    [ "$mode" = "sendfile" ] && flag="-s 1"
+    $SERVER $flag > /dev/null 2>&1 &
+    pid=$!
+    sleep 1
+    for size in $SIZES; do
+        result=$($WEBBENCH -c "$CLIENTS" -t "$SECONDS_" "http://127.0.0.1:12309/bench/$size.bin" 2>&1 | grep -E "Speed|Requests" | tr '\n' ' ')
+        echo "$mode $size: $result"
+    done
+    kill $pid
+    wait $pid 2>/dev/null
+    sleep 1
+done
+
+rm -rf resources/bench
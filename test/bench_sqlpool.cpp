@@ -0,0 +1,165 @@
+/**
+ * @file bench_sqlpool.cpp
+ * @brief  数据库连接池测试: 取还连接的吞吐, 文本查询与缓存的预处理语句的登录 QPS, 按需增长与取连接超时
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_sqlpool
+// 用法: ./bench_sqlpool [port] [user] [pwd] [dbName] [线程数] [秒数], 最大连接数与线程数相同, 启动时只建立一个
+// 也可由 test_asyncsql.sh 启动临时的 mariadbd 后运行: TEST=test/bench_sqlpool test/test_asyncsql.sh [线程数] [秒数]
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/pool/sqlconnRAII.h"
+#include "../src/http/httprequest.h"
+
+using namespace wsv;
+
+// 改动前的取还方式: 信号量 + 全局互斥锁保护的队列
+class LockedQueue
+{
+public:
+    explicit LockedQueue(const std::vector<MYSQL*> &conns) {
+        for (MYSQL *sql : conns)
+            _queue.push(sql);
+        sem_init(&_sem, 0, conns.size());
+    }
+    MYSQL* get() {
+        sem_wait(&_sem);
+        std::lock_guard<std::mutex> locker(_mtx);
+        MYSQL *sql = _queue.front();
+        _queue.pop();
+        return sql;
+    }
+    void put(MYSQL *sql) {
+        {
+            std::lock_guard<std::mutex> locker(_mtx);
+            _queue.push(sql);
+        }
+        sem_post(&_sem);
+    }
+
+private:
+    sem_t _sem;
+    std::mutex _mtx;
+    std::queue<MYSQL*> _queue;
+};
+
+// threads 个线程循环执行 op 约 seconds 秒, 返回每秒次数; op 返回 false 计为失败
+static double run(int threads, double seconds, const std::function<bool()> &op, uint64_t *failed) {
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> total(0), bad(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            uint64_t n = 0, err = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                err += !op();
+                n++;
+            }
+            total += n;
+            bad += err;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &w : workers)
+        w.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (failed)
+        *failed = bad;
+    return total / sec;
+}
+
+// 改动前 UserVerify 的查询方式: 拼接 SQL, 文本协议, 每次由服务端完整解析
+static bool textLogin(MYSQL *sql, const char *name, const char *pwd) {
+    char order[256] = {0};
+    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name);
+    if (mysql_query(sql, order))
+        return false;
+    MYSQL_RES *res = mysql_store_result(sql);
+    if (!res)
+        return false;
+    bool flag = false;
+    while (MYSQL_ROW row = mysql_fetch_row(res))
+        flag = strcmp(pwd, row[1]) == 0;
+    mysql_free_result(res);
+    return flag;
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 3306;
+    const char *user = argc > 2 ? argv[2] : "root";
+    const char *pwd = argc > 3 ? argv[3] : "";
+    const char *dbName = argc > 4 ? argv[4] : "yourdb";
+    int threads = argc > 5 ? atoi(argv[5]) : 4;
+    double seconds = argc > 6 ? atof(argv[6]) : 3;
+
+    SqlConnPool *pool = SqlConnPool::Instance();
+    SqlPoolOptions options;
+    options.minConn = 1;
+    options.checkoutTimeoutMS = 200;
+    if (pool->init("127.0.0.1", port, user, pwd, dbName, threads, options) != 1) {
+        printf("connect error\n");
+        return EXIT_FAILURE;
+    }
+    {
+        MYSQL *sql = nullptr;
+        SqlConnRAII scr(&sql, pool);
+        mysql_query(sql, "CREATE TABLE IF NOT EXISTS user(username char(50) NULL, password char(50) NULL) ENGINE=InnoDB");
+        mysql_query(sql, "DELETE FROM user WHERE username='bench_user'");
+    }
+    HttpRequest::UserVerify("bench_user", "bench_pwd", false);
+
+    // 同时持有 threads 个连接: 连接池从 1 个增长到上限, 再取连接时等待超时
+    std::vector<MYSQL*> conns;
+    for (int i = 0; i < threads; i++)
+        conns.push_back(pool->getConn());
+    auto start = std::chrono::steady_clock::now();
+    MYSQL *extra = pool->getConn();
+    double waitMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("grow: %d connections open; checkout beyond max: %s after %.0fms\n", pool->stats().open,
+           extra ? "got connection" : "timeout", waitMS);
+    if (extra)
+        pool->freeConn(extra);
+
+    // 取还连接, 不访问数据库
+    LockedQueue locked(conns);
+    for (MYSQL *sql : conns)
+        pool->freeConn(sql);
+    double lockedOps = run(threads, seconds, [&] { locked.put(locked.get()); return true; }, nullptr);
+    double affineOps = run(threads, seconds, [&] { pool->freeConn(pool->getConn()); return true; }, nullptr);
+    printf("checkout (%d threads): locked queue %.0f/s, thread-affine %.0f/s\n", threads, lockedOps, affineOps);
+
+    // 登录查询
+    uint64_t textFailed = 0, stmtFailed = 0;
+    double textQps = run(threads, seconds, [&] {
+        MYSQL *sql = nullptr;
+        SqlConnRAII scr(&sql, pool);
+        return textLogin(sql, "bench_user", "bench_pwd");
+    }, &textFailed);
+    double stmtQps = run(threads, seconds, [] { return HttpRequest::UserVerify("bench_user", "bench_pwd", true); }, &stmtFailed);
+    printf("login (%d threads): text query %.0f qps (%llu failed), prepared stmt %.0f qps (%llu failed)\n", threads,
+           textQps, (unsigned long long)textFailed, stmtQps, (unsigned long long)stmtFailed);
+
+    SqlConnPool::Stats stats = pool->stats();
+    printf("checkout wait: <0.1ms %llu, <1ms %llu, <10ms %llu, <100ms %llu, <1s %llu, >=1s %llu, timeout %llu\n",
+           (unsigned long long)stats.wait[0], (unsigned long long)stats.wait[1], (unsigned long long)stats.wait[2],
+           (unsigned long long)stats.wait[3], (unsigned long long)stats.wait[4], (unsigned long long)stats.wait[5],
+           (unsigned long long)stats.timeouts);
+    {
+        MYSQL *sql = nullptr;
+        SqlConnRAII scr(&sql, pool);
+        mysql_query(sql, "DELETE FROM user WHERE username='bench_user'");
+    }
+    pool->closePool();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file bench_usercache.cpp
+ * @brief  用户缓存测试: 热点用户的登录风暴下的数据库查询数, 命中率与合并的查询
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_usercache
+// 用法: ./bench_usercache [线程数] [用户数] [秒数] [查询延迟 us], 数据库查询以 sleep 模拟, 不需要 mysqld
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/pool/usercache.h"
+
+using namespace wsv;
+
+static std::atomic<uint64_t> queries(0);
+static int latencyUs = 1000;
+
+// 模拟 SELECT password FROM user WHERE username=?: user<i> 的密码为 pwd<i>, 其他用户不存在
+static UserCache::STATUS fakeSelect(const std::string &name, std::string *pwd) {
+    queries.fetch_add(1, std::memory_order_relaxed);
+    std::this_thread::sleep_for(std::chrono::microseconds(latencyUs));
+    if (name.compare(0, 4, "user") != 0)
+        return UserCache::NOT_FOUND;
+    *pwd = "pwd" + name.substr(4);
+    return UserCache::FOUND;
+}
+
+static bool login(const std::string &name, const std::string &pwd) {
+    bool match = false;
+    UserCache::STATUS status = UserCache::Instance()->lookup(name, pwd, &match,
+            [&name](std::string *stored) { return fakeSelect(name, stored); });
+    return status == UserCache::FOUND && match;
+}
+
+// threads 个线程对 users 个用户循环登录约 seconds 秒, 每 10 次有一次密码错误
+static void storm(const char *label, int threads, int users, double seconds) {
+    queries = 0;
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> total(0), wrong(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            uint64_t n = 0, err = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::string id = std::to_string(rng() % users);
+                bool bad = n % 10 == 9;
+                // 密码错误时登录必须失败, 正确时必须成功
+                err += login("user" + id, bad ? "bad" : "pwd" + id) == bad;
+                n++;
+            }
+            total += n;
+            wrong += err;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &w : workers)
+        w.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %.0f logins/s, db queries %llu (%.2f%% of logins), wrong results %llu\n", label, total / sec,
+           (unsigned long long)queries.load(), 100.0 * queries / total, (unsigned long long)wrong.load());
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    int users = argc > 2 ? atoi(argv[2]) : 64;
+    double seconds = argc > 3 ? atof(argv[3]) : 2;
+    latencyUs = argc > 4 ? atoi(argv[4]) : 1000;
+    UserCache *cache = UserCache::Instance();
+
+    // 未启用: 每次登录都查询
+    storm("no cache", threads, users, seconds);
+
+    cache->init(60000, 100000);
+    // 冷启动: 所有线程同时登录同一个用户, 只有一次查询
+    queries = 0;
+    std::vector<std::thread> workers;
+    std::atomic<int> failed(0);
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&] { failed += !login("user_cold", "pwd_cold"); });
+    for (auto &w : workers)
+        w.join();
+    printf("cold start (%d threads, same user): db queries %llu, coalesced %llu, failed %d\n", threads,
+           (unsigned long long)queries.load(), (unsigned long long)cache->coalesced(), failed.load());
+
+    storm("cache", threads, users, seconds);
+    uint64_t hits = cache->hits(), misses = cache->misses(), coalesced = cache->coalesced();
+    printf("cache: hit %llu, miss %llu, coalesced %llu, hit rate %.2f%%, queries saved %llu\n",
+           (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)coalesced,
+           100.0 * (hits + coalesced) / (hits + misses + coalesced), (unsigned long long)(hits + coalesced));
+
+    // 注册成功后写入, 随后的登录不查询
+    queries = 0;
+    cache->put("newbie", "secret");
+    bool fresh = login("newbie", "secret") && !login("newbie", "wrong");
+    printf("write-through after register: %s, db queries %llu\n", fresh ? "ok" : "FAILED", (unsigned long long)queries.load());
+    return fresh ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file bench_userfilter.cpp
+ * @brief  用户名过滤器测试: 批量加入与查询的速度, 误判率, 从数据库载入 1000 万用户的启动时间
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make bench_userfilter
+// 用法: ./bench_userfilter [port] [user] [pwd] [dbName] [用户数], port 为 0 或不给时只测内存中的过滤器
+// 也可由 test_asyncsql.sh 启动临时的 mariadbd 后运行: TEST=test/bench_userfilter test/test_asyncsql.sh 10000000
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/pool/userfilter.h"
+
+using namespace wsv;
+
+static double elapsedMS(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 按 capacity 分配, 加入 users 个用户名, 再查询同样多个不存在的用户名; 返回漏报数
+static size_t fill(const char *label, size_t capacity, size_t users) {
+    UserFilter *filter = UserFilter::Instance();
+    filter->init(capacity);
+    char name[32];
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < users; i++)
+        filter->add(std::string_view(name, snprintf(name, sizeof(name), "u%zu", i)));
+    double addMS = elapsedMS(start);
+
+    size_t missing = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < users; i++)
+        missing += !filter->mayContain(std::string_view(name, snprintf(name, sizeof(name), "u%zu", i)));
+    double hitMS = elapsedMS(start);
+
+    size_t falsePositive = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < users; i++)
+        falsePositive += filter->mayContain(std::string_view(name, snprintf(name, sizeof(name), "new%zu", i)));
+    double missMS = elapsedMS(start);
+
+    printf("%s: %zu users, %zu MB, add %.0fms (%.1fns/user, atomic), lookup %.1fns present / %.1fns absent, "
+           "false positive %.3f%%, false negative %zu\n", label, users, filter->bytes() >> 20, addMS, addMS * 1e6 / users,
+           hitMS * 1e6 / users, missMS * 1e6 / users, 100.0 * falsePositive / users, missing);
+    return missing;
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 0;
+    const char *user = argc > 2 ? argv[2] : "root";
+    const char *pwd = argc > 3 ? argv[3] : "";
+    const char *dbName = argc > 4 ? argv[4] : "yourdb";
+    size_t users = argc > 5 ? strtoull(argv[5], nullptr, 10) : 10000000;
+
+    // 启动载入时按两倍行数分配; 注册到与预计用户数相同时误判率最高
+    size_t missing = fill("capacity 2x", users * 2, users);
+    missing += fill("capacity 1x", users, users);
+    if (port <= 0)
+        return missing ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    // 从数据库载入: user 表补足 users 行后计时 load()
+    MYSQL *sql = mysql_init(nullptr);
+    if (!mysql_real_connect(sql, "127.0.0.1", user, pwd, dbName, port, nullptr, 0)) {
+        printf("connect error: %s\n", mysql_error(sql));
+        return EXIT_FAILURE;
+    }
+    mysql_query(sql, "CREATE TABLE IF NOT EXISTS user(username char(50) NOT NULL, password char(50) NULL, UNIQUE KEY(username)) ENGINE=InnoDB");
+    // MariaDB 的 SEQUENCE 引擎生成 u0..u<users-1>, 已有的跳过
+    std::string populate = "INSERT IGNORE INTO user SELECT CONCAT('u', seq), 'pwd' FROM seq_0_to_" + std::to_string(users - 1);
+    auto start = std::chrono::steady_clock::now();
+    if (mysql_query(sql, populate.c_str()))
+        printf("populate: %s\n", mysql_error(sql));
+    printf("populate: %.0fms\n", elapsedMS(start));
+
+    start = std::chrono::steady_clock::now();
+    UserFilter::LOAD_RESULT result = UserFilter::Instance()->load(sql);
+    double loadMS = elapsedMS(start);
+    if (result != UserFilter::LOADED) {
+        printf("load failed: %s\n", result == UserFilter::NO_UNIQUE_KEY ? "no unique key on username" : mysql_error(sql));
+        mysql_close(sql);
+        return EXIT_FAILURE;
+    }
+    printf("load from db: %zu users, %zu MB, %.0fms\n", UserFilter::Instance()->count(), UserFilter::Instance()->bytes() >> 20, loadMS);
+    mysql_close(sql);
+    return missing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file check.h
+ * @brief  测试程序共用的检查与汇总: 每项输出 ok/FAIL, 结束时输出 PASSED/FAILED 并给出退出码
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <cstdio>
+#include <cstdlib>
+
+inline int checkFailed = 0;
+
+inline void check(bool cond, const char *what) {
+    printf("%s: %s\n", cond ? "ok  " : "FAIL", what);
+    if (!cond)
+        checkFailed++;
+}
+
+// main 的返回值
+inline int checkResult() {
+    printf("%d failed, %s\n", checkFailed, checkFailed ? "FAILED" : "PASSED");
+    return checkFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif // __CHECK_H__
@@ -0,0 +1,150 @@
+/**
+ * @file test_asyncsql.cpp
+ * @brief  非阻塞数据库客户端测试: 查询结果, 登录/注册流程, NO_BACKSLASH_ESCAPES 下的参数转义, 单线程多查询并发, 排队超时
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make test_asyncsql; 通常由 test_asyncsql.sh 启动临时的 mariadbd 后运行
+// 用法: ./test_asyncsql [port] [user] [pwd] [dbName] [连接数] [SLEEP 查询数]
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/pool/asyncsql.h"
+#include "../src/http/httprequest.h"
+#include "check.h"
+
+using namespace wsv;
+
+// 与事件循环相同的驱动方式: epoll 等待, 分发给 AsyncSql, 处理超时
+static void runUntil(Epoller &epoller, HeapTimer &timer, AsyncSql &sql, const int &pending) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (pending > 0 && std::chrono::steady_clock::now() < deadline) {
+        int timeMS = timer.getNextTick();
+        int eventCnt = epoller.wait(timeMS < 0 || timeMS > 100 ? 100 : timeMS);
+        for (int i = 0; i < eventCnt; i++)
+            sql.handleEvent(epoller.getEventFd(i), epoller.getEvents(i));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 3306;
+    const char *user = argc > 2 ? argv[2] : "root";
+    const char *pwd = argc > 3 ? argv[3] : "";
+    const char *dbName = argc > 4 ? argv[4] : "yourdb";
+    int connNum = argc > 5 ? atoi(argv[5]) : 4;
+    int sleepNum = argc > 6 ? atoi(argv[6]) : 32;
+
+    if (!AsyncSql::isSupported()) {
+        printf("client library has no non-blocking API, skip\n");
+        return 0;
+    }
+    Epoller epoller;
+    HeapTimer timer;
+    AsyncSql sql(&epoller, &timer);
+    check(sql.init("127.0.0.1", port, user, pwd, dbName, connNum), "init");
+
+    int pending = 0;
+    auto expect = [&](const char *stmt, const char *what) {
+        pending++;
+        sql.query(stmt, [&, what](bool ok, MYSQL_RES*) { check(ok, what); pending--; });
+    };
+    expect("CREATE TABLE IF NOT EXISTS user(username char(50) NULL, password char(50) NULL) ENGINE=InnoDB", "create table");
+    expect("DELETE FROM user WHERE username='async_test'", "clean up");
+    runUntil(epoller, timer, sql, pending);
+
+    // 登录/注册流程: 与服务器中相同的两步查询
+    struct Case { const char *pwd; bool isLogin; bool want; const char *what; };
+    const Case cases[] = {
+        { "secret", false, true, "register new user" },
+        { "secret", false, false, "register existing user" },
+        { "secret", true, true, "login" },
+        { "wrong", true, false, "login with wrong password" },
+    };
+    for (const Case &c : cases) {
+        pending++;
+        HttpRequest::UserVerifyAsync(&sql, { "async_test", c.pwd, c.isLogin }, [&, c](bool ok) {
+            check(ok == c.want, c.what);
+            pending--;
+        });
+        runUntil(epoller, timer, sql, pending);
+    }
+
+    // 单线程同时发出 sleepNum 个 SLEEP(0.1): connNum 个连接并发执行, 耗时约 sleepNum / connNum * 0.1s
+    int okCount = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < sleepNum; i++) {
+        pending++;
+        sql.query("SELECT SLEEP(0.1)", [&](bool ok, MYSQL_RES *res) { okCount += ok && res; pending--; });
+    }
+    size_t inflight = sql.inflight();
+    runUntil(epoller, timer, sql, pending);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%d x SLEEP(0.1) on %d connections: %.2fs, %zu in flight at once\n", sleepNum, connNum, sec, inflight);
+    check(okCount == sleepNum, "all sleep queries succeed");
+    check(inflight == static_cast<size_t>(connNum), "one query in flight per connection");
+    check(connNum <= 1 || sec < sleepNum * 0.1 * 0.75, "queries overlap");
+
+    // 服务端 NO_BACKSLASH_ESCAPES 下参数中的引号与反斜杠: 新连接继承全局 sql_mode, 测试后恢复
+    std::string sqlMode;
+    pending++;
+    sql.query("SELECT @@GLOBAL.sql_mode", [&](bool ok, MYSQL_RES *res) {
+        MYSQL_ROW row = ok && res ? mysql_fetch_row(res) : nullptr;
+        if (row && row[0])
+            sqlMode = row[0];
+        check(row != nullptr, "read sql_mode");
+        pending--;
+    });
+    runUntil(epoller, timer, sql, pending);
+    expect("SET GLOBAL sql_mode = CONCAT(@@GLOBAL.sql_mode, ',NO_BACKSLASH_ESCAPES')", "set NO_BACKSLASH_ESCAPES");
+    runUntil(epoller, timer, sql, pending);
+    {
+        AsyncSql strict(&epoller, &timer);
+        check(strict.init("127.0.0.1", port, user, pwd, dbName, 1), "init under NO_BACKSLASH_ESCAPES");
+        const std::string name = "q'\\' OR '1'='1";
+        const Case quoted[] = {
+            { "secret", false, true, "NO_BACKSLASH_ESCAPES: register quoted name" },
+            { "secret", true, true, "NO_BACKSLASH_ESCAPES: login quoted name" },
+            { "wrong", true, false, "NO_BACKSLASH_ESCAPES: login quoted name with wrong password" },
+        };
+        for (const Case &c : quoted) {
+            pending++;
+            HttpRequest::UserVerifyAsync(&strict, { name, c.pwd, c.isLogin }, [&, c](bool ok) {
+                check(ok == c.want, c.what);
+                pending--;
+            });
+            runUntil(epoller, timer, strict, pending);
+        }
+        pending++;
+        strict.query("SELECT username FROM user WHERE username=?", { name }, [&](bool ok, MYSQL_RES *res) {
+            MYSQL_ROW row = ok && res ? mysql_fetch_row(res) : nullptr;
+            check(row && row[0] && name == row[0] && !mysql_fetch_row(res), "NO_BACKSLASH_ESCAPES: name stored verbatim");
+            pending--;
+        });
+        runUntil(epoller, timer, strict, pending);
+        pending++;
+        strict.query("DELETE FROM user WHERE username=?", { name }, [&](bool ok, MYSQL_RES*) { check(ok, "clean up quoted name"); pending--; });
+        runUntil(epoller, timer, strict, pending);
+    }
+    pending++;
+    sql.query("SET GLOBAL sql_mode = ?", { sqlMode }, [&](bool ok, MYSQL_RES*) { check(ok, "restore sql_mode"); pending--; });
+    runUntil(epoller, timer, sql, pending);
+
+    // 排队超时: 一个连接, 每个 SLEEP(0.2) 排队上限 0.3s, 前两个执行, 之后的在取出时已超时
+    {
+        AsyncSql single(&epoller, &timer);
+        check(single.init("127.0.0.1", port, user, pwd, dbName, 1, 300), "init with queue timeout");
+        int okNum = 0, failNum = 0;
+        for (int i = 0; i < 4; i++) {
+            pending++;
+            single.query("SELECT SLEEP(0.2)", [&](bool ok, MYSQL_RES*) { ok ? okNum++ : failNum++; pending--; });
+        }
+        runUntil(epoller, timer, single, pending);
+        check(okNum == 2 && failNum == 2, "queued queries past the deadline fail");
+    }
+
+    expect("DELETE FROM user WHERE username='async_test'", "clean up");
+    runUntil(epoller, timer, sql, pending);
+    return checkResult();
+}
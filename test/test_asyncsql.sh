@@ -0,0 +1,33 @@
+#!/bin/sh
+# 在临时数据目录启动一个只监听本机的 mariadbd, 运行 test_asyncsql 后停止并删除
+# 用法: test/test_asyncsql.sh [连接数] [SLEEP 查询数]
+# TEST 可换成参数相同的其他程序, 如 TEST=test/bench_sqlpool test/test_asyncsql.sh [线程数] [秒数]
+# 需要 MariaDB 服务端 (mariadb-install-db, mariadbd) 与客户端库, 在仓库根目录运行
+cd "$(dirname "$0")/.." || exit 1
+PORT=${PORT:-3307}
+TEST=${TEST:-test/test_asyncsql}
+INSTALL_DB=${INSTALL_DB:-$(command -v mariadb-install-db || command -v mysql_install_db)}
+MYSQLD=${MYSQLD:-$(command -v mariadbd || command -v mysqld)}
+CLIENT=${CLIENT:-$(command -v mariadb || command -v mysql)}
+
+if [ -z "$INSTALL_DB" ] || [ -z "$MYSQLD" ] || [ -z "$CLIENT" ]; then
+    echo "mariadbd not found, skip"
+    exit 0
+fi
+[ -x "$TEST" ] || make -C test "$(basename "$TEST")" || exit 1
+
+DATADIR=$(mktemp -d)
+trap 'kill $pid 2>/dev/null; wait $pid 2>/dev/null; rm -rf "$DATADIR"' EXIT
+"$INSTALL_DB" --no-defaults --datadir="$DATADIR" --auth-root-authentication-method=normal > /dev/null || exit 1
+"$MYSQLD" --no-defaults --datadir="$DATADIR" --socket="$DATADIR/mysqld.sock" --port="$PORT" \
+    --bind-address=127.0.0.1 --skip-name-resolve --pid-file="$DATADIR/mysqld.pid" > "$DATADIR/mysqld.log" 2>&1 &
+pid=$!
+
+# 等服务端接受连接
+for i in $(seq 50); do
+    "$CLIENT" --no-defaults -uroot --socket="$DATADIR/mysqld.sock" -e "SELECT 1" > /dev/null 2>&1 && break
+    sleep 0.2
+done
+"$CLIENT" --no-defaults -uroot --socket="$DATADIR/mysqld.sock" -e "CREATE DATABASE IF NOT EXISTS yourdb" || exit 1
+
+"$TEST" "$PORT" root "" yourdb "${1:-4}" "${2:-32}"
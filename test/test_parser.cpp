@@ -0,0 +1,175 @@
+/**
+ * @file test_parser.cpp
+ * @brief  请求解析测试: 逐字节到达时的续解析, length() 与 Content-Length, 请求体, 超限与不支持的请求回 400,
+ *         已知头部的直接定位与其余头部的按名查找
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make test_parser && ./test_parser
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/http/httprequest.h"
+#include "check.h"
+
+using namespace wsv;
+
+static const std::string POST_REQUEST =
+    "POST /submit HTTP/1.1\r\n"
+    "Host: 127.0.0.1:12309\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 30\r\n"
+    "Connection: keep-alive\r\n\r\n"
+    "username=alice&password=secret";
+
+static const std::string GET_REQUEST = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+
+// 整段放入缓冲区解析一次; 解析结果指向缓冲区, 调用方在检查完之前保留 buff
+static HttpRequest::HTTP_CODE parseOnce(HttpRequest &request, ChainBuffer &buff, const std::string &data) {
+    buff.retrieveAll();
+    buff.append(data.data(), data.size());
+    request.init();
+    return request.parse(buff);
+}
+
+// 每到达一个字节解析一次, 最后一个字节之前都应是 NO_REQUEST
+static void byteByByte() {
+    ChainBuffer buff;
+    HttpRequest request;
+    bool early = false;
+    HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+    for (size_t i = 0; i < POST_REQUEST.size(); i++) {
+        buff.append(&POST_REQUEST[i], 1);
+        ret = request.parse(buff);
+        if (i + 1 < POST_REQUEST.size() && ret != HttpRequest::NO_REQUEST)
+            early = true;
+    }
+    check(!early, "byte by byte: NO_REQUEST until the last byte");
+    check(ret == HttpRequest::GET_REQUEST, "byte by byte: complete on the last byte");
+    check(request.length() == POST_REQUEST.size(), "byte by byte: length() covers headers and body");
+    check(request.methodId() == HttpRequest::POST && request.path() == "/submit", "byte by byte: method and path");
+    check(request.header(HttpRequest::HDR_CONTENT_LENGTH) == "30", "byte by byte: Content-Length header");
+    check(request.getPost("username") == "alice" && request.getPost("password") == "secret", "byte by byte: body");
+    check(request.isKeepAlive(), "byte by byte: keep-alive");
+}
+
+// 请求体按 Content-Length 截取, 后面流水线的请求留在缓冲区
+static void contentLength() {
+    ChainBuffer buff;
+    HttpRequest request;
+    check(parseOnce(request, buff, POST_REQUEST + GET_REQUEST) == HttpRequest::GET_REQUEST
+          && request.length() == POST_REQUEST.size(), "pipelined: length() stops at Content-Length");
+    check(request.getPost("password") == "secret", "pipelined: body does not include the next request");
+    buff.retrieve(request.length());
+    check(request.parse(buff) == HttpRequest::GET_REQUEST && request.path() == "/index.html"
+          && request.length() == GET_REQUEST.size(), "pipelined: next request parsed from the rest");
+
+    // 请求体分两次到达
+    std::string head = POST_REQUEST.substr(0, POST_REQUEST.size() - 10);
+    buff.retrieveAll();
+    buff.append(head.data(), head.size());
+    request.init();
+    check(request.parse(buff) == HttpRequest::NO_REQUEST, "partial body: NO_REQUEST");
+    buff.append(POST_REQUEST.data() + head.size(), 10);
+    check(request.parse(buff) == HttpRequest::GET_REQUEST && request.getPost("password") == "secret", "partial body: completed");
+
+    std::string noBody = "GET / HTTP/1.1\r\nContent-Length: 0\r\n\r\n";
+    check(parseOnce(request, buff, noBody) == HttpRequest::GET_REQUEST && request.length() == noBody.size(), "Content-Length: 0");
+}
+
+// 出错时整个缓冲区都算作该请求, 由连接回 400 后关闭
+static void expectBad(const std::string &data, const char *what) {
+    ChainBuffer buff;
+    HttpRequest request;
+    HttpRequest::HTTP_CODE ret = parseOnce(request, buff, data);
+    check(ret == HttpRequest::BAD_REQUEST && request.length() == data.size() && !request.isKeepAlive(), what);
+}
+
+static void badRequests() {
+    expectBad("POST /submit HTTP/1.1\r\nContent-Length: 12x\r\n\r\n", "400: non-numeric Content-Length");
+    expectBad("POST /submit HTTP/1.1\r\nContent-Length: 1048577\r\n\r\n", "400: body over 1MB");
+    expectBad("POST /submit HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n", "400: Content-Length overflow");
+    expectBad("POST /submit HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n", "400: Transfer-Encoding");
+    expectBad("POST /submit HTTP/1.1\r\ntransfer-encoding: chunked\r\nContent-Length: 5\r\n\r\nhello", "400: Transfer-Encoding with Content-Length");
+    expectBad("GET /index.html\r\n\r\n", "400: request line without version");
+
+    // 头部未结束: 64KB 以内继续等待, 超过后回 400
+    std::string big = "GET / HTTP/1.1\r\n";
+    while (big.size() < 60 * 1024)
+        big += "X-Pad: " + std::string(100, 'a') + "\r\n";
+    ChainBuffer buff;
+    HttpRequest request;
+    check(parseOnce(request, buff, big) == HttpRequest::NO_REQUEST, "60KB of headers: still waiting");
+    while (big.size() <= 64 * 1024)
+        big += "X-Pad: " + std::string(100, 'a') + "\r\n";
+    expectBad(big, "400: headers over 64KB");
+    expectBad("GET / HTTP/1.1\r\nX-Long: " + std::string(64 * 1024, 'a'), "400: one header line over 64KB");
+
+    // 1MB 的请求体本身不受头部上限限制
+    std::string body(1024 * 1024, 'a');
+    std::string large = "POST /submit HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    check(parseOnce(request, buff, large) == HttpRequest::GET_REQUEST && request.length() == large.size(), "1MB body accepted");
+}
+
+// 已知头部不区分大小写地按编号定位; 其他头部 (含与已知头部同长度、落在同一槽位的) 回到头部表按名查找
+static void knownHeaders() {
+    static const struct { HttpRequest::HEADER_ID id; const char *name; const char *value; } KNOWN[] = {
+        { HttpRequest::HDR_CONNECTION, "cOnNeCtIoN", "keep-alive" },
+        { HttpRequest::HDR_CONTENT_LENGTH, "CONTENT-LENGTH", "0" },
+        { HttpRequest::HDR_CONTENT_TYPE, "Content-type", "text/plain" },
+        { HttpRequest::HDR_HOST, "HOST", "example.com" },
+        { HttpRequest::HDR_IF_NONE_MATCH, "If-None-Match", "\"abc\"" },
+        { HttpRequest::HDR_RANGE, "range", "bytes=0-1" },
+        { HttpRequest::HDR_ACCEPT_ENCODING, "Accept-ENCODING", "gzip" },
+    };
+    std::string data = "GET /index.html HTTP/1.1\r\n";
+    for (auto &h : KNOWN)
+        data += std::string(h.name) + ":  " + h.value + " \r\n";
+    data += "Hist: slot\r\nX-Custom-Header: v1\r\nAccept: */*\r\nHost: second\r\n";
+    for (int i = 0; i < 30; i++)
+        data += "X-Pad-" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+    data += "\r\n";
+
+    ChainBuffer buff;
+    HttpRequest request;
+    check(parseOnce(request, buff, data) == HttpRequest::GET_REQUEST, "headers: parsed");
+    bool byId = true, byName = true, byLowerName = true, idOfName = true;
+    for (auto &h : KNOWN) {
+        std::string lower = h.name;
+        for (char &c : lower)
+            c = tolower(c);
+        byId = byId && request.header(h.id) == h.value;
+        byName = byName && request.header(h.name) == h.value;
+        byLowerName = byLowerName && request.header(lower) == h.value;
+        idOfName = idOfName && HttpRequest::headerId(h.name) == h.id && HttpRequest::headerId(lower) == h.id;
+    }
+    check(byId, "headers: each known header found by id, surrounding whitespace trimmed");
+    check(byName && byLowerName, "headers: each known header found by name in any case");
+    check(idOfName, "headers: headerId() maps every known name regardless of case");
+    check(HttpRequest::headerId("Transfer-Encoding") == HttpRequest::HDR_TRANSFER_ENCODING, "headers: Transfer-Encoding is known");
+    check(request.header(HttpRequest::HDR_TRANSFER_ENCODING).empty(), "headers: absent known header is empty");
+    check(request.header("host") == "example.com", "headers: repeated known header returns the first");
+
+    check(HttpRequest::headerId("Hist") == HttpRequest::HDR_UNKNOWN && request.header("hist") == "slot",
+          "headers: unknown name with a known length falls back to the table");
+    check(HttpRequest::headerId("X-Custom-Header") == HttpRequest::HDR_UNKNOWN && request.header("x-custom-header") == "v1",
+          "headers: unknown header found case-insensitively");
+    check(request.header("Accept") == "*/*", "headers: Accept is not a known header but still found");
+    check(request.header("X-Pad-0") == "0" && request.header("x-pad-29") == "29", "headers: beyond the inline table");
+    check(request.header("X-Missing").empty(), "headers: missing unknown header is empty");
+}
+
+int main() {
+    const char *LEVEL_NAME[] = { "scalar", "sse2", "avx2" };
+    for (int level = Scanner::SCALAR; level <= Scanner::AVX2; level++) {
+        if (!Scanner::setLevel(static_cast<Scanner::LEVEL>(level)))
+            continue;
+        printf("%s:\n", LEVEL_NAME[level]);
+        byteByByte();
+        contentLength();
+        badRequests();
+        knownHeaders();
+    }
+    return checkResult();
+}
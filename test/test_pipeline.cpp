@@ -0,0 +1,127 @@
+/**
+ * @file test_pipeline.cpp
+ * @brief  流水线请求测试: 经 socketpair 驱动 HttpConn::process(), 响应按序一次写出, 每轮不超过 pipelineMax 个,
+ *         不完整的请求留到下一轮
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make test_pipeline && ./test_pipeline
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../src/http/httpconn.h"
+#include "check.h"
+
+using namespace wsv;
+
+static std::string body(int n) { return "file " + std::to_string(n) + std::string(n * 100, '.') + "\n"; }
+
+static std::string request(int n) { return "GET /" + std::to_string(n) + ".txt HTTP/1.1\r\nHost: test\r\nConnection: keep-alive\r\n\r\n"; }
+
+// 取出对端收到的全部数据, 按 Content-length 切成各个响应的体; 有响应不是 200 keep-alive 时记在 bad 中
+static std::vector<std::string> receive(int fd, bool *bad) {
+    std::string data;
+    char buf[4096];
+    ssize_t len;
+    while ((len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+        data.append(buf, len);
+    std::vector<std::string> bodies;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t headEnd = data.find("\r\n\r\n", pos);
+        size_t lengthAt = data.find("Content-length: ", pos);
+        if (headEnd == std::string::npos || lengthAt == std::string::npos || lengthAt > headEnd) {
+            *bad = true;
+            break;
+        }
+        std::string head = data.substr(pos, headEnd - pos);
+        if (head.compare(0, 15, "HTTP/1.1 200 OK") != 0 || head.find("Connection: keep-alive") == std::string::npos)
+            *bad = true;
+        size_t bodyLen = strtoul(data.c_str() + lengthAt + 16, nullptr, 10);
+        bodies.push_back(data.substr(headEnd + 4, bodyLen));
+        pos = headEnd + 4 + bodyLen;
+    }
+    return bodies;
+}
+
+// 一轮: 读入对端已发送的数据, process() 后一次 write() 发出, 对端按序收到 expect 中各文件的内容
+static void round(HttpConn &conn, int peer, const std::vector<int> &expect, const char *name) {
+    int err = 0;
+    conn.read(&err);
+    bool ready = conn.process();
+    size_t total = conn.toWriteBytes();
+    ssize_t written = ready ? conn.write(&err) : 0;
+    bool bad = false;
+    std::vector<std::string> bodies = receive(peer, &bad);
+    std::vector<std::string> want;
+    for (int n : expect)
+        want.push_back(body(n));
+
+    std::string label = std::string(name) + ": ";
+    check(ready, (label + "process() has responses").c_str());
+    check(written > 0 && static_cast<size_t>(written) == total && conn.toWriteBytes() == 0, (label + "all responses in a single write").c_str());
+    check(bodies.size() == expect.size(), (label + std::to_string(expect.size()) + " responses").c_str());
+    check(!bad && bodies == want, (label + "responses in request order, 200 keep-alive").c_str());
+}
+
+int main() {
+    char dir[] = "/tmp/test_pipeline_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("mkdtemp error\n");
+        return EXIT_FAILURE;
+    }
+    std::string srcDir = std::string(dir) + "/";
+    for (int n = 1; n <= 8; n++) {
+        std::string path = srcDir + std::to_string(n) + ".txt", content = body(n);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || write(fd, content.data(), content.size()) != static_cast<ssize_t>(content.size())) {
+            printf("write %s error\n", path.c_str());
+            return EXIT_FAILURE;
+        }
+        close(fd);
+    }
+    HttpConn::srcDir = srcDir.c_str();
+    HttpConn::isET = false;
+    HttpConn::pipelineMax = 4;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0) {
+        printf("socketpair error\n");
+        return EXIT_FAILURE;
+    }
+    HttpConn conn;
+    sockaddr_in addr = {};
+    conn.init(sv[0], addr);
+
+    // 6 个完整请求 + 第 7 个的前半: 第一轮只应答 pipelineMax 个
+    std::string partial = request(7);
+    std::string data;
+    for (int n = 1; n <= 6; n++)
+        data += request(n);
+    data += partial.substr(0, 20);
+    send(sv[1], data.data(), data.size(), 0);
+    round(conn, sv[1], { 1, 2, 3, 4 }, "round 1 (capped at pipelineMax)");
+
+    // 没有新数据: 余下的两个完整请求, 不完整的请求保留
+    round(conn, sv[1], { 5, 6 }, "round 2 (rest of the batch)");
+    check(!conn.process() && !conn.isIdle(), "partial request: no response yet, kept in the read buffer");
+
+    // 补齐第 7 个请求, 再跟一个完整请求
+    data = partial.substr(20) + request(8);
+    send(sv[1], data.data(), data.size(), 0);
+    round(conn, sv[1], { 7, 8 }, "round 3 (partial request completed)");
+    check(!conn.process() && conn.isIdle(), "idle after all requests answered");
+
+    conn.close();
+    close(sv[1]);
+    for (int n = 1; n <= 8; n++)
+        unlink((srcDir + std::to_string(n) + ".txt").c_str());
+    rmdir(dir);
+    return checkResult();
+}
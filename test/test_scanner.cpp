@@ -0,0 +1,93 @@
+/**
+ * @file test_scanner.cpp
+ * @brief  分隔符扫描测试: 各向量实现与逐字节扫描的结果在随机内容、长度与对齐下一致, 不读过 end
+ * @author Ichheit, <ichheit@outlook.com>
+ * @date 2026-10-18
+ */
+// 构建: cd test && make test_scanner
+// 用法: ./test_scanner [随机种子] [每个实现的轮数]
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../src/http/scanner.h"
+
+using namespace wsv;
+
+static const char* naiveFind(const char *begin, const char *end, char a, char b) {
+    for (; begin < end; ++begin)
+        if (*begin == a || *begin == b)
+            return begin;
+    return end;
+}
+
+static const char* naiveCRLF(const char *begin, const char *end) {
+    for (; end - begin >= 2; ++begin)
+        if (begin[0] == '\r' && begin[1] == '\n')
+            return begin;
+    return end;
+}
+
+// 分隔符与高位为 1 的字节 (char 为负) 出现得多一些
+static char randomChar(std::mt19937 &rng) {
+    static const char SPECIAL[] = { '\r', '\n', ':', ' ', '\0', '\x80', '\xff', 'a' };
+    return rng() % 4 ? static_cast<char>(rng()) : SPECIAL[rng() % sizeof(SPECIAL)];
+}
+
+int main(int argc, char *argv[]) {
+    unsigned seed = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20261018;
+    int rounds = argc > 2 ? atoi(argv[2]) : 200000;
+
+    // 两页映射, 第二页不可访问: 数据紧贴第一页末尾时, 越过 end 的读取会触发段错误
+    size_t page = sysconf(_SC_PAGESIZE);
+    char *base = static_cast<char*>(mmap(nullptr, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (base == MAP_FAILED || mprotect(base + page, page, PROT_NONE) < 0) {
+        printf("mmap error\n");
+        return EXIT_FAILURE;
+    }
+    char *guard = base + page;
+
+    const char *LEVEL_NAME[] = { "scalar", "sse2", "avx2" };
+    int failed = 0;
+    for (int level = Scanner::SCALAR; level <= Scanner::AVX2; level++) {
+        if (!Scanner::setLevel(static_cast<Scanner::LEVEL>(level)))
+            continue;
+        std::mt19937 rng(seed);
+        int mismatch[3] = { 0, 0, 0 };
+        for (int n = 0; n < rounds; n++) {
+            // 长度覆盖 0 到几个向量宽度, 起点覆盖各种对齐, 一半紧贴不可访问页
+            size_t len = rng() % 200;
+            char *begin = rng() % 2 ? guard - len : base + rng() % 64;
+            char *end = begin + len;
+            // 0: 随机内容; 1: 稀疏分隔符; 2: 没有分隔符
+            int density = rng() % 3;
+            for (char *p = begin; p < end; p++)
+                *p = density == 0 ? randomChar(rng) : density == 1 && rng() % 64 == 0 ? "\r\n:"[rng() % 3] : 'x';
+            // 末尾的 "\r" 或 "\r\n" 落在向量与逐字节处理的交界
+            if (density == 1 && len >= 2 && rng() % 2) {
+                end[-2] = '\r';
+                end[-1] = rng() % 2 ? '\n' : 'x';
+            }
+            char a = randomChar(rng), b = rng() % 2 ? a : randomChar(rng);
+
+            const char *got[3] = { Scanner::find(begin, end, a), Scanner::findFirstOf(begin, end, a, b), Scanner::findCRLF(begin, end) };
+            const char *want[3] = { naiveFind(begin, end, a, a), naiveFind(begin, end, a, b), naiveCRLF(begin, end) };
+            for (int f = 0; f < 3; f++) {
+                if (got[f] == want[f])
+                    continue;
+                if (mismatch[f]++ == 0)
+                    printf("FAIL: %s %s len %zu align %zu: at %td, want %td\n", LEVEL_NAME[level],
+                           f == 0 ? "find" : f == 1 ? "findFirstOf" : "findCRLF", len,
+                           reinterpret_cast<uintptr_t>(begin) % 64, got[f] - begin, want[f] - begin);
+            }
+        }
+        printf("%s: %d rounds, mismatches: find %d, findFirstOf %d, findCRLF %d\n",
+               LEVEL_NAME[level], rounds, mismatch[0], mismatch[1], mismatch[2]);
+        failed += mismatch[0] + mismatch[1] + mismatch[2];
+    }
+    munmap(base, page * 2);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}